@@ -29,39 +29,210 @@
 
 // ═════════════════════════════════ Includes ═════════════════════════════════
 
+#include <assert.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <stdio.h>
+#include <limits.h>
+#include <stdatomic.h>
+
+#include <pthread.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include <immintrin.h>
 
 #include "org/devopsbroker/io/file.h"
 #include "org/devopsbroker/lang/error.h"
+#include "org/devopsbroker/lang/memory.h"
 #include "org/devopsbroker/lang/string.h"
 #include "org/devopsbroker/lang/stringbuilder.h"
 #include "org/devopsbroker/terminal/ansi.h"
+#include "org/devopsbroker/terminal/commandline.h"
 
 // ═══════════════════════════════ Preprocessor ═══════════════════════════════
 
+#define USAGE_MSG "between " ANSI_GOLD "{ -f specFile | -j numThreads | --all }" ANSI_YELLOW " START END " ANSI_AQUA "[input-file]"
+
+// Input is read in blocks of this size; the tail of a block that could be the
+// beginning of START or END is carried over into the next one
+#define BLOCK_SIZE   (1024 * 1024)
+
+// Regions are written to STDOUT this many iovecs at a time
+#define MAX_IOVECS   IOV_MAX
+
+#define MAX_NUM_THREADS   256
+
+// With -j, the mapped file is scanned in chunks of this size
+#define SCAN_CHUNK_SIZE   (8 * 1024 * 1024)
+
+// No pattern ends at this node of the automaton
+#define NO_PATTERN   UINT32_MAX
 
 // ═════════════════════════════════ Typedefs ═════════════════════════════════
 
+typedef const char *(*SearchPattern)(const char *text, size_t length, const char *pattern, size_t patternLength);
+
+typedef struct RegionWriter {
+	struct iovec iovecs[MAX_IOVECS];
+	uint32_t numIovecs;
+} RegionWriter;
+
+static_assert(sizeof(RegionWriter) == 16392, "Check your assumptions");
+
+// A START and the first END after it; end is NULL when no END follows
+typedef struct Region {
+	const char *start;
+	const char *end;
+} Region;
+
+static_assert(sizeof(Region) == 16, "Check your assumptions");
+
+/*
+ * The regions one thread found in its chunk of the mapped file, by running the
+ * search from the beginning of the chunk as though no region were open there
+ */
+typedef struct ScanChunk {
+	const char *begin;
+	const char *end;
+	Region     *regions;
+	uint32_t    numRegions;
+	uint32_t    capacity;
+	bool        isDone;
+} ScanChunk;
+
+static_assert(sizeof(ScanChunk) == 40, "Check your assumptions");
+
+/*
+ * Chunks are handed out in file order and merged in file order by the main
+ * thread. The scan threads keep at most maxAhead chunks ahead of the merge,
+ * which bounds the memory held by unmerged regions, and drop their chunks
+ * once isStopped is set.
+ */
+typedef struct ScanJob {
+	pthread_mutex_t mutex;
+	pthread_cond_t  isScanned;
+	pthread_cond_t  isMerged;
+	ScanChunk      *chunks;
+	const char     *textEnd;
+	uint32_t        numChunks;
+	uint32_t        nextChunk;
+	uint32_t        numMerged;
+	uint32_t        maxAhead;
+	atomic_bool     isStopped;
+} ScanJob;
+
+static_assert(sizeof(ScanJob) == 176, "Check your assumptions");
+
+/*
+ * One ID, START and END line of a -f spec file. Every pair is matched on its
+ * own, exactly as though between had been run with only that START and END.
+ * Offsets are from the beginning of the input.
+ */
+typedef struct PatternPair {
+	char          *tag;            // "ID\t"
+	StringBuilder *textBlock;      // Region text from earlier blocks of a stream
+	uint64_t       regionStart;
+	uint64_t       minStart;       // A START may not overlap the last END
+	uint32_t       tagLength;
+	uint32_t       startLength;
+	uint32_t       endLength;
+	uint32_t       startString;
+	uint32_t       endString;
+	bool           isInRegion;
+	bool           isDone;
+} PatternPair;
+
+static_assert(sizeof(PatternPair) == 56, "Check your assumptions");
+
+// A distinct START or END string; uses lists the pairs it belongs to
+typedef struct PatternString {
+	uint32_t nextOutput;          // Next string that ends where this one does
+	uint32_t firstUse;
+	uint32_t numUses;
+} PatternString;
+
+static_assert(sizeof(PatternString) == 12, "Check your assumptions");
+
+typedef struct PatternUse {
+	uint32_t pairIndex;
+	bool     isEnd;
+} PatternUse;
+
+static_assert(sizeof(PatternUse) == 8, "Check your assumptions");
+
+/*
+ * Aho-Corasick automaton over every START and END, as a complete transition
+ * table so each input byte costs one lookup. outputs holds the longest string
+ * that ends at each node; the others follow through nextOutput. When at most
+ * four bytes lead out of the root, the scan skips to the next of them there.
+ */
+typedef struct Automaton {
+	uint32_t      *transitions;
+	uint32_t      *outputs;
+	PatternString *strings;
+	PatternUse    *uses;
+	uint32_t       numNodes;
+	uint32_t       numStrings;
+	uint32_t       state;
+	uint32_t       numDone;
+	uint8_t        firstBytes[4];
+	uint32_t       numFirstBytes;
+} Automaton;
+
+static_assert(sizeof(Automaton) == 56, "Check your assumptions");
 
 // ═══════════════════════════ Function Declarations ══════════════════════════
 
-// Remove trailing newline and carriage return
-static inline void removeNewline(char *endPtr) {
-	do {
-		*endPtr = '\0';
-		endPtr--;
-	} while (*endPtr == '\n' || *endPtr == '\r');
-}
+static const char *searchPatternSSE2(const char *text, size_t length, const char *pattern, size_t patternLength);
+static const char *searchPatternAVX2(const char *text, size_t length, const char *pattern, size_t patternLength);
+
+static void processCmdLine(CmdLineParam *cmdLineParam);
+
+static void extractMappedRegions(const char *text, size_t length);
+static void extractParallelRegions(const char *text, size_t length);
+static void extractStreamRegions(int fileDescriptor);
+
+static void *runScanWorker(void *scanJob);
+static void scanChunk(ScanChunk *chunk, ScanJob *job);
+static bool mergeChunk(const ScanChunk *chunk, const char **position, const char *textEnd);
+
+static void loadPatternPairs(char *specFileName);
+static uint32_t addPatternString(const char *text, uint32_t length);
+static void buildAutomaton();
+static size_t skipToFirstByte(const char *block, size_t position, size_t length);
+static bool scanPatterns(const char *block, size_t length, uint64_t blockOffset, bool isMapped);
+static void extractStreamPatterns(int fileDescriptor);
+
+static void writeRegion(const char *region, size_t length);
+static void writeTaggedRegion(const char *tag, size_t tagLength, const char *region, size_t length);
+static void flushRegions();
 
 // ═════════════════════════════ Global Variables ═════════════════════════════
 
 char *pathName = NULL;
-char *startPtr = NULL;
-char *endPtr = NULL;
+char *specFileName = NULL;
+bool isAll = false;
+uint32_t numThreads = 1;
 
-StringBuilder *textBlock = NULL;
+char  *startPattern = NULL;
+size_t startLength = 0;
+char  *endPattern = NULL;
+size_t endLength = 0;
+
+RegionWriter regionWriter;
+
+PatternPair *patternPairs = NULL;
+uint32_t numPairs = 0;
+Automaton automaton;
+
+// Substring search selected for this CPU
+SearchPattern searchPattern = searchPatternSSE2;
 
 // ══════════════════════════════════ main() ══════════════════════════════════
 
@@ -69,95 +240,942 @@ int main(int argc, char *argv[]) {
 
 	programName = "between";
 
-	if (argc == 1) {
-		c7c88e52_printUsage("between START END " ANSI_AQUA "[input-file]");
+	CmdLineParam cmdLineParam;
+	d7ad7024_initCmdLineParam(&cmdLineParam, argc, argv, USAGE_MSG);
+	processCmdLine(&cmdLineParam);
+
+	if (__builtin_cpu_supports("avx2")) {
+		searchPattern = searchPatternAVX2;
+	}
+
+	if (specFileName != NULL) {
+		loadPatternPairs(specFileName);
+		buildAutomaton();
+	}
+
+	// File-related variables
+	int fileDescriptor;
+	struct stat fileStatus;
+	void *mapping;
+
+	if (pathName != NULL) {
+		fileDescriptor = e2f74138_openFile(pathName, O_RDONLY);
+	} else {
+		pathName = "STDIN";
+		fileDescriptor = STDIN_FILENO;
+	}
+
+	/*
+	 * Regular files are searched in place and every region is written straight
+	 * from the mapping. Pipes, and files like those in /proc that report no
+	 * size, are streamed instead.
+	 */
+	if (fstat(fileDescriptor, &fileStatus) == 0 && S_ISREG(fileStatus.st_mode) && fileStatus.st_size > 0
+	        && (mapping = mmap(NULL, fileStatus.st_size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0)) != MAP_FAILED) {
+		madvise(mapping, fileStatus.st_size, MADV_SEQUENTIAL);
+
+		// The pattern pairs of a spec file are always matched in one pass
+		if (specFileName != NULL) {
+			scanPatterns(mapping, fileStatus.st_size, 0, true);
+			flushRegions();
+		} else if (isAll && numThreads > 1 && fileStatus.st_size > SCAN_CHUNK_SIZE) {
+			extractParallelRegions(mapping, fileStatus.st_size);
+		} else {
+			extractMappedRegions(mapping, fileStatus.st_size);
+		}
+
+		munmap(mapping, fileStatus.st_size);
+	} else if (specFileName != NULL) {
+		extractStreamPatterns(fileDescriptor);
+	} else {
+		extractStreamRegions(fileDescriptor);
+	}
+
+	// Close the file if not STDIN
+	if (fileDescriptor != STDIN_FILENO) {
+		e2f74138_closeFile(fileDescriptor, pathName);
+	}
+
+	// Exit with success
+	exit(EXIT_SUCCESS);
+}
+
+// ═════════════════════════ Function Implementations ═════════════════════════
+
+static void processCmdLine(CmdLineParam *cmdLineParam) {
+	register int argc = cmdLineParam->argc;
+	register char **argv = cmdLineParam->argv;
+	int argi = 1;
+
+	// Options come before START; "--" ends them, should START begin with '-'
+	for (; argi < argc && argv[argi][0] == '-' && argv[argi][1] != '\0'; argi++) {
+		if (f6215943_isEqual(argv[argi], "--")) {
+			argi++;
+			break;
+		} else if (f6215943_isEqual(argv[argi], "--all")) {
+			isAll = true;
+		} else if (f6215943_isEqual(argv[argi], "-f")) {
+			specFileName = d7ad7024_getString(cmdLineParam, "spec file", argi++);
+		} else if (f6215943_isEqual(argv[argi], "-j")) {
+			numThreads = d7ad7024_getUint32(cmdLineParam, "number of threads", argi++);
+
+			if (numThreads == 0 || numThreads > MAX_NUM_THREADS) {
+				c7c88e52_invalidValue("number of threads", argv[argi]);
+				c7c88e52_printUsage(USAGE_MSG);
+				exit(EXIT_FAILURE);
+			}
+		} else {
+			c7c88e52_invalidOption(argv[argi]);
+			c7c88e52_printUsage(USAGE_MSG);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	// The START and END come from the spec file
+	if (specFileName != NULL) {
+		if (argi < argc) {
+			pathName = argv[argi];
+		}
+
+		return;
+	}
+
+	if (argi == argc) {
+		c7c88e52_printUsage(USAGE_MSG);
 		exit(EXIT_FAILURE);
 	}
 
-	if (argv[1][0] == '\0') {
+	if (argv[argi][0] == '\0') {
 		c7c88e52_printError_string("START parameter is missing\n\n");
-		c7c88e52_printUsage("between START END " ANSI_AQUA "[input-file]");
+		c7c88e52_printUsage(USAGE_MSG);
 		exit(EXIT_FAILURE);
 	}
 
-	if (argc == 2 || argv[2][0] == '\0') {
+	if (argi + 1 == argc || argv[argi + 1][0] == '\0') {
 		c7c88e52_printError_string("END parameter is missing\n\n");
-		char *usageMessage = f6215943_concatenate("between ", argv[1], " END " ANSI_AQUA "[input-file]", NULL);
+		char *usageMessage = f6215943_concatenate("between ", argv[argi], " END " ANSI_AQUA "[input-file]", NULL);
 		c7c88e52_printUsage(usageMessage);
 		free(usageMessage);
 		exit(EXIT_FAILURE);
 	}
 
-	// File-related variables
-	int fileDescriptor;
-	ssize_t numBytes;
+	startPattern = argv[argi];
+	startLength = strlen(startPattern);
+	endPattern = argv[argi + 1];
+	endLength = strlen(endPattern);
 
-	if (argc > 3) {
-		pathName = argv[3];
-		fileDescriptor = e2f74138_openFile(pathName, O_RDONLY);
-	} else {
-		pathName = "STDIN";
-		fileDescriptor = STDIN_FILENO;
+	if (argi + 2 < argc) {
+		pathName = argv[argi + 2];
+	}
+}
+
+static void extractMappedRegions(const char *text, size_t length) {
+	const char *position = text, *end = text + length;
+	const char *regionStart, *regionEnd;
+
+	while ((regionStart = searchPattern(position, end - position, startPattern, startLength)) != NULL) {
+		regionStart += startLength;
+
+		if ((regionEnd = searchPattern(regionStart, end - regionStart, endPattern, endLength)) == NULL) {
+			break;
+		}
+
+		writeRegion(regionStart, regionEnd - regionStart);
+		position = regionEnd + endLength;
+
+		if (!isAll) {
+			break;
+		}
 	}
 
-	char buffer[PHYSICAL_BLOCK_SIZE];
+	flushRegions();
+}
+
+/*
+ * Scans the chunks of the mapped file on numThreads threads while this thread
+ * merges their regions and writes them, in file order
+ */
+static void extractParallelRegions(const char *text, size_t length) {
+	pthread_t threads[MAX_NUM_THREADS];
+	const char *position = text;
+	ScanJob job;
+	uint32_t i;
+	int errorNumber;
+	bool isMore = true;
+
+	pthread_mutex_init(&job.mutex, NULL);
+	pthread_cond_init(&job.isScanned, NULL);
+	pthread_cond_init(&job.isMerged, NULL);
+
+	job.textEnd = text + length;
+	job.numChunks = (length + SCAN_CHUNK_SIZE - 1) / SCAN_CHUNK_SIZE;
+	job.nextChunk = 0;
+	job.numMerged = 0;
+	job.maxAhead = 4 * numThreads;
+	atomic_init(&job.isStopped, false);
+	job.chunks = f668c4bd_malloc(job.numChunks * sizeof(ScanChunk));
+	f668c4bd_meminit(job.chunks, job.numChunks * sizeof(ScanChunk));
+
+	for (i = 0; i < job.numChunks; i++) {
+		job.chunks[i].begin = text + ((size_t) i * SCAN_CHUNK_SIZE);
+		job.chunks[i].end = (i + 1 == job.numChunks) ? job.textEnd : job.chunks[i].begin + SCAN_CHUNK_SIZE;
+	}
+
+	for (i = 0; i < numThreads; i++) {
+		if ((errorNumber = pthread_create(&threads[i], NULL, runScanWorker, &job)) != 0) {
+			c7c88e52_printLibError("Cannot create thread", errorNumber);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	for (i = 0; i < job.numChunks && isMore; i++) {
+		pthread_mutex_lock(&job.mutex);
+
+		while (!job.chunks[i].isDone) {
+			pthread_cond_wait(&job.isScanned, &job.mutex);
+		}
+
+		pthread_mutex_unlock(&job.mutex);
+
+		isMore = mergeChunk(&job.chunks[i], &position, job.textEnd);
+		f668c4bd_free(job.chunks[i].regions);
+
+		pthread_mutex_lock(&job.mutex);
+		job.numMerged++;
+		pthread_cond_broadcast(&job.isMerged);
+		pthread_mutex_unlock(&job.mutex);
+	}
+
+	// Once no region can follow, the chunks still being scanned are dropped
+	pthread_mutex_lock(&job.mutex);
+	atomic_store(&job.isStopped, true);
+	pthread_cond_broadcast(&job.isMerged);
+	pthread_mutex_unlock(&job.mutex);
+
+	for (uint32_t j = 0; j < numThreads; j++) {
+		pthread_join(threads[j], NULL);
+	}
+
+	for (; i < job.numChunks; i++) {
+		f668c4bd_free(job.chunks[i].regions);
+	}
+
+	flushRegions();
+
+	f668c4bd_free(job.chunks);
+	pthread_cond_destroy(&job.isMerged);
+	pthread_cond_destroy(&job.isScanned);
+	pthread_mutex_destroy(&job.mutex);
+}
+
+static void *runScanWorker(void *scanJob) {
+	ScanJob *job = scanJob;
+	uint32_t index;
+
+	pthread_mutex_lock(&job->mutex);
+
+	while (!atomic_load_explicit(&job->isStopped, memory_order_relaxed) && job->nextChunk < job->numChunks) {
+		if (job->nextChunk >= job->numMerged + job->maxAhead) {
+			pthread_cond_wait(&job->isMerged, &job->mutex);
+			continue;
+		}
+
+		index = job->nextChunk++;
+		pthread_mutex_unlock(&job->mutex);
+
+		scanChunk(&job->chunks[index], job);
+
+		pthread_mutex_lock(&job->mutex);
+		job->chunks[index].isDone = true;
+		pthread_cond_signal(&job->isScanned);
+	}
+
+	pthread_mutex_unlock(&job->mutex);
+
+	return NULL;
+}
+
+/*
+ * Finds the regions whose START begins within the chunk. Only an END that also
+ * begins within the chunk is searched for; the last region is left with a NULL
+ * end when its END lies further on, and mergeChunk carries that search on.
+ */
+static void scanChunk(ScanChunk *chunk, ScanJob *job) {
+	const char *startLimit = ((size_t) (job->textEnd - chunk->end) > startLength - 1) ? chunk->end + startLength - 1 : job->textEnd;
+	const char *endLimit = ((size_t) (job->textEnd - chunk->end) > endLength - 1) ? chunk->end + endLength - 1 : job->textEnd;
+	const char *position = chunk->begin;
+	const char *start, *end;
+
+	while (position < chunk->end && (start = searchPattern(position, startLimit - position, startPattern, startLength)) != NULL) {
+		if (atomic_load_explicit(&job->isStopped, memory_order_relaxed)) {
+			break;
+		}
+
+		end = (start + startLength < endLimit) ? searchPattern(start + startLength, endLimit - (start + startLength), endPattern, endLength) : NULL;
+
+		if (chunk->numRegions == chunk->capacity) {
+			chunk->capacity = (chunk->capacity == 0) ? 256 : chunk->capacity * 2;
+			chunk->regions = f668c4bd_realloc(chunk->regions, chunk->capacity * sizeof(Region));
+		}
+
+		chunk->regions[chunk->numRegions].start = start;
+		chunk->regions[chunk->numRegions++].end = end;
+
+		if (end == NULL) {
+			break;
+		}
+
+		position = end + endLength;
+	}
+}
+
+/*
+ * Writes the regions of the chunk that the sequential search would find,
+ * given that the next START is the first one at or after position.
+ *
+ * The chunk's own search agrees with the sequential one as soon as position
+ * is not inside one of its regions: there is no START between the end of a
+ * region and the next one it found. Otherwise, which happens when a region
+ * of the previous chunk ran into this one, the search is carried on here
+ * until the two are in step again. The same goes for the END of a region
+ * that lies beyond the chunk. Returns false once no region can follow.
+ */
+static bool mergeChunk(const ScanChunk *chunk, const char **position, const char *textEnd) {
+	const Region *region;
+	const char *start, *end;
+	uint32_t i = 0;
+	bool isInStep;
+
+	while (true) {
+		while (i < chunk->numRegions && chunk->regions[i].start < *position) {
+			i++;
+		}
+
+		if (i == 0) {
+			isInStep = true;
+		} else {
+			region = &chunk->regions[i - 1];
+			isInStep = (region->end != NULL && *position >= region->end + endLength);
+		}
+
+		if (isInStep) {
+			if (i == chunk->numRegions) {
+				// No START begins in the rest of the chunk
+				if (*position < chunk->end) {
+					*position = chunk->end;
+				}
+
+				return true;
+			}
+
+			start = chunk->regions[i].start;
+			end = chunk->regions[i++].end;
+
+			if (end == NULL) {
+				end = searchPattern(start + startLength, textEnd - (start + startLength), endPattern, endLength);
+			}
+		} else {
+			if ((start = searchPattern(*position, textEnd - *position, startPattern, startLength)) == NULL) {
+				return false;
+			}
+
+			if (start >= chunk->end) {
+				*position = start;
+				return true;
+			}
+
+			end = searchPattern(start + startLength, textEnd - (start + startLength), endPattern, endLength);
+		}
+
+		if (end == NULL) {
+			return false;
+		}
 
-	numBytes = e2f74138_readFile(fileDescriptor, buffer, PHYSICAL_BLOCK_SIZE, pathName);
+		writeRegion(start + startLength, end - (start + startLength));
+		*position = end + endLength;
+	}
+}
+
+/*
+ * The buffer holds the bytes carried over from the previous block followed by
+ * the next block, so a START or END split across two reads is found. Only a
+ * region that spans blocks is gathered in a StringBuilder; one that lies
+ * within the buffer is written from it.
+ */
+static void extractStreamRegions(int fileDescriptor) {
+	char *buffer = f668c4bd_malloc(BLOCK_SIZE + (startLength > endLength ? startLength : endLength));
+	StringBuilder *textBlock = NULL;
+	const char *match;
+	size_t length, carry = 0, offset, keep;
+	ssize_t numBytes;
+	bool isInRegion = false;
+
+	numBytes = e2f74138_readFile(fileDescriptor, buffer, BLOCK_SIZE, pathName);
 	while (numBytes != END_OF_FILE) {
-		// We have not yet found the start of the substring
-		if (startPtr == NULL) {
-			startPtr = f6215943_search(argv[1], buffer);
+		length = carry + numBytes;
+		offset = 0;
 
-			if (startPtr != NULL) {
-				endPtr = strstr(startPtr, argv[2]);
+		while (true) {
+			// We have not yet found the start of the substring
+			if (!isInRegion) {
+				match = searchPattern(buffer + offset, length - offset, startPattern, startLength);
 
-				if (endPtr != NULL) {
-					removeNewline(endPtr);
-					if (startPtr != endPtr) {
-						printf("%s\n", startPtr);
-					}
+				if (match == NULL) {
+					keep = (length - offset < startLength) ? length - offset : startLength - 1;
 					break;
-				} else {
-					// Copy text into StringBuilder from startPtr to end of buffer
-					numBytes -= (startPtr - buffer);
-					textBlock = c598a24c_createStringBuilder_uint32(numBytes << 1);
-					c598a24c_append_string_uint32(textBlock, startPtr, numBytes);
 				}
+
+				offset = (match - buffer) + startLength;
+				isInRegion = true;
 			}
 
-		// Looking for the end of the substring
-		} else {
-			endPtr = strstr(buffer, argv[2]);
+			// Looking for the end of the substring
+			match = searchPattern(buffer + offset, length - offset, endPattern, endLength);
 
-			if (endPtr != NULL) {
-				removeNewline(endPtr);
+			if (match == NULL) {
+				// Copy all text but what could be the beginning of END into the StringBuilder
+				if (textBlock == NULL) {
+					textBlock = c598a24c_createStringBuilder_uint32(BLOCK_SIZE);
+				}
 
-				// Copy text into StringBuilder from start of buffer to endPtr
-				numBytes -= (endPtr - buffer);
-				c598a24c_append_string_uint32(textBlock, buffer, numBytes);
-				printf("%s\n", textBlock->buffer);
+				keep = (length - offset < endLength) ? length - offset : endLength - 1;
+				c598a24c_append_string_uint32(textBlock, buffer + offset, length - offset - keep);
 				break;
+			}
+
+			if (textBlock != NULL && textBlock->length > 0) {
+				c598a24c_append_string_uint32(textBlock, buffer + offset, match - (buffer + offset));
+				writeRegion(textBlock->buffer, textBlock->length);
+				flushRegions();
+				textBlock->length = 0;
 			} else {
-				// Copy all text into StringBuilder from buffer
-				c598a24c_append_string_uint32(textBlock, buffer, numBytes);
+				writeRegion(buffer + offset, match - (buffer + offset));
+			}
+
+			offset = (match - buffer) + endLength;
+			isInRegion = false;
+
+			if (!isAll) {
+				goto cleanUp;
 			}
 		}
 
-		numBytes = e2f74138_readFile(fileDescriptor, buffer, PHYSICAL_BLOCK_SIZE, pathName);
-	}
+		// The regions still point into the buffer
+		flushRegions();
 
-	// Close the file if not STDIN
-	if (fileDescriptor != STDIN_FILENO) {
-		e2f74138_closeFile(fileDescriptor, pathName);
+		memmove(buffer, buffer + length - keep, keep);
+		carry = keep;
+
+		numBytes = e2f74138_readFile(fileDescriptor, buffer + carry, BLOCK_SIZE, pathName);
 	}
 
+cleanUp:
+	flushRegions();
+
 	// Clean up StringBuilder if allocated
 	if (textBlock != NULL) {
 		c598a24c_destroyStringBuilder(textBlock);
 	}
 
-	// Exit with success
-	exit(EXIT_SUCCESS);
+	f668c4bd_free(buffer);
 }
 
-// ═════════════════════════ Function Implementations ═════════════════════════
+// Replaces \t, \n, \r and \\ with the characters they stand for; returns the new length
+static uint32_t unescapePattern(char *text) {
+	char *source = text, *target = text;
+
+	for (; *source != '\0'; source++) {
+		if (source[0] == '\\' && source[1] != '\0') {
+			switch (*++source) {
+				case 't':  *target++ = '\t'; break;
+				case 'n':  *target++ = '\n'; break;
+				case 'r':  *target++ = '\r'; break;
+				case '\\': *target++ = '\\'; break;
+				default:   *target++ = '\\'; *target++ = *source;
+			}
+		} else {
+			*target++ = *source;
+		}
+	}
+
+	*target = '\0';
+
+	return target - text;
+}
+
+/*
+ * Reads the spec file, one "ID<TAB>START<TAB>END" per line. Blank lines and
+ * lines starting with '#' are skipped; START and END may use \t, \n, \r and \\.
+ */
+static void loadPatternPairs(char *specFileName) {
+	FILE *specFile = fopen(specFileName, "r");
+	PatternPair *pair;
+	char *line = NULL, *start, *end;
+	size_t lineSize = 0;
+	ssize_t lineLength;
+	uint32_t lineNumber = 0, capacity = 0;
+
+	if (specFile == NULL) {
+		c7c88e52_printLibError(specFileName, errno);
+		exit(EXIT_FAILURE);
+	}
+
+	while ((lineLength = getline(&line, &lineSize, specFile)) >= 0) {
+		lineNumber++;
+
+		if (lineLength > 0 && line[lineLength - 1] == '\n') {
+			line[--lineLength] = '\0';
+		}
+
+		if (lineLength == 0 || line[0] == '#') {
+			continue;
+		}
+
+		if ((start = strchr(line, '\t')) == NULL || (end = strchr(start + 1, '\t')) == NULL || start == line
+		        || strchr(end + 1, '\t') != NULL) {
+			fprintf(stderr, "%s: %s:%u: expected ID, START and END separated by tabs\n", programName, specFileName, lineNumber);
+			exit(EXIT_FAILURE);
+		}
+
+		*start++ = '\0';
+		*end++ = '\0';
+
+		if (numPairs == capacity) {
+			capacity = (capacity == 0) ? 16 : capacity * 2;
+			patternPairs = f668c4bd_realloc(patternPairs, capacity * sizeof(PatternPair));
+		}
+
+		pair = &patternPairs[numPairs];
+		f668c4bd_meminit(pair, sizeof(PatternPair));
+
+		pair->tag = f6215943_concatenate(line, "\t", NULL);
+		pair->tagLength = strlen(pair->tag);
+		pair->startLength = unescapePattern(start);
+		pair->endLength = unescapePattern(end);
+
+		if (pair->startLength == 0 || pair->endLength == 0) {
+			fprintf(stderr, "%s: %s:%u: START and END cannot be empty\n", programName, specFileName, lineNumber);
+			exit(EXIT_FAILURE);
+		}
+
+		pair->startString = addPatternString(start, pair->startLength);
+		pair->endString = addPatternString(end, pair->endLength);
+
+		numPairs++;
+	}
+
+	free(line);
+	fclose(specFile);
+
+	if (numPairs == 0) {
+		fprintf(stderr, "%s: %s: no START and END pairs found\n", programName, specFileName);
+		exit(EXIT_FAILURE);
+	}
+}
+
+// Adds the string to the automaton's trie unless it is already there; returns its index
+static uint32_t addPatternString(const char *text, uint32_t length) {
+	static uint32_t capacity = 0, nodeCapacity = 0;
+	PatternString *string;
+	uint32_t node = 0, *next;
+
+	if (automaton.numNodes == 0) {
+		nodeCapacity = 64;
+		automaton.transitions = f668c4bd_malloc(nodeCapacity * 256 * sizeof(uint32_t));
+		automaton.outputs = f668c4bd_malloc(nodeCapacity * sizeof(uint32_t));
+		f668c4bd_meminit(automaton.transitions, 256 * sizeof(uint32_t));
+		automaton.outputs[0] = NO_PATTERN;
+		automaton.numNodes = 1;
+	}
+
+	// Zero stands for no child here, as no edge leads back to the root
+	for (uint32_t i = 0; i < length; i++) {
+		next = &automaton.transitions[(node * 256) + (uint8_t) text[i]];
+
+		if (*next == 0) {
+			if (automaton.numNodes == nodeCapacity) {
+				nodeCapacity *= 2;
+				automaton.transitions = f668c4bd_realloc(automaton.transitions, nodeCapacity * 256 * sizeof(uint32_t));
+				automaton.outputs = f668c4bd_realloc(automaton.outputs, nodeCapacity * sizeof(uint32_t));
+				next = &automaton.transitions[(node * 256) + (uint8_t) text[i]];
+			}
+
+			f668c4bd_meminit(&automaton.transitions[automaton.numNodes * 256], 256 * sizeof(uint32_t));
+			automaton.outputs[automaton.numNodes] = NO_PATTERN;
+			*next = automaton.numNodes++;
+		}
+
+		node = *next;
+	}
+
+	if (automaton.outputs[node] != NO_PATTERN) {
+		return automaton.outputs[node];
+	}
+
+	if (automaton.numStrings == capacity) {
+		capacity = (capacity == 0) ? 32 : capacity * 2;
+		automaton.strings = f668c4bd_realloc(automaton.strings, capacity * sizeof(PatternString));
+	}
+
+	string = &automaton.strings[automaton.numStrings];
+	string->nextOutput = NO_PATTERN;
+	string->numUses = 0;
+
+	automaton.outputs[node] = automaton.numStrings;
+
+	return automaton.numStrings++;
+}
+
+/*
+ * Computes the failure links breadth first and folds them into the
+ * transition table, so the scan never follows one. Then groups the uses by
+ * string, in the order of the pairs.
+ */
+static void buildAutomaton() {
+	uint32_t *failures = f668c4bd_malloc(automaton.numNodes * sizeof(uint32_t));
+	uint32_t *queue = f668c4bd_malloc(automaton.numNodes * sizeof(uint32_t));
+	uint32_t *transitions, *failureTransitions;
+	uint32_t head = 0, tail = 0, node, child, index;
+	PatternString *string;
+
+	for (uint32_t c = 0; c < 256; c++) {
+		if ((child = automaton.transitions[c]) != 0) {
+			failures[child] = 0;
+			queue[tail++] = child;
+		}
+	}
+
+	if (tail <= sizeof(automaton.firstBytes)) {
+		for (uint32_t c = 0; c < 256; c++) {
+			if (automaton.transitions[c] != 0) {
+				automaton.firstBytes[automaton.numFirstBytes++] = c;
+			}
+		}
+	}
+
+	while (head < tail) {
+		node = queue[head++];
+		transitions = &automaton.transitions[node * 256];
+		failureTransitions = &automaton.transitions[failures[node] * 256];
+
+		for (uint32_t c = 0; c < 256; c++) {
+			if ((child = transitions[c]) != 0) {
+				failures[child] = failureTransitions[c];
+				queue[tail++] = child;
+
+				if ((index = automaton.outputs[child]) != NO_PATTERN) {
+					automaton.strings[index].nextOutput = automaton.outputs[failures[child]];
+				} else {
+					automaton.outputs[child] = automaton.outputs[failures[child]];
+				}
+			} else {
+				transitions[c] = failureTransitions[c];
+			}
+		}
+	}
+
+	f668c4bd_free(queue);
+	f668c4bd_free(failures);
+
+	for (uint32_t i = 0; i < numPairs; i++) {
+		automaton.strings[patternPairs[i].startString].numUses++;
+		automaton.strings[patternPairs[i].endString].numUses++;
+	}
+
+	for (uint32_t i = 0, firstUse = 0; i < automaton.numStrings; i++) {
+		automaton.strings[i].firstUse = firstUse;
+		firstUse += automaton.strings[i].numUses;
+		automaton.strings[i].numUses = 0;
+	}
+
+	automaton.uses = f668c4bd_malloc(2 * numPairs * sizeof(PatternUse));
+
+	for (uint32_t i = 0; i < 2 * numPairs; i++) {
+		string = &automaton.strings[(i & 1) ? patternPairs[i / 2].endString : patternPairs[i / 2].startString];
+
+		automaton.uses[string->firstUse + string->numUses].pairIndex = i / 2;
+		automaton.uses[string->firstUse + string->numUses++].isEnd = i & 1;
+	}
+
+	automaton.state = 0;
+}
+
+// Returns the position of the next byte that leaves the root, or length
+static size_t skipToFirstByte(const char *block, size_t position, size_t length) {
+	const __m128i first = _mm_set1_epi8(automaton.firstBytes[0]);
+	const __m128i second = _mm_set1_epi8(automaton.firstBytes[(automaton.numFirstBytes > 1) ? 1 : 0]);
+	const __m128i third = _mm_set1_epi8(automaton.firstBytes[(automaton.numFirstBytes > 2) ? 2 : 0]);
+	const __m128i fourth = _mm_set1_epi8(automaton.firstBytes[(automaton.numFirstBytes > 3) ? 3 : 0]);
+	__m128i text;
+	uint32_t mask;
+
+	for (; position + sizeof(__m128i) <= length; position += sizeof(__m128i)) {
+		text = _mm_loadu_si128((const __m128i *) (block + position));
+		mask = _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(text, first), _mm_cmpeq_epi8(text, second)),
+		                                      _mm_or_si128(_mm_cmpeq_epi8(text, third), _mm_cmpeq_epi8(text, fourth))));
+
+		if (mask != 0) {
+			return position + __builtin_ctz(mask);
+		}
+	}
+
+	for (; position < length; position++) {
+		if (automaton.transitions[(uint8_t) block[position]] != 0) {
+			return position;
+		}
+	}
+
+	return length;
+}
+
+/*
+ * Runs the automaton over the next block of the input, which begins at
+ * blockOffset, and writes every region that ends in it. A mapped block is the
+ * whole input; otherwise the regions still open at the end of the block are
+ * saved in their StringBuilders. Returns false once every pair is done.
+ */
+static bool scanPatterns(const char *block, size_t length, uint64_t blockOffset, bool isMapped) {
+	const uint32_t *transitions = automaton.transitions;
+	const uint32_t *outputs = automaton.outputs;
+	uint32_t state = automaton.state, index;
+	const PatternString *string;
+	const PatternUse *use;
+	PatternPair *pair;
+	uint64_t matchEnd, endStart;
+
+	for (size_t i = 0; i < length; i++) {
+		if (state == 0 && automaton.numFirstBytes > 0 && (i = skipToFirstByte(block, i, length)) == length) {
+			break;
+		}
+
+		state = transitions[(state * 256) + (uint8_t) block[i]];
+
+		for (index = outputs[state]; index != NO_PATTERN; index = string->nextOutput) {
+			string = &automaton.strings[index];
+			matchEnd = blockOffset + i + 1;
+
+			for (use = &automaton.uses[string->firstUse]; use < &automaton.uses[string->firstUse + string->numUses]; use++) {
+				pair = &patternPairs[use->pairIndex];
+
+				if (pair->isDone) {
+					continue;
+				}
+
+				if (!use->isEnd) {
+					if (!pair->isInRegion && matchEnd - pair->startLength >= pair->minStart) {
+						pair->regionStart = matchEnd;
+						pair->isInRegion = true;
+					}
+
+					continue;
+				}
+
+				endStart = matchEnd - pair->endLength;
+
+				if (!pair->isInRegion || endStart < pair->regionStart) {
+					continue;
+				}
+
+				if (pair->textBlock == NULL || pair->textBlock->length == 0) {
+					writeTaggedRegion(pair->tag, pair->tagLength, block + (pair->regionStart - blockOffset), endStart - pair->regionStart);
+				} else {
+					// The END may itself have begun in the previous block
+					if (endStart >= blockOffset) {
+						c598a24c_append_string_uint32(pair->textBlock, block, endStart - blockOffset);
+					} else {
+						pair->textBlock->length = endStart - pair->regionStart;
+					}
+
+					writeTaggedRegion(pair->tag, pair->tagLength, pair->textBlock->buffer, pair->textBlock->length);
+					flushRegions();
+					pair->textBlock->length = 0;
+				}
+
+				pair->isInRegion = false;
+				pair->minStart = matchEnd;
+
+				if (!isAll) {
+					pair->isDone = true;
+
+					if (++automaton.numDone == numPairs) {
+						return false;
+					}
+				}
+			}
+		}
+	}
+
+	automaton.state = state;
+
+	if (!isMapped) {
+		for (uint32_t i = 0; i < numPairs; i++) {
+			pair = &patternPairs[i];
+
+			if (pair->isInRegion && !pair->isDone) {
+				if (pair->textBlock == NULL) {
+					pair->textBlock = c598a24c_createStringBuilder_uint32(BLOCK_SIZE);
+				}
+
+				index = (pair->regionStart > blockOffset) ? pair->regionStart - blockOffset : 0;
+				c598a24c_append_string_uint32(pair->textBlock, block + index, length - index);
+			}
+		}
+	}
+
+	return true;
+}
+
+// The automaton keeps its state from one block to the next, so nothing is carried over
+static void extractStreamPatterns(int fileDescriptor) {
+	char *buffer = f668c4bd_malloc(BLOCK_SIZE);
+	uint64_t blockOffset = 0;
+	ssize_t numBytes;
+
+	while ((numBytes = e2f74138_readFile(fileDescriptor, buffer, BLOCK_SIZE, pathName)) != END_OF_FILE) {
+		if (!scanPatterns(buffer, numBytes, blockOffset, false)) {
+			break;
+		}
+
+		// The regions still point into the buffer
+		flushRegions();
+		blockOffset += numBytes;
+	}
+
+	flushRegions();
+
+	for (uint32_t i = 0; i < numPairs; i++) {
+		if (patternPairs[i].textBlock != NULL) {
+			c598a24c_destroyStringBuilder(patternPairs[i].textBlock);
+		}
+	}
+
+	f668c4bd_free(buffer);
+}
+
+static void writeRegion(const char *region, size_t length) {
+	writeTaggedRegion(NULL, 0, region, length);
+}
+
+// Queues the tag, if any, and the region without its trailing newlines and carriage returns
+static void writeTaggedRegion(const char *tag, size_t tagLength, const char *region, size_t length) {
+	static char newline = '\n';
+
+	if (length == 0) {
+		return;
+	}
+
+	while (length > 0 && (region[length - 1] == '\n' || region[length - 1] == '\r')) {
+		length--;
+	}
+
+	if (regionWriter.numIovecs + 3 > MAX_IOVECS) {
+		flushRegions();
+	}
+
+	if (tag != NULL) {
+		regionWriter.iovecs[regionWriter.numIovecs].iov_base = (void *) tag;
+		regionWriter.iovecs[regionWriter.numIovecs++].iov_len = tagLength;
+	}
+
+	regionWriter.iovecs[regionWriter.numIovecs].iov_base = (void *) region;
+	regionWriter.iovecs[regionWriter.numIovecs++].iov_len = length;
+	regionWriter.iovecs[regionWriter.numIovecs].iov_base = &newline;
+	regionWriter.iovecs[regionWriter.numIovecs++].iov_len = 1;
+}
+
+static void flushRegions() {
+	struct iovec *iovec = regionWriter.iovecs;
+	uint32_t numIovecs = regionWriter.numIovecs;
+	ssize_t numBytes;
+
+	while (numIovecs > 0) {
+		numBytes = writev(STDOUT_FILENO, iovec, numIovecs);
+
+		if (numBytes < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			c7c88e52_printLibError("Cannot write to STDOUT", errno);
+			exit(EXIT_FAILURE);
+		}
+
+		// Skip what was written, which may end partway through an iovec
+		for (; numIovecs > 0 && (size_t) numBytes >= iovec->iov_len; iovec++, numIovecs--) {
+			numBytes -= iovec->iov_len;
+		}
+
+		if (numIovecs > 0) {
+			iovec->iov_base = (char *) iovec->iov_base + numBytes;
+			iovec->iov_len -= numBytes;
+		}
+	}
+
+	regionWriter.numIovecs = 0;
+}
+
+/*
+ * Two-byte filter substring search: every position is compared against the
+ * first and the last byte of the pattern sixteen or thirty-two at a time, and
+ * only the positions where both match are compared in full
+ */
+static const char *searchPatternSSE2(const char *text, size_t length, const char *pattern, size_t patternLength) {
+	const __m128i first = _mm_set1_epi8(pattern[0]);
+	const __m128i last = _mm_set1_epi8(pattern[patternLength - 1]);
+	__m128i blockFirst, blockLast;
+	uint32_t mask, bit;
+	size_t i = 0;
+
+	if (patternLength > length) {
+		return NULL;
+	}
+
+	for (; i + patternLength - 1 + sizeof(__m128i) <= length; i += sizeof(__m128i)) {
+		blockFirst = _mm_loadu_si128((const __m128i *) (text + i));
+		blockLast = _mm_loadu_si128((const __m128i *) (text + i + patternLength - 1));
+		mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, blockFirst), _mm_cmpeq_epi8(last, blockLast)));
+
+		while (mask != 0) {
+			bit = __builtin_ctz(mask);
+
+			if (memcmp(text + i + bit + 1, pattern + 1, patternLength - 1) == 0) {
+				return text + i + bit;
+			}
+
+			mask &= mask - 1;
+		}
+	}
+
+	return memmem(text + i, length - i, pattern, patternLength);
+}
+
+__attribute__ ((target ("avx2")))
+static const char *searchPatternAVX2(const char *text, size_t length, const char *pattern, size_t patternLength) {
+	const __m256i first = _mm256_set1_epi8(pattern[0]);
+	const __m256i last = _mm256_set1_epi8(pattern[patternLength - 1]);
+	__m256i blockFirst, blockLast;
+	uint32_t mask, bit;
+	size_t i = 0;
+
+	if (patternLength > length) {
+		return NULL;
+	}
+
+	for (; i + patternLength - 1 + sizeof(__m256i) <= length; i += sizeof(__m256i)) {
+		blockFirst = _mm256_loadu_si256((const __m256i *) (text + i));
+		blockLast = _mm256_loadu_si256((const __m256i *) (text + i + patternLength - 1));
+		mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(first, blockFirst), _mm256_cmpeq_epi8(last, blockLast)));
+
+		while (mask != 0) {
+			bit = __builtin_ctz(mask);
+
+			if (memcmp(text + i + bit + 1, pattern + 1, patternLength - 1) == 0) {
+				return text + i + bit;
+			}
+
+			mask &= mask - 1;
+		}
+	}
+
+	return memmem(text + i, length - i, pattern, patternLength);
+}
@@ -28,184 +28,1114 @@
 
 // ═════════════════════════════════ Includes ═════════════════════════════════
 
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
 
+#include <assert.h>
+#include <emmintrin.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+
+#include <arpa/inet.h>
+
+#include <zlib.h>
+
 #include <locale.h>
 
-#include "org/devopsbroker/adt/listarray.h"
 #include "org/devopsbroker/io/async.h"
 #include "org/devopsbroker/io/filebuffer.h"
 #include "org/devopsbroker/lang/error.h"
+#include "org/devopsbroker/lang/memory.h"
+#include "org/devopsbroker/lang/string.h"
+#include "org/devopsbroker/lang/stringbuilder.h"
 #include "org/devopsbroker/log/logline.h"
 #include "org/devopsbroker/memory/memorypool.h"
 #include "org/devopsbroker/memory/pagepool.h"
 #include "org/devopsbroker/memory/slabpool.h"
-#include "org/devopsbroker/text/linebuffer.h"
-#include "org/devopsbroker/text/regex.h"
+#include "org/devopsbroker/terminal/commandline.h"
 
 // ═══════════════════════════════ Preprocessor ═══════════════════════════════
 
 #define END_OF_FILE   0
 
+#define USAGE_MSG "firelog " ANSI_GOLD "{ -f | -i interval | -j numThreads | -p prefix | -s stateFile | -t topN | --format fmt | -h }" ANSI_YELLOW " [FILE...]"
+
+#define SYSLOG_FILE   "/var/log/syslog"
+
+// Parallel mode reads each byte range in 1 MiB blocks and never splits the
+// file into ranges smaller than that
+#define RANGE_BUFFER_SIZE   1048576
+#define MIN_RANGE_SIZE      1048576
+#define MAX_NUM_THREADS     256
+
+// Default number of seconds between summary refreshes in follow mode
+#define DEFAULT_REFRESH_INTERVAL   60
+
+#define INOTIFY_BUFFER_SIZE   4096
+
+// Gzip inputs are inflated into a ring of RANGE_BUFFER_SIZE buffers
+#define GZIP_NUM_BUFFERS         4
+#define GZIP_INPUT_BUFFER_SIZE   131072
+
+// State file magic number "FLST" and format version
+#define STATE_FILE_MAGIC     0x54534C46
+#define STATE_FILE_VERSION   2
+
+// Initial number of HashIndex slots (must be a power of two)
+#define INDEX_INITIAL_CAPACITY   1024
+
+// Initial number of LogRecordList entries and StringPool strings
+#define RECORD_LIST_INITIAL_SIZE   1024
+#define STRING_POOL_INITIAL_SIZE   64
+
+// Length of an IPv6 address with all eight groups written out
+#define FULL_IPV6_LENGTH   39
+
+#define FNV_OFFSET_BASIS   2166136261u
+#define FNV_PRIME          16777619u
+
+// Size of the buffer the report is formatted into before it is written
+#define OUTPUT_BUFFER_SIZE   1048576
+
+// Top-N statistics keep SKETCH_CAPACITY_FACTOR sketch counters per reported
+// entry, but never fewer than SKETCH_MIN_CAPACITY
+#define MAX_TOP_ENTRIES          1000
+#define SKETCH_CAPACITY_FACTOR   16
+#define SKETCH_MIN_CAPACITY      1024
+#define SKETCH_KEY_SIZE          52
+
+#define MINUTES_PER_HOUR   60
+#define HOURS_PER_DAY      24
+#define MINUTES_PER_DAY    1440
+
+#define HISTOGRAM_BAR_WIDTH   50
+
+// Netfilter prints the fields of a log line right after its log prefix,
+// always starting with "IN="
+#define FIELD_ANCHOR          "IN="
+#define FIELD_ANCHOR_LENGTH   3
+
+// At most MAX_LOG_PREFIXES log prefixes, the defaults included
+#define MAX_LOG_PREFIXES       32
+#define NUM_DEFAULT_PREFIXES   3
+#define MAX_FIELD_EXTRACTORS   16
+
 // ═════════════════════════════════ Typedefs ═════════════════════════════════
 
+/*
+ * Open-addressing hash index over an array. Each slot holds the one-based
+ * array position of an entry (zero means empty) alongside its cached hash
+ * code, so probing only compares entries on a hash match.
+ */
+typedef struct HashIndex {
+	uint32_t *slots;
+	uint32_t *hashCodes;
+	uint32_t  capacity;
+	uint32_t  length;
+} HashIndex;
+
+static_assert(sizeof(HashIndex) == 24, "Check your assumptions");
+
+// How the text of an address is restored from its LogRecord bytes
+typedef enum AddressFormat {
+	ADDRESS_STRING = 0,
+	ADDRESS_IPV4,
+	ADDRESS_IPV6,
+	ADDRESS_IPV6_FULL
+} AddressFormat;
+
+/*
+ * Compact aggregate of BLOCK lines. Addresses are kept in binary, network
+ * byte order, and the remaining string fields are ids into the StringPool of
+ * the LogTable or report that holds the record. An address whose text would
+ * not survive the round trip is interned and its id stored in place of the
+ * address bytes.
+ */
+typedef struct LogRecord {
+	uint8_t  sourceIPAddr[16];
+	uint8_t  destIPAddr[16];
+	uint32_t in;
+	uint32_t out;
+	uint32_t macAddress;
+	uint32_t protocol;
+	uint32_t count;
+	uint16_t sourcePort;
+	uint16_t destPort;
+	uint8_t  sourceFormat;
+	uint8_t  destFormat;
+} LogRecord;
+
+static_assert(sizeof(LogRecord) == 60, "Check your assumptions");
+
+typedef bool (*LogRecordMatcher)(LogRecord *listEntry, LogRecord *logRecord);
+
+// Growable arena of LogRecords, which are addressed by their position
+typedef struct LogRecordList {
+	LogRecord *values;
+	uint32_t   length;
+	uint32_t   size;
+} LogRecordList;
+
+static_assert(sizeof(LogRecordList) == 16, "Check your assumptions");
+
+/*
+ * Interns strings as dense ids. The strings are packed NUL-terminated into a
+ * single buffer and located by their offsets, so the pool takes the same four
+ * allocations no matter how many strings it holds.
+ */
+typedef struct StringPool {
+	HashIndex index;
+	uint32_t *offsets;
+	char     *strings;
+	uint32_t  length;
+	uint32_t  size;
+	uint32_t  stringsLength;
+	uint32_t  stringsSize;
+} StringPool;
+
+static_assert(sizeof(StringPool) == 56, "Check your assumptions");
+
+// Space-Saving counter; count overestimates the true count by at most error
+typedef struct SketchCounter {
+	char     key[SKETCH_KEY_SIZE];
+	uint32_t hashCode;
+	uint32_t count;
+	uint32_t error;
+} SketchCounter;
+
+static_assert(sizeof(SketchCounter) == 64, "Check your assumptions");
+
+/*
+ * Space-Saving heavy-hitters sketch over a fixed number of counters. The
+ * counters sit in a min-heap on their count and are found by key through an
+ * open-addressing index, so an unseen key evicts the smallest counter in
+ * O(log capacity) and memory never grows with the number of distinct keys.
+ */
+typedef struct TopSketch {
+	SketchCounter *counters;
+	uint32_t      *heap;
+	uint32_t      *heapPositions;
+	uint32_t      *slots;
+	uint32_t       capacity;
+	uint32_t       length;
+	uint32_t       mask;
+} TopSketch;
+
+static_assert(sizeof(TopSketch) == 48, "Check your assumptions");
+
+/*
+ * Ring of time buckets keyed by the absolute bucket number, so rings filled
+ * by different threads merge exactly: of two buckets sharing a slot, the
+ * older one has already left the window of the newer one.
+ */
+typedef struct TimeHistogram {
+	int64_t  bucketTimes[MINUTES_PER_HOUR];
+	uint32_t counts[MINUTES_PER_HOUR];
+	int64_t  latestBucket;
+	uint32_t numBuckets;
+	uint32_t bucketWidth;
+} TimeHistogram;
+
+static_assert(sizeof(TimeHistogram) == 736, "Check your assumptions");
+
+// Bounded-memory statistics kept in place of the exact report with -t
+typedef struct Statistics {
+	TopSketch     topSources;
+	TopSketch     topDestPorts;
+	TopSketch     topInterfaces;
+	TimeHistogram minuteHistogram;
+	TimeHistogram hourHistogram;
+	uint64_t      numEvents;
+	uint32_t      numTopEntries;
+} Statistics;
+
+static_assert(sizeof(Statistics) == 1632, "Check your assumptions");
+
+/*
+ * Aggregates BLOCK lines by their exact key: the IN/OUT/MAC/SRC/PROTO tuple
+ * plus SPT and DPT for input lines, and IN/OUT/DST/PROTO/DPT for output lines.
+ * Exact keys can be counted in any order, so every thread fills its own
+ * LogTable and the "same SPT or same DPT" merge rule is only applied when the
+ * LogTables are replayed into the report in file order. With -t the lines
+ * only feed the Statistics of the LogTable instead.
+ */
+typedef struct LogTable {
+	LogRecordList inputList;
+	LogRecordList outputList;
+	HashIndex     inputIndex;
+	HashIndex     outputIndex;
+	StringPool    stringPool;
+	Statistics   *statistics;
+} LogTable;
+
+static_assert(sizeof(LogTable) == 144, "Check your assumptions");
+
+/*
+ * Carries the partial line at the end of one FileBuffer over to the next so
+ * the scanner sees every line whole without copying complete lines.
+ */
+typedef struct LogScanner {
+	LogTable *logTable;
+	char     *buffer;
+	uint32_t  length;
+	uint32_t  size;
+} LogScanner;
+
+static_assert(sizeof(LogScanner) == 24, "Check your assumptions");
+
+// Newline-aligned byte range of the syslog file parsed by one thread
+typedef struct LogWorker {
+	LogTable  logTable;
+	char     *fileName;
+	int64_t   startOffset;
+	int64_t   endOffset;
+	pthread_t thread;
+} LogWorker;
+
+static_assert(sizeof(LogWorker) == 176, "Check your assumptions");
+
+/*
+ * State of follow mode: the open syslog file with its inode and read offset,
+ * the LogTable of lines appended since the last refresh, and the inotify
+ * watch on the directory holding the syslog file.
+ */
+typedef struct LogFollower {
+	LogScanner logScanner;
+	LogTable   logTable;
+	char      *fileName;
+	char      *buffer;
+	int64_t    offset;
+	ino_t      inode;
+	int        fd;
+	int        inotifyFd;
+} LogFollower;
+
+static_assert(sizeof(LogFollower) == 208, "Check your assumptions");
+
+/*
+ * Inflate stage of a gzip input. The inflate thread fills the ring buffers in
+ * order and the scanning thread empties them in the same order; numFull is the
+ * only state they share.
+ */
+typedef struct GzipReader {
+	pthread_mutex_t mutex;
+	pthread_cond_t  isNotEmpty;
+	pthread_cond_t  isNotFull;
+	char           *buffers[GZIP_NUM_BUFFERS];
+	uint32_t        lengths[GZIP_NUM_BUFFERS];
+	gzFile          gzFile;
+	char           *fileName;
+	uint32_t        numFull;
+} GzipReader;
+
+static_assert(sizeof(GzipReader) == 208, "Check your assumptions");
+
+/*
+ * Header of the state file. It is followed by the input and then the output
+ * report LogRecords, the string offsets of the report StringPool and finally
+ * the packed strings themselves.
+ */
+typedef struct StateHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t inode;
+	int64_t  offset;
+	uint64_t fileSize;
+	uint32_t numInputRecords;
+	uint32_t numOutputRecords;
+	uint32_t numStrings;
+	uint32_t stringsLength;
+} StateHeader;
+
+static_assert(sizeof(StateHeader) == 48, "Check your assumptions");
+
+// LogLine field filled in by a field extractor; the string fields come first
+typedef enum LogField {
+	FIELD_IN = 0,
+	FIELD_OUT,
+	FIELD_MAC,
+	FIELD_SRC,
+	FIELD_DST,
+	FIELD_PROTO,
+	FIELD_SPT,
+	FIELD_DPT,
+	FIELD_TYPE
+} LogField;
+
+// Field set of a log line, which depends on the firewall that logged it
+typedef enum LogDialect {
+	DIALECT_IPTABLES = 0,
+	DIALECT_NFTABLES,
+	NUM_LOG_DIALECTS
+} LogDialect;
+
+// "NAME=" token of a log line and the LogLine field it fills in
+typedef struct FieldSpec {
+	char    *name;
+	LogField field;
+} FieldSpec;
+
+static_assert(sizeof(FieldSpec) == 16, "Check your assumptions");
+
+// Log prefix "<prefixStart>...<prefixEnd>" of a dialect; prefixStart may be empty
+typedef struct PrefixSpec {
+	char      *prefixStart;
+	char      *prefixEnd;
+	LogDialect dialect;
+} PrefixSpec;
+
+static_assert(sizeof(PrefixSpec) == 24, "Check your assumptions");
+
+/*
+ * Field extractors of one dialect sorted by the first byte of their name, so
+ * that only extractors firstExtractor[c] up to firstExtractor[c + 1] are tried
+ * on a token starting with c.
+ */
+typedef struct FieldMatcher {
+	FieldSpec extractors[MAX_FIELD_EXTRACTORS];
+	uint32_t  nameLengths[MAX_FIELD_EXTRACTORS];
+	uint8_t   firstExtractor[257];
+} FieldMatcher;
+
+static_assert(sizeof(FieldMatcher) == 584, "Check your assumptions");
+
+// Compiled log prefix; prefixes with the same dispatch key are chained by next
+typedef struct LogPrefix {
+	char         *prefixStart;
+	char         *prefixEnd;
+	FieldMatcher *fieldMatcher;
+	uint32_t      startLength;
+	uint32_t      endLength;
+	uint8_t       next;
+} LogPrefix;
+
+static_assert(sizeof(LogPrefix) == 40, "Check your assumptions");
+
+/*
+ * Log prefixes compiled once at startup. The two bytes that end a log prefix
+ * select the chain of candidate prefixes, so a line is matched against a
+ * single prefix in practice however many dialects are configured.
+ */
+typedef struct LogMatcher {
+	LogPrefix    prefixes[MAX_LOG_PREFIXES];
+	FieldMatcher fieldMatchers[NUM_LOG_DIALECTS];
+	uint8_t      prefixChains[256];
+	uint32_t     numPrefixes;
+} LogMatcher;
+
+static_assert(sizeof(LogMatcher) == 2712, "Check your assumptions");
+
+typedef enum ReportFormat {
+	REPORT_TEXT = 0,
+	REPORT_JSON,
+	REPORT_CSV
+} ReportFormat;
+
+// Buffered writer of the report, bypassing stdio and its locale handling
+typedef struct OutputWriter {
+	char    *buffer;
+	uint32_t length;
+	int      fd;
+} OutputWriter;
+
+static_assert(sizeof(OutputWriter) == 16, "Check your assumptions");
+
+typedef struct FirelogParams {
+	char   **fileNames;
+	char   **logPrefixes;
+	char    *stateFileName;
+	uint32_t numFiles;
+	uint32_t numLogPrefixes;
+	uint32_t numThreads;
+	uint32_t refreshInterval;
+	uint32_t numTopEntries;
+	ReportFormat format;
+	bool     isFollowMode;
+} FirelogParams;
+
+static_assert(sizeof(FirelogParams) == 56, "Check your assumptions");
 
 // ═══════════════════════════ Function Declarations ══════════════════════════
 
-static void initSyslog(AIOContext *aioContext, AIOFile *aioFile, FileBufferList *fileBufferList);
-static void cleanUpSyslog(AIOFile *aioFile, FileBufferList *fileBufferList);
+static void processCmdLine(CmdLineParam *cmdLineParam, FirelogParams *firelogParams);
+
+static void printHelp();
+
+static void printReport();
+static void cleanUpReport();
 
-static void filterInputLogLine(LogLine *logLine);
-static void filterOutputLogLine(LogLine *logLine);
+static void writeTextReport(OutputWriter *outputWriter);
+static void writeJsonReport(OutputWriter *outputWriter);
+static void writeCsvReport(OutputWriter *outputWriter);
+
+static void initOutputWriter(OutputWriter *outputWriter, int fd);
+static void cleanUpOutputWriter(OutputWriter *outputWriter);
+static void flushOutputWriter(OutputWriter *outputWriter);
+static void appendOutput(OutputWriter *outputWriter, char *text);
+static void appendDecimal(OutputWriter *outputWriter, uint32_t value);
+static void appendJsonString(OutputWriter *outputWriter, char *text);
+static void appendCsvField(OutputWriter *outputWriter, char *text);
+static char *formatDecimal(char *buffer, uint32_t value);
+
+static void initSyslog(AIOContext *aioContext, AIOFile *aioFile, FileBufferList *fileBufferList, char *fileName);
+static void cleanUpSyslog(AIOFile *aioFile, FileBufferList *fileBufferList);
+static void readSyslog(char *fileName, LogTable *logTable, int64_t startOffset, int64_t endOffset);
+static void parseSyslog(char *fileName, uint32_t numThreads, int64_t startOffset, int64_t endOffset);
+
+static bool isCompressedFile(char *fileName);
+static void readCompressedSyslog(char *fileName, LogTable *logTable);
+
+static int64_t loadState(char *stateFileName, FileStatus *syslogStatus);
+static void saveState(char *stateFileName, FileStatus *syslogStatus, int64_t offset);
+static int64_t findLastLineEnd(char *fileName, int64_t startOffset, int64_t endOffset);
+
+static void followSyslog(char *fileName, uint32_t refreshInterval);
+
+static uint32_t initLogWorkers(LogWorker *logWorkers, char *fileName, uint32_t numThreads, int64_t startOffset, int64_t endOffset);
+static void *runLogWorker(void *logWorker);
+
+static void initLogTable(LogTable *logTable);
+static void cleanUpLogTable(LogTable *logTable);
+static bool hasLogTableEntries(LogTable *logTable);
+static void replayLogTable(LogTable *logTable);
+
+static void releaseArray(void *values);
+static void initLogRecordList(LogRecordList *logRecordList);
+static void cleanUpLogRecordList(LogRecordList *logRecordList);
+static uint32_t addLogRecord(LogRecordList *logRecordList, LogRecord *logRecord);
+
+static void initStringPool(StringPool *stringPool);
+static void cleanUpStringPool(StringPool *stringPool);
+static uint32_t internString(StringPool *stringPool, char *string);
+static inline char *getString(StringPool *stringPool, uint32_t id);
+
+static char *formatAddress(StringPool *stringPool, uint8_t *address, uint8_t format, char *buffer);
+static void encodeLogRecord(StringPool *stringPool, LogRecord *logRecord, LogLine *logLine);
+
+static void initLogScanner(LogScanner *logScanner, LogTable *logTable);
+static void cleanUpLogScanner(LogScanner *logScanner);
+static void scanLogData(LogScanner *logScanner, char *data, uint32_t length);
+static void finishLogScanner(LogScanner *logScanner);
+
+static void compileLogMatcher(LogMatcher *logMatcher, char **logPrefixes, uint32_t numLogPrefixes);
+static LogPrefix *matchLogPrefix(char *lineStart, char *anchor);
+
+static char *findFieldAnchor(char *position, char *end);
+static bool parseBlockLine(LogLine *logLine, char *lineStart, char *anchor, char *lineEnd);
+static void processLogLine(LogTable *logTable, LogLine *logLine, char *lineStart, char *lineEnd);
+
+static void filterInputLogRecord(LogRecord *logRecord);
+static void filterOutputLogRecord(LogRecord *logRecord);
+
+static Statistics *createStatistics(uint32_t numTopEntries);
+static void destroyStatistics(Statistics *statistics);
+static void updateStatistics(Statistics *statistics, LogLine *logLine, int64_t timestamp);
+static void mergeStatistics(Statistics *statistics, Statistics *other);
+static void printStatistics(Statistics *statistics);
+
+static void initTopSketch(TopSketch *topSketch, uint32_t capacity);
+static void cleanUpTopSketch(TopSketch *topSketch);
+static void updateTopSketch(TopSketch *topSketch, char *key, uint32_t count, uint32_t error);
+static void mergeTopSketch(TopSketch *topSketch, TopSketch *other);
+static void printTopSketch(TopSketch *topSketch, char *title, uint32_t numTopEntries);
+
+static void initTimeHistogram(TimeHistogram *timeHistogram, uint32_t numBuckets, uint32_t bucketWidth);
+static void addTimeBucket(TimeHistogram *timeHistogram, int64_t bucket, uint32_t count);
+static void mergeTimeHistogram(TimeHistogram *timeHistogram, TimeHistogram *other);
+static void printTimeHistogram(TimeHistogram *timeHistogram, char *title);
+
+static void initTimestamps();
+static void civilFromDays(int64_t days, uint32_t *month, uint32_t *day);
+static int64_t parseTimestamp(char *lineStart, char *lineEnd);
+
+static void initHashIndex(HashIndex *index, uint32_t capacity);
+static void cleanUpHashIndex(HashIndex *index);
+static uint32_t findLogRecord(HashIndex *index, LogRecordList *logRecordList, uint32_t hashCode, LogRecord *logRecord, LogRecordMatcher isMatch);
+static void putHashEntry(HashIndex *index, uint32_t hashCode, uint32_t entryNum);
+
+static inline uint32_t hashString(register uint32_t hashCode, register const char *str);
+static uint32_t hashInputTuple(LogRecord *logRecord);
+static uint32_t hashInputLine(LogRecord *logRecord);
+static uint32_t hashOutputTuple(LogRecord *logRecord);
+
+static bool isSameInputLine(LogRecord *listEntry, LogRecord *logRecord);
+static bool isSameSourcePort(LogRecord *listEntry, LogRecord *logRecord);
+static bool isSameDestPort(LogRecord *listEntry, LogRecord *logRecord);
+static bool isSameOutputTuple(LogRecord *listEntry, LogRecord *logRecord);
 
 // ═════════════════════════════ Global Variables ═════════════════════════════
 
-// Input/Output LogLine ListArrays
-ListArray *inputLogLineList;
-ListArray *outputLogLineList;
+// Log file summarized when none is given on the command-line
+char *defaultFileNames[] = { SYSLOG_FILE };
+
+// Input/Output report LogRecords and the StringPool their string ids refer to
+LogRecordList inputRecordList;
+LogRecordList outputRecordList;
+StringPool    reportStringPool;
+
+// Input LogRecords are indexed by both SPT and DPT; output LogRecords by DPT
+HashIndex inputSourcePortIndex;
+HashIndex inputDestPortIndex;
+HashIndex outputIndex;
+
+// Log prefixes and field extractors of the supported log dialects
+LogMatcher logMatcher;
+
+// Format of the report entries
+ReportFormat reportFormat;
+
+// Top-N statistics reported in place of the log entries with -t
+Statistics *reportStatistics;
+
+// Year and month of today; syslog timestamps without a year are placed in the
+// twelve months up to today
+int32_t  currentYear;
+uint32_t currentMonth;
+
+// Private mapping of the state file holding the report entries it restored
+char  *stateMapping;
+size_t stateMappingSize;
 
 // ══════════════════════════════════ main() ══════════════════════════════════
 
 int main(int argc, char *argv[]) {
-	AIOContext     aioContext;
-	AIOFile        aioFile;
-	FileBufferList fileBufferList;
-	FileBuffer    *fileBuffer;
-	int64_t        dataLength;
-	Line           syslogLine;
-	Line          *linePtr = NULL;
+	CmdLineParam   cmdLineParam;
+	FirelogParams  firelogParams;
+	FileStatus     syslogStatus;
+	int64_t        startOffset, endOffset = 0;
+	char          *fileName;
 
 	// For a list of all supported locales, try "locale -a" from the command-line
 	setlocale(LC_ALL, "C.UTF-8");
 
 	programName = "firelog";
 
-	// Create the default LogLine and Input/Output LogLine ListArrays
-	LogLine logLine;
-	inputLogLineList = b196167f_createListArray();
-	outputLogLineList = b196167f_createListArray();
+	d7ad7024_initCmdLineParam(&cmdLineParam, argc, argv, USAGE_MSG);
+	processCmdLine(&cmdLineParam, &firelogParams);
+	reportFormat = firelogParams.format;
+	compileLogMatcher(&logMatcher, firelogParams.logPrefixes, firelogParams.numLogPrefixes);
 
-	// Compile the BLOCK header regular expression
-	regex_t regExpr;
-	b395ed5f_compileRegExpr(&regExpr, "\\[.* BLOCK\\] ", REG_EXTENDED);
+	if (firelogParams.numTopEntries > 0) {
+		initTimestamps();
+		reportStatistics = createStatistics(firelogParams.numTopEntries);
+	}
 
-	// Initialize the syslog file handling
-	initSyslog(&aioContext, &aioFile, &fileBufferList);
+	// Create the Input/Output report LogRecordLists
+	initLogRecordList(&inputRecordList);
+	initLogRecordList(&outputRecordList);
+	initStringPool(&reportStringPool);
+	initHashIndex(&inputSourcePortIndex, INDEX_INITIAL_CAPACITY);
+	initHashIndex(&inputDestPortIndex, INDEX_INITIAL_CAPACITY);
+	initHashIndex(&outputIndex, INDEX_INITIAL_CAPACITY);
+
+	if (firelogParams.isFollowMode) {
+		// Never returns; the user ends follow mode with Ctrl-C
+		followSyslog(firelogParams.fileNames[0], firelogParams.refreshInterval);
+	}
 
-	// Process /var/log/syslog file
-	dataLength = aioFile.fileSize;
+	// Process the log files in order, i.e. oldest rotation first
+	for (uint32_t i = 0; i < firelogParams.numFiles; i++) {
+		fileName = firelogParams.fileNames[i];
 
-	while (dataLength > 0) {
-		ce97d170_readFileBufferList(&aioFile, &fileBufferList, dataLength);
-		fileBuffer = fileBufferList.values[0];
+		if (isCompressedFile(fileName)) {
+			LogTable logTable;
 
-		while (fileBuffer != NULL) {
-			dataLength -= fileBuffer->numBytes;
-			linePtr = c196bc72_getLineFromFileBuffer(&syslogLine, fileBuffer);
+			initLogTable(&logTable);
+			readCompressedSyslog(fileName, &logTable);
+			replayLogTable(&logTable);
+			cleanUpLogTable(&logTable);
+			continue;
+		}
 
-			while (linePtr != NULL) {
-				fileBuffer->dataOffset += (linePtr->length + 1);
+		e2f74138_getFileStatus(fileName, &syslogStatus);
+		startOffset = 0;
+		endOffset = syslogStatus.st_size;
 
-				// Check for a firewall BLOCK header
-				if (b395ed5f_matchRegExpr(&regExpr, linePtr->value, 0)) {
-					b45c9f7e_initLogLine(&logLine, linePtr);
+		// Restore the report and only parse what was appended since the last run
+		if (firelogParams.stateFileName != NULL) {
+			startOffset = loadState(firelogParams.stateFileName, &syslogStatus);
+			endOffset = findLastLineEnd(fileName, startOffset, endOffset);
+		}
 
-					if (*logLine.in) {
-						filterInputLogLine(&logLine);
-					} else {
-						filterOutputLogLine(&logLine);
-					}
+		parseSyslog(fileName, firelogParams.numThreads, startOffset, endOffset);
+	}
+
+	b86b2c8d_destroyMemoryPool(false);
+	f502a409_destroyPagePool(false);
+	b426145b_destroySlabPool(false);
+
+	// Free memory allocated for the LogRecord indexes
+	cleanUpHashIndex(&inputSourcePortIndex);
+	cleanUpHashIndex(&inputDestPortIndex);
+	cleanUpHashIndex(&outputIndex);
+
+	if (firelogParams.stateFileName != NULL) {
+		saveState(firelogParams.stateFileName, &syslogStatus, endOffset);
+	}
+
+	printReport();
+	cleanUpReport();
+
+	// Exit with success
+	exit(EXIT_SUCCESS);
+}
+
+// ═════════════════════════ Function Implementations ═════════════════════════
+
+/* ¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯
+ * Possible command-line options:
+ *
+ *   -f -> Follow mode
+ *   -i -> Refresh interval in seconds
+ *   -j -> Number of threads
+ *   -p -> Additional nftables log prefix
+ *   -s -> State file
+ *   -t -> Number of top-N entries
+ *   --format -> Report format (text, json or csv)
+ *   -h -> Help
+ *
+ * Any other arguments are log files, which may be gzip-compressed
+
+ * ----------------------------------------------------------------------------
+ */
+static void processCmdLine(CmdLineParam *cmdLineParam, FirelogParams *firelogParams) {
+	register int argc = cmdLineParam->argc;
+	register char **argv = cmdLineParam->argv;
+
+	// Perform initializations
+	f668c4bd_meminit(firelogParams, sizeof(FirelogParams));
+	firelogParams->fileNames = f668c4bd_malloc(argc * sizeof(char*));
+	firelogParams->logPrefixes = f668c4bd_malloc(argc * sizeof(char*));
+	firelogParams->numThreads = 1;
+	firelogParams->refreshInterval = DEFAULT_REFRESH_INTERVAL;
+
+	for (int i = 1; i < argc; i++) {
+		if (argv[i][0] == '-') {
+			if (f6215943_isEqual(argv[i], "--format")) {
+				char *format = d7ad7024_getString(cmdLineParam, "report format", i++);
+
+				if (f6215943_isEqual(format, "text")) {
+					firelogParams->format = REPORT_TEXT;
+				} else if (f6215943_isEqual(format, "json")) {
+					firelogParams->format = REPORT_JSON;
+				} else if (f6215943_isEqual(format, "csv")) {
+					firelogParams->format = REPORT_CSV;
+				} else {
+					c7c88e52_invalidValue("report format", format);
+					c7c88e52_printUsage(USAGE_MSG);
+					exit(EXIT_FAILURE);
+				}
+			} else if (argv[i][1] == 'f' || f6215943_isEqual(argv[i], "--follow")) {
+				firelogParams->isFollowMode = true;
+			} else if (argv[i][1] == 'i') {
+				firelogParams->refreshInterval = d7ad7024_getUint32(cmdLineParam, "refresh interval", i++);
+
+				if (firelogParams->refreshInterval == 0) {
+					c7c88e52_invalidValue("refresh interval", argv[i]);
+					c7c88e52_printUsage(USAGE_MSG);
+					exit(EXIT_FAILURE);
 				}
+			} else if (argv[i][1] == 'j') {
+				firelogParams->numThreads = d7ad7024_getUint32(cmdLineParam, "number of threads", i++);
 
-				linePtr = c196bc72_getLineFromFileBuffer(&syslogLine, fileBuffer);
-			}
+				if (firelogParams->numThreads == 0 || firelogParams->numThreads > MAX_NUM_THREADS) {
+					c7c88e52_invalidValue("number of threads", argv[i]);
+					c7c88e52_printUsage(USAGE_MSG);
+					exit(EXIT_FAILURE);
+				}
+			} else if (argv[i][1] == 'p') {
+				char *logPrefix = d7ad7024_getString(cmdLineParam, "log prefix", i++);
+				char *wildcard = strchr(logPrefix, '*');
+
+				// The last two characters of a log prefix are its dispatch key
+				if (f6215943_getLength((wildcard == NULL) ? logPrefix : wildcard + 1) < 2 || (wildcard != NULL && strchr(wildcard + 1, '*') != NULL)) {
+					c7c88e52_invalidValue("log prefix", logPrefix);
+					c7c88e52_printUsage(USAGE_MSG);
+					exit(EXIT_FAILURE);
+				}
 
-			fileBuffer = fileBuffer->next;
+				if (firelogParams->numLogPrefixes == MAX_LOG_PREFIXES - NUM_DEFAULT_PREFIXES) {
+					c7c88e52_printError_string("too many log prefixes\n\n");
+					c7c88e52_printUsage(USAGE_MSG);
+					exit(EXIT_FAILURE);
+				}
 
-			if (fileBuffer == NULL)  {
-				ce97d170_resetFileBufferList(&fileBufferList, f502a409_releasePage);
+				firelogParams->logPrefixes[firelogParams->numLogPrefixes++] = logPrefix;
+			} else if (argv[i][1] == 's') {
+				firelogParams->stateFileName = d7ad7024_getString(cmdLineParam, "state file", i++);
+			} else if (argv[i][1] == 't') {
+				firelogParams->numTopEntries = d7ad7024_getUint32(cmdLineParam, "number of top entries", i++);
+
+				if (firelogParams->numTopEntries == 0 || firelogParams->numTopEntries > MAX_TOP_ENTRIES) {
+					c7c88e52_invalidValue("number of top entries", argv[i]);
+					c7c88e52_printUsage(USAGE_MSG);
+					exit(EXIT_FAILURE);
+				}
+			} else if (argv[i][1] == 'h') {
+				printHelp();
+				exit(EXIT_SUCCESS);
+			} else {
+				c7c88e52_invalidOption(argv[i]);
+				c7c88e52_printUsage(USAGE_MSG);
+				exit(EXIT_FAILURE);
 			}
+		} else {
+			firelogParams->fileNames[firelogParams->numFiles++] = argv[i];
 		}
 	}
 
-	// Clean up the AIOContext
-	f1207515_cleanUpAIOContext(&aioContext);
-	cleanUpSyslog(&aioFile, &fileBufferList);
-	b86b2c8d_destroyMemoryPool(false);
-	f502a409_destroyPagePool(false);
-	b426145b_destroySlabPool(false);
+	if (firelogParams->numFiles == 0) {
+		f668c4bd_free(firelogParams->fileNames);
+		firelogParams->fileNames = defaultFileNames;
+		firelogParams->numFiles = 1;
+	}
 
-	// Free memory allocated for the regular expression
-	b395ed5f_freeRegExpr(&regExpr);
+	// Follow mode never finishes a run, so there is no state to save
+	if (firelogParams->isFollowMode && firelogParams->stateFileName != NULL) {
+		c7c88e52_printError_string("cannot use a state file in follow mode\n\n");
+		c7c88e52_printUsage(USAGE_MSG);
+		exit(EXIT_FAILURE);
+	}
 
-	register uint32_t listLength;
-	register void **listValues;
-	register uint32_t i;
-	register LogLine *listEntry;
+	// Only the log entries can be written as JSON or CSV
+	if (firelogParams->numTopEntries > 0 && firelogParams->format != REPORT_TEXT) {
+		c7c88e52_printError_string("top-N statistics are only reported as text\n\n");
+		c7c88e52_printUsage(USAGE_MSG);
+		exit(EXIT_FAILURE);
+	}
 
-	// Process the inputLogLineList entries
-	if (inputLogLineList->length > 0) {
-		listLength = inputLogLineList->length;
-		listValues = inputLogLineList->values;
-		i = 0;
+	// The state file holds the exact report, which -t does not keep
+	if (firelogParams->numTopEntries > 0 && firelogParams->stateFileName != NULL) {
+		c7c88e52_printError_string("cannot use a state file with top-N statistics\n\n");
+		c7c88e52_printUsage(USAGE_MSG);
+		exit(EXIT_FAILURE);
+	}
 
-		d99c60f5_printBox("firelog INPUT BLOCK Log Entries", false);
+	// Both follow mode and the state file track a single live log file
+	if ((firelogParams->isFollowMode || firelogParams->stateFileName != NULL) && firelogParams->numFiles > 1) {
+		c7c88e52_printError_string("follow mode and the state file take a single log file\n\n");
+		c7c88e52_printUsage(USAGE_MSG);
+		exit(EXIT_FAILURE);
+	}
+
+	// The state file resumes from a byte offset, which a gzip file does not have
+	if (firelogParams->stateFileName != NULL && isCompressedFile(firelogParams->fileNames[0])) {
+		c7c88e52_printError_string("cannot use a state file with a gzip-compressed log file\n\n");
+		c7c88e52_printUsage(USAGE_MSG);
+		exit(EXIT_FAILURE);
+	}
+}
+
+static void printHelp() {
+	c7c88e52_printUsage(USAGE_MSG);
+
+	puts("\nSummarizes the firewall BLOCK entries of the given log files (default " SYSLOG_FILE ")");
+	puts("Recognizes the ufw \"[UFW BLOCK] \" and firewalld \"<zone>_REJECT: \" and \"<zone>_DROP: \" log prefixes");
+
+	puts(ANSI_BOLD "\nExamples:" ANSI_RESET);
+	puts("  firelog");
+	puts("  firelog -j 8");
+	puts("  firelog --follow -i 300");
+	puts("  firelog -s /var/lib/firelog/state");
+	puts("  firelog -t 10 -j 4");
+	puts("  firelog -p '[nft *DROP] '");
+	puts("  firelog --format json /var/log/syslog.1 /var/log/syslog");
+	puts("  firelog /var/log/syslog.2.gz /var/log/syslog.1 /var/log/syslog");
+
+	puts(ANSI_BOLD "\nValid Options:\n");
+	puts(ANSI_YELLOW "  -f\t" ANSI_ROMANTIC "Follow the log and refresh the summary as entries are appended");
+	puts(ANSI_BOLD ANSI_YELLOW "  -i\t" ANSI_ROMANTIC "Seconds between summary refreshes in follow mode (default 60)");
+	puts(ANSI_BOLD ANSI_YELLOW "  -j\t" ANSI_ROMANTIC "Number of threads parsing the log in parallel");
+	puts(ANSI_BOLD ANSI_YELLOW "  -p\t" ANSI_ROMANTIC "Also summarize nftables entries with this log prefix, where '*' matches any text");
+	puts(ANSI_BOLD ANSI_YELLOW "  -s\t" ANSI_ROMANTIC "Resume the summary from a state file and save it for the next run");
+	puts(ANSI_BOLD ANSI_YELLOW "  -t\t" ANSI_ROMANTIC "Report the top N sources, ports and interfaces and the BLOCK events per minute and hour");
+	puts(ANSI_BOLD ANSI_YELLOW "  --format\t" ANSI_ROMANTIC "Write the log entries as text (default), json or csv");
+	puts(ANSI_BOLD ANSI_YELLOW "  -h\t" ANSI_ROMANTIC "Print this help message\n");
+}
+
+static void printReport() {
+	OutputWriter outputWriter;
+
+	// The top-N statistics replace the log entries
+	if (reportStatistics != NULL) {
+		printStatistics(reportStatistics);
+		return;
+	}
+
+	initOutputWriter(&outputWriter, STDOUT_FILENO);
+
+	switch (reportFormat) {
+		case REPORT_JSON:
+			writeJsonReport(&outputWriter);
+			break;
+		case REPORT_CSV:
+			writeCsvReport(&outputWriter);
+			break;
+		default:
+			writeTextReport(&outputWriter);
+	}
+
+	cleanUpOutputWriter(&outputWriter);
+}
+
+/*
+ * Count: 3 IN=enp4s0 MAC=... SRC=192.168.1.110 DST=192.168.1.255 PROTO=UDP SPT=59391 DPT=15600
+ * Count: 1 OUT=enp4s0 SRC=... DST=... PROTO=UDP SPT=45771 DPT=19302
+ *
+ * ICMP input entries print TYPE= in place of SPT= and DPT=.
+ */
+static void writeTextReport(OutputWriter *outputWriter) {
+	char sourceBuffer[INET6_ADDRSTRLEN], destBuffer[INET6_ADDRSTRLEN];
+	register LogRecord *listEntry;
+	register LogRecord *listEnd;
+
+	// Print the input report entries
+	if (inputRecordList.length > 0) {
+		listEntry = inputRecordList.values;
+		listEnd = listEntry + inputRecordList.length;
 
-		// Loop over the inputLogLineList entries and free the LogLine buffers and instances
-		while (i < listLength) {
-			listEntry = listValues[i++];
+		d99c60f5_printBox("firelog INPUT BLOCK Log Entries", false);
+		fflush(stdout);
+
+		// Loop over the input report entries
+		for (; listEntry < listEnd; listEntry++) {
+			appendOutput(outputWriter, "Count: ");
+			appendDecimal(outputWriter, listEntry->count);
+			appendOutput(outputWriter, " IN=");
+			appendOutput(outputWriter, getString(&reportStringPool, listEntry->in));
+			appendOutput(outputWriter, " MAC=");
+			appendOutput(outputWriter, getString(&reportStringPool, listEntry->macAddress));
+			appendOutput(outputWriter, " SRC=");
+			appendOutput(outputWriter, formatAddress(&reportStringPool, listEntry->sourceIPAddr, listEntry->sourceFormat, sourceBuffer));
+			appendOutput(outputWriter, " DST=");
+			appendOutput(outputWriter, formatAddress(&reportStringPool, listEntry->destIPAddr, listEntry->destFormat, destBuffer));
+			appendOutput(outputWriter, " PROTO=");
+			appendOutput(outputWriter, getString(&reportStringPool, listEntry->protocol));
 
 			if (listEntry->destPort == 0) {
-				// Print ICMP firewall entry
-				printf("Count: %u IN=%s MAC=%s SRC=%s DST=%s PROTO=%s TYPE=%u\n", listEntry->count, listEntry->in, listEntry->macAddress, \
-					listEntry->sourceIPAddr, listEntry->destIPAddr, listEntry->protocol, listEntry->sourcePort);
+				appendOutput(outputWriter, " TYPE=");
+				appendDecimal(outputWriter, listEntry->sourcePort);
 			} else {
-				// Print non-ICMP firewall entry
-				printf("Count: %u IN=%s MAC=%s SRC=%s DST=%s PROTO=%s SPT=%u DPT=%u\n", listEntry->count, listEntry->in, listEntry->macAddress, \
-					listEntry->sourceIPAddr, listEntry->destIPAddr, listEntry->protocol, listEntry->sourcePort, listEntry->destPort);
+				appendOutput(outputWriter, " SPT=");
+				appendDecimal(outputWriter, listEntry->sourcePort);
+				appendOutput(outputWriter, " DPT=");
+				appendDecimal(outputWriter, listEntry->destPort);
 			}
 
-			b45c9f7e_destroyLogLine(listEntry);
+			appendOutput(outputWriter, "\n");
 		}
 
-		b196167f_destroyListArray(inputLogLineList, NULL);
-		printf("\n");
+		appendOutput(outputWriter, "\n");
+		flushOutputWriter(outputWriter);
 	}
 
-	fflush(stdout);
-
-	// Process the outputLogLineList entries
-	if (outputLogLineList->length > 0) {
-		listLength = outputLogLineList->length;
-		listValues = outputLogLineList->values;
-		i = 0;
+	// Print the output report entries
+	if (outputRecordList.length > 0) {
+		listEntry = outputRecordList.values;
+		listEnd = listEntry + outputRecordList.length;
 
 		d99c60f5_printBox("firelog OUTPUT BLOCK Log Entries", false);
+		fflush(stdout);
+
+		// Loop over the output report entries
+		for (; listEntry < listEnd; listEntry++) {
+			appendOutput(outputWriter, "Count: ");
+			appendDecimal(outputWriter, listEntry->count);
+			appendOutput(outputWriter, " OUT=");
+			appendOutput(outputWriter, getString(&reportStringPool, listEntry->out));
+			appendOutput(outputWriter, " SRC=");
+			appendOutput(outputWriter, formatAddress(&reportStringPool, listEntry->sourceIPAddr, listEntry->sourceFormat, sourceBuffer));
+			appendOutput(outputWriter, " DST=");
+			appendOutput(outputWriter, formatAddress(&reportStringPool, listEntry->destIPAddr, listEntry->destFormat, destBuffer));
+			appendOutput(outputWriter, " PROTO=");
+			appendOutput(outputWriter, getString(&reportStringPool, listEntry->protocol));
+			appendOutput(outputWriter, " SPT=");
+			appendDecimal(outputWriter, listEntry->sourcePort);
+			appendOutput(outputWriter, " DPT=");
+			appendDecimal(outputWriter, listEntry->destPort);
+			appendOutput(outputWriter, "\n");
+		}
+
+		appendOutput(outputWriter, "\n");
+		flushOutputWriter(outputWriter);
+	}
+}
+
+static void writeJsonField(OutputWriter *outputWriter, char *name, char *value) {
+	appendOutput(outputWriter, ",\"");
+	appendOutput(outputWriter, name);
+	appendOutput(outputWriter, "\":");
+	appendJsonString(outputWriter, value);
+}
+
+static void writeJsonNumber(OutputWriter *outputWriter, char *name, uint32_t value) {
+	appendOutput(outputWriter, ",\"");
+	appendOutput(outputWriter, name);
+	appendOutput(outputWriter, "\":");
+	appendDecimal(outputWriter, value);
+}
+
+/*
+ * {"input":[
+ * {"count":3,"in":"enp4s0","mac":"...","src":"192.168.1.110","dst":"192.168.1.255","proto":"UDP","spt":59391,"dpt":15600},
+ * ...
+ * ],"output":[
+ * {"count":1,"out":"enp4s0","src":"...","dst":"...","proto":"UDP","spt":45771,"dpt":19302}
+ * ]}
+ *
+ * One entry per line; ICMP input entries have "type" in place of "spt" and "dpt".
+ */
+static void writeJsonReport(OutputWriter *outputWriter) {
+	char sourceBuffer[INET6_ADDRSTRLEN], destBuffer[INET6_ADDRSTRLEN];
+	register LogRecord *listEntry;
+
+	appendOutput(outputWriter, "{\"input\":[");
+
+	for (uint32_t i = 0; i < inputRecordList.length; i++) {
+		listEntry = &inputRecordList.values[i];
+
+		appendOutput(outputWriter, (i == 0) ? "\n{\"count\":" : ",\n{\"count\":");
+		appendDecimal(outputWriter, listEntry->count);
+		writeJsonField(outputWriter, "in", getString(&reportStringPool, listEntry->in));
+		writeJsonField(outputWriter, "mac", getString(&reportStringPool, listEntry->macAddress));
+		writeJsonField(outputWriter, "src", formatAddress(&reportStringPool, listEntry->sourceIPAddr, listEntry->sourceFormat, sourceBuffer));
+		writeJsonField(outputWriter, "dst", formatAddress(&reportStringPool, listEntry->destIPAddr, listEntry->destFormat, destBuffer));
+		writeJsonField(outputWriter, "proto", getString(&reportStringPool, listEntry->protocol));
+
+		if (listEntry->destPort == 0) {
+			writeJsonNumber(outputWriter, "type", listEntry->sourcePort);
+		} else {
+			writeJsonNumber(outputWriter, "spt", listEntry->sourcePort);
+			writeJsonNumber(outputWriter, "dpt", listEntry->destPort);
+		}
+
+		appendOutput(outputWriter, "}");
+	}
+
+	appendOutput(outputWriter, "\n],\"output\":[");
+
+	for (uint32_t i = 0; i < outputRecordList.length; i++) {
+		listEntry = &outputRecordList.values[i];
 
-		// Loop over the outputLogLineList entries and free the LogLine buffers and instances
-		while (i < listLength) {
-			listEntry = listValues[i++];
+		appendOutput(outputWriter, (i == 0) ? "\n{\"count\":" : ",\n{\"count\":");
+		appendDecimal(outputWriter, listEntry->count);
+		writeJsonField(outputWriter, "out", getString(&reportStringPool, listEntry->out));
+		writeJsonField(outputWriter, "src", formatAddress(&reportStringPool, listEntry->sourceIPAddr, listEntry->sourceFormat, sourceBuffer));
+		writeJsonField(outputWriter, "dst", formatAddress(&reportStringPool, listEntry->destIPAddr, listEntry->destFormat, destBuffer));
+		writeJsonField(outputWriter, "proto", getString(&reportStringPool, listEntry->protocol));
+		writeJsonNumber(outputWriter, "spt", listEntry->sourcePort);
+		writeJsonNumber(outputWriter, "dpt", listEntry->destPort);
+		appendOutput(outputWriter, "}");
+	}
 
-			printf("Count: %u OUT=%s SRC=%s DST=%s PROTO=%s SPT=%u DPT=%u\n", listEntry->count, listEntry->out, listEntry->sourceIPAddr, \
-				 listEntry->destIPAddr, listEntry->protocol, listEntry->sourcePort, listEntry->destPort);
+	appendOutput(outputWriter, "\n]}\n");
+}
 
-			b45c9f7e_destroyLogLine(listEntry);
+/*
+ * chain,count,in,out,mac,src,dst,proto,spt,dpt,type
+ * INPUT,3,enp4s0,,...,192.168.1.110,192.168.1.255,UDP,59391,15600,
+ * OUTPUT,1,,enp4s0,,...,...,UDP,45771,19302,
+ */
+static void writeCsvReport(OutputWriter *outputWriter) {
+	char sourceBuffer[INET6_ADDRSTRLEN], destBuffer[INET6_ADDRSTRLEN];
+	register LogRecord *listEntry;
+
+	appendOutput(outputWriter, "chain,count,in,out,mac,src,dst,proto,spt,dpt,type\n");
+
+	for (uint32_t i = 0; i < inputRecordList.length; i++) {
+		listEntry = &inputRecordList.values[i];
+
+		appendOutput(outputWriter, "INPUT,");
+		appendDecimal(outputWriter, listEntry->count);
+		appendOutput(outputWriter, ",");
+		appendCsvField(outputWriter, getString(&reportStringPool, listEntry->in));
+		appendOutput(outputWriter, ",,");
+		appendCsvField(outputWriter, getString(&reportStringPool, listEntry->macAddress));
+		appendOutput(outputWriter, ",");
+		appendCsvField(outputWriter, formatAddress(&reportStringPool, listEntry->sourceIPAddr, listEntry->sourceFormat, sourceBuffer));
+		appendOutput(outputWriter, ",");
+		appendCsvField(outputWriter, formatAddress(&reportStringPool, listEntry->destIPAddr, listEntry->destFormat, destBuffer));
+		appendOutput(outputWriter, ",");
+		appendCsvField(outputWriter, getString(&reportStringPool, listEntry->protocol));
+
+		if (listEntry->destPort == 0) {
+			appendOutput(outputWriter, ",,,");
+			appendDecimal(outputWriter, listEntry->sourcePort);
+			appendOutput(outputWriter, "\n");
+		} else {
+			appendOutput(outputWriter, ",");
+			appendDecimal(outputWriter, listEntry->sourcePort);
+			appendOutput(outputWriter, ",");
+			appendDecimal(outputWriter, listEntry->destPort);
+			appendOutput(outputWriter, ",\n");
 		}
+	}
 
-		b196167f_destroyListArray(outputLogLineList, NULL);
-		printf("\n");
+	for (uint32_t i = 0; i < outputRecordList.length; i++) {
+		listEntry = &outputRecordList.values[i];
+
+		appendOutput(outputWriter, "OUTPUT,");
+		appendDecimal(outputWriter, listEntry->count);
+		appendOutput(outputWriter, ",,");
+		appendCsvField(outputWriter, getString(&reportStringPool, listEntry->out));
+		appendOutput(outputWriter, ",,");
+		appendCsvField(outputWriter, formatAddress(&reportStringPool, listEntry->sourceIPAddr, listEntry->sourceFormat, sourceBuffer));
+		appendOutput(outputWriter, ",");
+		appendCsvField(outputWriter, formatAddress(&reportStringPool, listEntry->destIPAddr, listEntry->destFormat, destBuffer));
+		appendOutput(outputWriter, ",");
+		appendCsvField(outputWriter, getString(&reportStringPool, listEntry->protocol));
+		appendOutput(outputWriter, ",");
+		appendDecimal(outputWriter, listEntry->sourcePort);
+		appendOutput(outputWriter, ",");
+		appendDecimal(outputWriter, listEntry->destPort);
+		appendOutput(outputWriter, ",\n");
 	}
+}
 
-	// Exit with success
-	exit(EXIT_SUCCESS);
+// The whole report is released with one call per array
+static void cleanUpReport() {
+	cleanUpLogRecordList(&inputRecordList);
+	cleanUpLogRecordList(&outputRecordList);
+	cleanUpStringPool(&reportStringPool);
+
+	if (reportStatistics != NULL) {
+		destroyStatistics(reportStatistics);
+	}
+
+	if (stateMapping != NULL) {
+		munmap(stateMapping, stateMappingSize);
+	}
 }
 
-// ═════════════════════════ Function Implementations ═════════════════════════
+static void printFileError(char *message, char *fileName, int errorNumber) {
+	StringBuilder errorMessage;
+
+	c598a24c_initStringBuilder(&errorMessage);
+	c598a24c_append_string(&errorMessage, message);
+	c598a24c_append_string(&errorMessage, " '");
+	c598a24c_append_string(&errorMessage, fileName);
+	c598a24c_append_char(&errorMessage, '\'');
+
+	if (errorNumber == 0) {
+		c7c88e52_printError_string(errorMessage.buffer);
+	} else {
+		c7c88e52_printLibError(errorMessage.buffer, errorNumber);
+	}
 
-void initSyslog(AIOContext *aioContext, AIOFile *aioFile, FileBufferList *fileBufferList) {
+	c598a24c_cleanUpStringBuilder(&errorMessage);
+}
+
+void initSyslog(AIOContext *aioContext, AIOFile *aioFile, FileBufferList *fileBufferList, char *fileName) {
 	FileStatus fileStatus;
 
 	// 1. Initialize the FileBufferList struct
@@ -215,7 +1145,7 @@ void initSyslog(AIOContext *aioContext, AIOFile *aioFile, FileBufferList *fileBu
 	f1207515_initAIOContext(aioContext, 8);
 
 	// 3. Initialize the AIOFile struct
-	f1207515_initAIOFile(aioContext, aioFile, "/var/log/syslog");
+	f1207515_initAIOFile(aioContext, aioFile, fileName);
 
 	// 4. Open the file
 	f1207515_open(aioFile, FOPEN_READONLY, 0);
@@ -233,72 +1163,2468 @@ static void cleanUpSyslog(AIOFile *aioFile, FileBufferList *fileBufferList) {
 	ce97d170_cleanUpFileBufferList(fileBufferList, f502a409_releasePage);
 }
 
-/*
- * IN=enp4s0 OUT= MAC=ff:ff:ff:ff:ff:ff:aa:bb:cc:dd:ee:ff:11:00 SRC=192.168.1.110 DST=192.168.1.255 PROTO=UDP SPT=59391 DPT=15600
- *
- * If an input rule triggered:
- *   o Use MAC Address filtering
- *   o Ignore changes in SRC
- *   o Ignore changes in SPT and/or DPT
- */
-void filterInputLogLine(register LogLine *logLine) {
-	register const uint32_t listLength = inputLogLineList->length;
-	register void **listValues = inputLogLineList->values;
-	register uint32_t i = 0;
-	register LogLine *listEntry;
+static void readSyslog(char *fileName, LogTable *logTable, int64_t startOffset, int64_t endOffset) {
+	AIOContext     aioContext;
+	AIOFile        aioFile;
+	FileBufferList fileBufferList;
+	FileBuffer    *fileBuffer;
+	LogScanner     logScanner;
+	int64_t        dataLength;
+
+	// Initialize the syslog file handling
+	initSyslog(&aioContext, &aioFile, &fileBufferList, fileName);
+	initLogScanner(&logScanner, logTable);
 
-	// 1. Loop over the existing inputLogLineList entries
-	while (i < listLength) {
-		listEntry = listValues[i++];
+	// Process the syslog file from startOffset up to endOffset
+	aioFile.offset = startOffset;
+	dataLength = endOffset - startOffset;
 
-		if (f6215943_isEqual(listEntry->in, logLine->in)
-			&& f6215943_isEqual(listEntry->out, logLine->out)
-			&& f6215943_isEqual(listEntry->macAddress, logLine->macAddress)
-			&& f6215943_isEqual(listEntry->sourceIPAddr, logLine->sourceIPAddr)
-			&& f6215943_isEqual(listEntry->protocol, logLine->protocol)) {
+	while (dataLength > 0) {
+		ce97d170_readFileBufferList(&aioFile, &fileBufferList, dataLength);
+		fileBuffer = fileBufferList.values[0];
 
-			if (listEntry->sourcePort == logLine->sourcePort
-				|| listEntry->destPort == logLine->destPort) {
+		while (fileBuffer != NULL) {
+			// Never scan past endOffset if the file grew in the meantime
+			if (fileBuffer->numBytes > dataLength) {
+				fileBuffer->numBytes = dataLength;
+			}
 
-				listEntry->count++;
-				return;
+			dataLength -= fileBuffer->numBytes;
+			scanLogData(&logScanner, fileBuffer->buffer, fileBuffer->numBytes);
+
+			fileBuffer = fileBuffer->next;
+
+			if (fileBuffer == NULL)  {
+				ce97d170_resetFileBufferList(&fileBufferList, f502a409_releasePage);
+			}
+		}
+	}
+
+	// Process a final line without a trailing newline
+	finishLogScanner(&logScanner);
+	cleanUpLogScanner(&logScanner);
+
+	// Clean up the AIOContext
+	f1207515_cleanUpAIOContext(&aioContext);
+	cleanUpSyslog(&aioFile, &fileBufferList);
+}
+
+static void parseSyslog(char *fileName, uint32_t numThreads, int64_t startOffset, int64_t endOffset) {
+	if (numThreads == 1) {
+		LogTable logTable;
+
+		// Process the syslog file on the main thread
+		initLogTable(&logTable);
+		readSyslog(fileName, &logTable, startOffset, endOffset);
+		replayLogTable(&logTable);
+		cleanUpLogTable(&logTable);
+	} else {
+		LogWorker logWorkers[MAX_NUM_THREADS];
+		uint32_t numWorkers = initLogWorkers(logWorkers, fileName, numThreads, startOffset, endOffset);
+
+		// Parse each byte range on its own thread
+		for (uint32_t i = 1; i < numWorkers; i++) {
+			if (pthread_create(&logWorkers[i].thread, NULL, runLogWorker, &logWorkers[i]) != 0) {
+				c7c88e52_printLibError("Cannot create worker thread", errno);
+				exit(EXIT_FAILURE);
+			}
+		}
+
+		runLogWorker(&logWorkers[0]);
+
+		// Merge the per-thread LogTables in file order
+		for (uint32_t i = 0; i < numWorkers; i++) {
+			if (i > 0) {
+				pthread_join(logWorkers[i].thread, NULL);
 			}
+
+			replayLogTable(&logWorkers[i].logTable);
+			cleanUpLogTable(&logWorkers[i].logTable);
 		}
 	}
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ OutputWriter ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+static void initOutputWriter(OutputWriter *outputWriter, int fd) {
+	outputWriter->buffer = f668c4bd_malloc(OUTPUT_BUFFER_SIZE);
+	outputWriter->length = 0;
+	outputWriter->fd = fd;
+}
 
-	// 2. Add LogLine to the inputLogLineList
-	LogLine *newListItem = b45c9f7e_cloneLogLine(logLine);
-	b196167f_add(inputLogLineList, newListItem);
+static void cleanUpOutputWriter(OutputWriter *outputWriter) {
+	flushOutputWriter(outputWriter);
+	f668c4bd_free(outputWriter->buffer);
 }
 
 /*
- * IN= OUT=enp4s0 SRC=2001:db8:85a3:8d3:1319:8a2e:370:7348 DST=2607:f8b0:4003:0c0c:0000:0000:0000:007f PROTO=UDP SPT=45771 DPT=19302
- *
- * If an output rule triggered:
- *   o Ignore changes in SPT
+ * Writes the buffered bytes followed by data, which may be NULL, with a single
+ * writev() call in the common case, resuming after partial writes.
  */
-void filterOutputLogLine(register LogLine *logLine) {
-	register const uint32_t listLength = outputLogLineList->length;
-	register void **listValues = outputLogLineList->values;
-	register uint32_t i = 0;
-	register LogLine *listEntry;
+static void writeOutput(OutputWriter *outputWriter, char *data, uint32_t length) {
+	struct iovec iov[2];
+	struct iovec *ioVector = iov;
+	int numVectors = 0;
+	ssize_t numBytes;
+
+	if (outputWriter->length > 0) {
+		iov[numVectors].iov_base = outputWriter->buffer;
+		iov[numVectors++].iov_len = outputWriter->length;
+	}
 
-	// 1. Loop over the existing outputLogLineList entries
-	while (i < listLength) {
-		listEntry = listValues[i++];
+	if (length > 0) {
+		iov[numVectors].iov_base = data;
+		iov[numVectors++].iov_len = length;
+	}
 
-		if (f6215943_isEqual(listEntry->in, logLine->in)
-			&& f6215943_isEqual(listEntry->out, logLine->out)
-			&& f6215943_isEqual(listEntry->destIPAddr, logLine->destIPAddr)
-			&& f6215943_isEqual(listEntry->protocol, logLine->protocol)
-			&& listEntry->destPort == logLine->destPort) {
+	while (numVectors > 0) {
+		numBytes = writev(outputWriter->fd, ioVector, numVectors);
 
-			listEntry->count++;
-			return;
+		if (numBytes < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			c7c88e52_printLibError("Cannot write report", errno);
+			exit(EXIT_FAILURE);
+		}
+
+		// Skip the vectors written in full and trim the partially written one
+		while (numVectors > 0 && (size_t) numBytes >= ioVector->iov_len) {
+			numBytes -= ioVector->iov_len;
+			ioVector++;
+			numVectors--;
+		}
+
+		if (numVectors > 0) {
+			ioVector->iov_base = (char*) ioVector->iov_base + numBytes;
+			ioVector->iov_len -= numBytes;
 		}
 	}
 
-	// 2. Add LogLine to the outputLogLineList
-	LogLine *newListItem = b45c9f7e_cloneLogLine(logLine);
-	b196167f_add(outputLogLineList, newListItem);
+	outputWriter->length = 0;
+}
+
+static void flushOutputWriter(OutputWriter *outputWriter) {
+	if (outputWriter->length > 0) {
+		writeOutput(outputWriter, NULL, 0);
+	}
+}
+
+// Returns room for at least length more bytes, flushing the buffer if needed
+static inline char *reserveOutput(OutputWriter *outputWriter, uint32_t length) {
+	if (outputWriter->length + length > OUTPUT_BUFFER_SIZE) {
+		flushOutputWriter(outputWriter);
+	}
+
+	return outputWriter->buffer + outputWriter->length;
+}
+
+static void appendOutput(OutputWriter *outputWriter, char *text) {
+	const uint32_t length = f6215943_getLength(text);
+
+	// Strings too long to buffer are written in place together with the buffer
+	if (length > OUTPUT_BUFFER_SIZE / 2) {
+		writeOutput(outputWriter, text, length);
+		return;
+	}
+
+	memcpy(reserveOutput(outputWriter, length), text, length);
+	outputWriter->length += length;
+}
+
+static char *formatDecimal(char *buffer, uint32_t value) {
+	char digits[10];
+	uint32_t numDigits = 0;
+
+	do {
+		digits[numDigits++] = '0' + (value % 10);
+		value /= 10;
+	} while (value > 0);
+
+	while (numDigits > 0) {
+		*buffer++ = digits[--numDigits];
+	}
+
+	*buffer = '\0';
+
+	return buffer;
+}
+
+static void appendDecimal(OutputWriter *outputWriter, uint32_t value) {
+	char *position = reserveOutput(outputWriter, 11);
+
+	outputWriter->length += formatDecimal(position, value) - position;
+}
+
+// Quotes the string and escapes quotes, backslashes and control characters
+static void appendJsonString(OutputWriter *outputWriter, char *text) {
+	static const char hexDigits[] = "0123456789abcdef";
+	register char *position;
+	register uint8_t ch;
+
+	position = reserveOutput(outputWriter, 1);
+	*position = '"';
+	outputWriter->length++;
+
+	while ((ch = (uint8_t) *text++) != '\0') {
+		// Worst case is the six bytes of a \u00XX escape
+		position = reserveOutput(outputWriter, 6);
+
+		if (ch == '"' || ch == '\\') {
+			*position++ = '\\';
+			*position++ = ch;
+		} else if (ch < 0x20) {
+			memcpy(position, "\\u00", 4);
+			position[4] = hexDigits[ch >> 4];
+			position[5] = hexDigits[ch & 0x0F];
+			position += 6;
+		} else {
+			*position++ = ch;
+		}
+
+		outputWriter->length = position - outputWriter->buffer;
+	}
+
+	position = reserveOutput(outputWriter, 1);
+	*position = '"';
+	outputWriter->length++;
+}
+
+// Quotes a CSV field only if it holds a separator, quote or line break
+static void appendCsvField(OutputWriter *outputWriter, char *text) {
+	register char *position;
+
+	if (strpbrk(text, ",\"\r\n") == NULL) {
+		appendOutput(outputWriter, text);
+		return;
+	}
+
+	position = reserveOutput(outputWriter, 1);
+	*position = '"';
+	outputWriter->length++;
+
+	for (; *text != '\0'; text++) {
+		position = reserveOutput(outputWriter, 2);
+
+		if (*text == '"') {
+			*position++ = '"';
+		}
+
+		*position++ = *text;
+		outputWriter->length = position - outputWriter->buffer;
+	}
+
+	position = reserveOutput(outputWriter, 1);
+	*position = '"';
+	outputWriter->length++;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ GzipReader ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+// Rotated logs are recognized by the gzip magic number, not their file name
+static bool isCompressedFile(char *fileName) {
+	unsigned char magic[2];
+	ssize_t numBytes;
+	int fd;
+
+	fd = e2f74138_openFile(fileName, O_RDONLY);
+	numBytes = e2f74138_readFile(fd, magic, 2, fileName);
+	e2f74138_closeFile(fd, fileName);
+
+	return (numBytes == 2 && magic[0] == 0x1F && magic[1] == 0x8B);
+}
+
+// Inflate stage: fills free buffers in order until the end of the gzip file
+static void *runGzipReader(void *gzipReaderPtr) {
+	GzipReader *gzipReader = gzipReaderPtr;
+	uint32_t bufferNum = 0;
+	int numBytes, errorNumber;
+
+	do {
+		// 1. Wait for the scanner to hand back a buffer
+		pthread_mutex_lock(&gzipReader->mutex);
+
+		while (gzipReader->numFull == GZIP_NUM_BUFFERS) {
+			pthread_cond_wait(&gzipReader->isNotFull, &gzipReader->mutex);
+		}
+
+		pthread_mutex_unlock(&gzipReader->mutex);
+
+		// 2. Decompress into the buffer without holding the lock
+		numBytes = gzread(gzipReader->gzFile, gzipReader->buffers[bufferNum], RANGE_BUFFER_SIZE);
+
+		// A truncated file ends in Z_BUF_ERROR rather than a negative count
+		gzerror(gzipReader->gzFile, &errorNumber);
+
+		if (numBytes < 0 || (errorNumber != Z_OK && errorNumber != Z_STREAM_END)) {
+			if (errorNumber == Z_ERRNO) {
+				printFileError("Cannot read file", gzipReader->fileName, errno);
+			} else {
+				printFileError("Corrupt gzip file", gzipReader->fileName, 0);
+			}
+
+			exit(EXIT_FAILURE);
+		}
+
+		// 3. Pass the buffer on to the scanner
+		pthread_mutex_lock(&gzipReader->mutex);
+
+		gzipReader->lengths[bufferNum] = numBytes;
+		gzipReader->numFull++;
+		pthread_cond_signal(&gzipReader->isNotEmpty);
+
+		pthread_mutex_unlock(&gzipReader->mutex);
+
+		bufferNum = (bufferNum + 1) % GZIP_NUM_BUFFERS;
+	} while (numBytes > 0);
+
+	return NULL;
+}
+
+/*
+ * Parses a gzip-compressed log without temporary files. A separate thread
+ * inflates into a small ring of buffers while this thread scans the buffers
+ * already filled, so decompression overlaps with parsing. An empty buffer
+ * marks the end of the file.
+ */
+static void readCompressedSyslog(char *fileName, LogTable *logTable) {
+	GzipReader gzipReader;
+	LogScanner logScanner;
+	pthread_t thread;
+	uint32_t bufferNum = 0;
+	uint32_t numBytes;
+
+	gzipReader.gzFile = gzopen(fileName, "rb");
+
+	if (gzipReader.gzFile == NULL) {
+		printFileError("Cannot open file", fileName, errno);
+		exit(EXIT_FAILURE);
+	}
+
+	gzbuffer(gzipReader.gzFile, GZIP_INPUT_BUFFER_SIZE);
+	gzipReader.fileName = fileName;
+	gzipReader.numFull = 0;
+	pthread_mutex_init(&gzipReader.mutex, NULL);
+	pthread_cond_init(&gzipReader.isNotEmpty, NULL);
+	pthread_cond_init(&gzipReader.isNotFull, NULL);
+
+	for (uint32_t i = 0; i < GZIP_NUM_BUFFERS; i++) {
+		gzipReader.buffers[i] = f668c4bd_malloc(RANGE_BUFFER_SIZE);
+	}
+
+	initLogScanner(&logScanner, logTable);
+
+	if (pthread_create(&thread, NULL, runGzipReader, &gzipReader) != 0) {
+		c7c88e52_printLibError("Cannot create inflate thread", errno);
+		exit(EXIT_FAILURE);
+	}
+
+	do {
+		pthread_mutex_lock(&gzipReader.mutex);
+
+		while (gzipReader.numFull == 0) {
+			pthread_cond_wait(&gzipReader.isNotEmpty, &gzipReader.mutex);
+		}
+
+		numBytes = gzipReader.lengths[bufferNum];
+		pthread_mutex_unlock(&gzipReader.mutex);
+
+		scanLogData(&logScanner, gzipReader.buffers[bufferNum], numBytes);
+
+		pthread_mutex_lock(&gzipReader.mutex);
+
+		gzipReader.numFull--;
+		pthread_cond_signal(&gzipReader.isNotFull);
+
+		pthread_mutex_unlock(&gzipReader.mutex);
+
+		bufferNum = (bufferNum + 1) % GZIP_NUM_BUFFERS;
+	} while (numBytes > 0);
+
+	pthread_join(thread, NULL);
+
+	// Process a final line without a trailing newline
+	finishLogScanner(&logScanner);
+	cleanUpLogScanner(&logScanner);
+
+	for (uint32_t i = 0; i < GZIP_NUM_BUFFERS; i++) {
+		f668c4bd_free(gzipReader.buffers[i]);
+	}
+
+	pthread_mutex_destroy(&gzipReader.mutex);
+	pthread_cond_destroy(&gzipReader.isNotEmpty);
+	pthread_cond_destroy(&gzipReader.isNotFull);
+	gzclose(gzipReader.gzFile);
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ State File ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+static void invalidStateFile(char *stateFileName) {
+	printFileError("Invalid state file", stateFileName, 0);
+	exit(EXIT_FAILURE);
+}
+
+static bool isValidAddress(uint8_t *address, uint8_t format, uint32_t numStrings) {
+	uint32_t id;
+
+	if (format == ADDRESS_STRING) {
+		memcpy(&id, address, sizeof(uint32_t));
+		return id < numStrings;
+	}
+
+	return format <= ADDRESS_IPV6_FULL;
+}
+
+static bool isValidLogRecord(LogRecord *logRecord, uint32_t numStrings) {
+	return logRecord->in < numStrings && logRecord->out < numStrings
+		&& logRecord->macAddress < numStrings && logRecord->protocol < numStrings
+		&& isValidAddress(logRecord->sourceIPAddr, logRecord->sourceFormat, numStrings)
+		&& isValidAddress(logRecord->destIPAddr, logRecord->destFormat, numStrings);
+}
+
+// Report entries are unique by construction, so both port keys are free
+static void restoreInputLogRecord(LogRecord *logRecord, uint32_t entryNum) {
+	const uint32_t tupleHash = hashInputTuple(logRecord);
+
+	putHashEntry(&inputSourcePortIndex, (tupleHash ^ logRecord->sourcePort) * FNV_PRIME, entryNum);
+	putHashEntry(&inputDestPortIndex, (tupleHash ^ (logRecord->destPort | 0x10000)) * FNV_PRIME, entryNum);
+}
+
+static void mapLogRecordList(LogRecordList *logRecordList, LogRecord *values, uint32_t length) {
+	if (length > 0) {
+		releaseArray(logRecordList->values);
+		logRecordList->values = values;
+		logRecordList->length = length;
+		logRecordList->size = length;
+	}
+}
+
+static void mapStringPool(StringPool *stringPool, uint32_t *offsets, char *strings, uint32_t length, uint32_t stringsLength) {
+	if (length > 0) {
+		releaseArray(stringPool->offsets);
+		releaseArray(stringPool->strings);
+		stringPool->offsets = offsets;
+		stringPool->strings = strings;
+		stringPool->length = stringPool->size = length;
+		stringPool->stringsLength = stringPool->stringsSize = stringsLength;
+
+		for (uint32_t i = 0; i < length; i++) {
+			putHashEntry(&stringPool->index, hashString(FNV_OFFSET_BASIS, getString(stringPool, i)), i + 1);
+		}
+	}
+}
+
+/*
+ * Maps the state file privately and uses its arrays in place as the report
+ * LogRecordLists and StringPool; only the hash indexes are rebuilt. An array
+ * is first copied when the report outgrows it. Returns the syslog offset to
+ * resume from, which is zero on the first run or when the syslog file was
+ * rotated or truncated since the state was saved.
+ */
+static int64_t loadState(char *stateFileName, FileStatus *syslogStatus) {
+	FileStatus fileStatus;
+	StateHeader *stateHeader;
+	LogRecord *inputRecords, *outputRecords;
+	uint32_t *offsets;
+	char *strings;
+	uint64_t stringsOffset;
+	int fd;
+
+	fd = open(stateFileName, O_RDONLY);
+
+	if (fd < 0) {
+		if (errno == ENOENT) {
+			return 0;
+		}
+
+		printFileError("Cannot open file", stateFileName, errno);
+		exit(EXIT_FAILURE);
+	}
+
+	e2f74138_getDescriptorStatus(fd, &fileStatus);
+
+	if (fileStatus.st_size < (off_t) sizeof(StateHeader)) {
+		invalidStateFile(stateFileName);
+	}
+
+	stateMappingSize = fileStatus.st_size;
+	stateMapping = mmap(NULL, stateMappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+
+	if (stateMapping == MAP_FAILED) {
+		printFileError("Cannot map file", stateFileName, errno);
+		exit(EXIT_FAILURE);
+	}
+
+	close(fd);
+
+	// 1. Validate the header before trusting any of the arrays
+	stateHeader = (StateHeader*) stateMapping;
+
+	// Start over from a state file written by another version of firelog
+	if (stateHeader->magic == STATE_FILE_MAGIC && stateHeader->version != STATE_FILE_VERSION) {
+		munmap(stateMapping, stateMappingSize);
+		stateMapping = NULL;
+		stateMappingSize = 0;
+
+		return 0;
+	}
+
+	stringsOffset = sizeof(StateHeader) + ((uint64_t) stateHeader->numInputRecords + stateHeader->numOutputRecords) * sizeof(LogRecord)
+		+ ((uint64_t) stateHeader->numStrings * sizeof(uint32_t));
+
+	if (stateHeader->magic != STATE_FILE_MAGIC || stateHeader->fileSize != stateMappingSize
+			|| stringsOffset + stateHeader->stringsLength != stateMappingSize) {
+		invalidStateFile(stateFileName);
+	}
+
+	inputRecords = (LogRecord*) (stateHeader + 1);
+	outputRecords = inputRecords + stateHeader->numInputRecords;
+	offsets = (uint32_t*) (outputRecords + stateHeader->numOutputRecords);
+	strings = stateMapping + stringsOffset;
+
+	// 2. Every string id and offset must stay inside the mapping
+	if (stateHeader->stringsLength > 0 && strings[stateHeader->stringsLength - 1] != '\0') {
+		invalidStateFile(stateFileName);
+	}
+
+	for (uint32_t i = 0; i < stateHeader->numStrings; i++) {
+		if (offsets[i] >= stateHeader->stringsLength) {
+			invalidStateFile(stateFileName);
+		}
+	}
+
+	for (uint32_t i = 0; i < stateHeader->numInputRecords + stateHeader->numOutputRecords; i++) {
+		if (!isValidLogRecord(&inputRecords[i], stateHeader->numStrings)) {
+			invalidStateFile(stateFileName);
+		}
+	}
+
+	// 3. Use the arrays in place and rebuild the indexes
+	mapStringPool(&reportStringPool, offsets, strings, stateHeader->numStrings, stateHeader->stringsLength);
+	mapLogRecordList(&inputRecordList, inputRecords, stateHeader->numInputRecords);
+	mapLogRecordList(&outputRecordList, outputRecords, stateHeader->numOutputRecords);
+
+	for (uint32_t i = 0; i < inputRecordList.length; i++) {
+		restoreInputLogRecord(&inputRecordList.values[i], i + 1);
+	}
+
+	for (uint32_t i = 0; i < outputRecordList.length; i++) {
+		putHashEntry(&outputIndex, hashOutputTuple(&outputRecordList.values[i]), i + 1);
+	}
+
+	if (stateHeader->inode == syslogStatus->st_ino && stateHeader->offset <= syslogStatus->st_size) {
+		return stateHeader->offset;
+	}
+
+	return 0;
+}
+
+/*
+ * Writes the report together with the inode of the syslog file and the offset
+ * just past its last complete line. The arrays are gathered straight from the
+ * report with writev(), and the state file is replaced atomically so an
+ * interrupted run never leaves a half-written state behind.
+ */
+static void saveState(char *stateFileName, FileStatus *syslogStatus, int64_t offset) {
+	StringBuilder tempFileName;
+	StateHeader stateHeader;
+	struct iovec ioVectors[5];
+	ssize_t stateSize = 0;
+	ssize_t numBytes;
+	int fd;
+
+	stateHeader.magic = STATE_FILE_MAGIC;
+	stateHeader.version = STATE_FILE_VERSION;
+	stateHeader.inode = syslogStatus->st_ino;
+	stateHeader.offset = offset;
+	stateHeader.numInputRecords = inputRecordList.length;
+	stateHeader.numOutputRecords = outputRecordList.length;
+	stateHeader.numStrings = reportStringPool.length;
+	stateHeader.stringsLength = reportStringPool.stringsLength;
+
+	ioVectors[0].iov_base = &stateHeader;
+	ioVectors[0].iov_len = sizeof(StateHeader);
+	ioVectors[1].iov_base = inputRecordList.values;
+	ioVectors[1].iov_len = inputRecordList.length * sizeof(LogRecord);
+	ioVectors[2].iov_base = outputRecordList.values;
+	ioVectors[2].iov_len = outputRecordList.length * sizeof(LogRecord);
+	ioVectors[3].iov_base = reportStringPool.offsets;
+	ioVectors[3].iov_len = reportStringPool.length * sizeof(uint32_t);
+	ioVectors[4].iov_base = reportStringPool.strings;
+	ioVectors[4].iov_len = reportStringPool.stringsLength;
+
+	for (uint32_t i = 0; i < 5; i++) {
+		stateSize += ioVectors[i].iov_len;
+	}
+
+	stateHeader.fileSize = stateSize;
+
+	// Write to a temporary file and rename it over the old state
+	c598a24c_initStringBuilder(&tempFileName);
+	c598a24c_append_string(&tempFileName, stateFileName);
+	c598a24c_append_string(&tempFileName, ".tmp");
+
+	fd = open(tempFileName.buffer, O_WRONLY | O_CREAT | O_TRUNC, 0640);
+
+	if (fd < 0) {
+		printFileError("Cannot create file", tempFileName.buffer, errno);
+		exit(EXIT_FAILURE);
+	}
+
+	// A regular file only takes a short write when the disk is full
+	numBytes = writev(fd, ioVectors, 5);
+
+	if (numBytes != stateSize) {
+		printFileError("Cannot write file", tempFileName.buffer, (numBytes < 0) ? errno : ENOSPC);
+		exit(EXIT_FAILURE);
+	}
+
+	if (fsync(fd) != 0 || close(fd) != 0 || rename(tempFileName.buffer, stateFileName) != 0) {
+		printFileError("Cannot save state file", stateFileName, errno);
+		exit(EXIT_FAILURE);
+	}
+
+	c598a24c_cleanUpStringBuilder(&tempFileName);
+}
+
+/*
+ * Returns the offset just past the last newline of the syslog file, so a
+ * line still being written is left for the next run to parse whole.
+ */
+static int64_t findLastLineEnd(char *fileName, int64_t startOffset, int64_t endOffset) {
+	char buffer[MEMORY_PAGE_SIZE];
+	ssize_t numBytes;
+	int64_t offset;
+	char *newline;
+	int fd;
+
+	fd = e2f74138_openFile(fileName, O_RDONLY);
+
+	while (endOffset > startOffset) {
+		offset = (endOffset - startOffset > MEMORY_PAGE_SIZE) ? endOffset - MEMORY_PAGE_SIZE : startOffset;
+		numBytes = pread(fd, buffer, endOffset - offset, offset);
+
+		if (numBytes < 0) {
+			printFileError("Cannot read file", fileName, errno);
+			exit(EXIT_FAILURE);
+		} else if (numBytes == END_OF_FILE) {
+			break;
+		}
+
+		newline = memrchr(buffer, '\n', numBytes);
+
+		if (newline != NULL) {
+			endOffset = offset + (newline - buffer) + 1;
+			break;
+		}
+
+		endOffset = offset;
+	}
+
+	e2f74138_closeFile(fd, fileName);
+
+	return (endOffset > startOffset) ? endOffset : startOffset;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ LogFollower ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+static bool openFollowedFile(LogFollower *logFollower) {
+	FileStatus fileStatus;
+
+	logFollower->fd = open(logFollower->fileName, O_RDONLY);
+
+	if (logFollower->fd < 0) {
+		// logrotate may not have created the new file yet
+		if (errno == ENOENT) {
+			return false;
+		}
+
+		printFileError("Cannot open file", logFollower->fileName, errno);
+		exit(EXIT_FAILURE);
+	}
+
+	e2f74138_getDescriptorStatus(logFollower->fd, &fileStatus);
+	logFollower->inode = fileStatus.st_ino;
+	logFollower->offset = 0;
+
+	return true;
+}
+
+// Scan everything appended to the followed file since the last read
+static void readAppendedData(LogFollower *logFollower) {
+	ssize_t numBytes;
+
+	if (logFollower->fd < 0) {
+		return;
+	}
+
+	numBytes = read(logFollower->fd, logFollower->buffer, RANGE_BUFFER_SIZE);
+
+	while (numBytes > 0) {
+		scanLogData(&logFollower->logScanner, logFollower->buffer, numBytes);
+		logFollower->offset += numBytes;
+
+		numBytes = read(logFollower->fd, logFollower->buffer, RANGE_BUFFER_SIZE);
+	}
+
+	if (numBytes < 0) {
+		printFileError("Cannot read file", logFollower->fileName, errno);
+		exit(EXIT_FAILURE);
+	}
+}
+
+/*
+ * Detects logrotate activity. A new inode under the file name means the file
+ * was rotated: the rest of the old file is read before switching over. A file
+ * shrinking below the read offset means it was truncated in place.
+ */
+static void checkFollowedFile(LogFollower *logFollower) {
+	FileStatus fileStatus;
+
+	if (stat(logFollower->fileName, &fileStatus) != 0) {
+		return;
+	}
+
+	if (logFollower->fd < 0) {
+		openFollowedFile(logFollower);
+	} else if (fileStatus.st_ino != logFollower->inode) {
+		readAppendedData(logFollower);
+		finishLogScanner(&logFollower->logScanner);
+		close(logFollower->fd);
+
+		openFollowedFile(logFollower);
+	} else if (fileStatus.st_size < logFollower->offset) {
+		lseek(logFollower->fd, 0, SEEK_SET);
+		logFollower->offset = 0;
+		logFollower->logScanner.length = 0;
+	}
+}
+
+static int64_t getMonotonicTime() {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec;
+}
+
+// Fold the lines appended since the last refresh into the report
+static void refreshReport(LogFollower *logFollower) {
+	replayLogTable(&logFollower->logTable);
+	cleanUpLogTable(&logFollower->logTable);
+	initLogTable(&logFollower->logTable);
+
+	printReport();
+}
+
+/*
+ * Keeps the report in memory and only ever reads newly appended bytes. The
+ * directory of the syslog file is watched with inotify so both appends and
+ * logrotate renames wake us up; the summary is refreshed every refreshInterval
+ * seconds whenever new BLOCK lines arrived.
+ */
+static void followSyslog(char *fileName, uint32_t refreshInterval) {
+	LogFollower logFollower;
+	char eventBuffer[INOTIFY_BUFFER_SIZE] __attribute__((aligned(__alignof__(struct inotify_event))));
+	char *dirName, *lastSlash;
+	struct pollfd pollFd;
+	int64_t now, nextRefresh;
+
+	logFollower.fileName = fileName;
+	logFollower.buffer = f668c4bd_malloc(RANGE_BUFFER_SIZE);
+	initLogTable(&logFollower.logTable);
+	initLogScanner(&logFollower.logScanner, &logFollower.logTable);
+
+	if (!openFollowedFile(&logFollower)) {
+		printFileError("Cannot open file", fileName, ENOENT);
+		exit(EXIT_FAILURE);
+	}
+
+	// 1. Watch the directory so a rotated file is noticed as well
+	lastSlash = f6215943_findLastChar(fileName, '/');
+
+	if (lastSlash == NULL) {
+		dirName = strdup(".");
+	} else {
+		dirName = strndup(fileName, (lastSlash == fileName) ? 1 : lastSlash - fileName);
+	}
+
+	logFollower.inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+	if (logFollower.inotifyFd < 0 || inotify_add_watch(logFollower.inotifyFd, dirName, IN_MODIFY | IN_CREATE | IN_MOVED_TO | IN_MOVED_FROM) < 0) {
+		printFileError("Cannot watch directory", dirName, errno);
+		exit(EXIT_FAILURE);
+	}
+
+	free(dirName);
+
+	pollFd.fd = logFollower.inotifyFd;
+	pollFd.events = POLLIN;
+
+	// 2. Initial pass over the existing file contents
+	readAppendedData(&logFollower);
+	refreshReport(&logFollower);
+
+	nextRefresh = getMonotonicTime() + refreshInterval;
+
+	// 3. Read only the appended bytes from here on
+	while (true) {
+		now = getMonotonicTime();
+
+		if (poll(&pollFd, 1, (nextRefresh > now) ? (nextRefresh - now) * 1000 : 0) > 0) {
+			while (read(logFollower.inotifyFd, eventBuffer, INOTIFY_BUFFER_SIZE) > 0);
+		}
+
+		checkFollowedFile(&logFollower);
+		readAppendedData(&logFollower);
+
+		if (getMonotonicTime() >= nextRefresh) {
+			if (hasLogTableEntries(&logFollower.logTable)) {
+				refreshReport(&logFollower);
+			}
+
+			nextRefresh = getMonotonicTime() + refreshInterval;
+		}
+	}
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ LogWorker ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/*
+ * Moves a range boundary forward to the first byte after a newline, so every
+ * line belongs to exactly one range.
+ */
+static int64_t alignRangeOffset(int fd, char *fileName, int64_t offset, int64_t fileSize) {
+	char buffer[MEMORY_PAGE_SIZE];
+	ssize_t numBytes;
+	char *newline;
+
+	// Start at the byte before the offset in case a line ends right there
+	offset--;
+
+	while (offset < fileSize) {
+		numBytes = pread(fd, buffer, MEMORY_PAGE_SIZE, offset);
+
+		if (numBytes < 0) {
+			printFileError("Cannot read file", fileName, errno);
+			exit(EXIT_FAILURE);
+		} else if (numBytes == END_OF_FILE) {
+			break;
+		}
+
+		newline = memchr(buffer, '\n', numBytes);
+
+		if (newline != NULL) {
+			return offset + (newline - buffer) + 1;
+		}
+
+		offset += numBytes;
+	}
+
+	return fileSize;
+}
+
+/*
+ * Splits the syslog file into one newline-aligned byte range per thread and
+ * returns the number of LogWorkers initialized, which is less than requested
+ * for files smaller than MIN_RANGE_SIZE bytes per thread.
+ */
+static uint32_t initLogWorkers(LogWorker *logWorkers, char *fileName, uint32_t numThreads, int64_t startOffset, int64_t endOffset) {
+	int64_t dataLength, rangeSize, offset;
+	uint32_t numWorkers = numThreads;
+	int fd;
+
+	fd = e2f74138_openFile(fileName, O_RDONLY);
+	dataLength = endOffset - startOffset;
+
+	if (dataLength / MIN_RANGE_SIZE < numWorkers) {
+		numWorkers = (dataLength / MIN_RANGE_SIZE) + 1;
+	}
+
+	rangeSize = dataLength / numWorkers;
+	offset = startOffset;
+
+	for (uint32_t i = 0; i < numWorkers; i++) {
+		logWorkers[i].fileName = fileName;
+		logWorkers[i].startOffset = offset;
+
+		if (i + 1 < numWorkers) {
+			offset = alignRangeOffset(fd, fileName, startOffset + (rangeSize * (i + 1)), endOffset);
+
+			// A single line longer than a whole range leaves the next range empty
+			if (offset < logWorkers[i].startOffset) {
+				offset = logWorkers[i].startOffset;
+			}
+		} else {
+			offset = endOffset;
+		}
+
+		logWorkers[i].endOffset = offset;
+		initLogTable(&logWorkers[i].logTable);
+	}
+
+	e2f74138_closeFile(fd, fileName);
+
+	return numWorkers;
+}
+
+static void *runLogWorker(void *logWorkerPtr) {
+	LogWorker *logWorker = logWorkerPtr;
+	LogScanner logScanner;
+	int64_t offset = logWorker->startOffset;
+	ssize_t numBytes;
+	size_t readSize;
+	char *buffer;
+	int fd;
+
+	fd = open(logWorker->fileName, O_RDONLY);
+
+	if (fd < 0) {
+		printFileError("Cannot open file", logWorker->fileName, errno);
+		exit(EXIT_FAILURE);
+	}
+
+	posix_fadvise(fd, logWorker->startOffset, logWorker->endOffset - logWorker->startOffset, POSIX_FADV_SEQUENTIAL);
+
+	buffer = f668c4bd_malloc(RANGE_BUFFER_SIZE);
+	initLogScanner(&logScanner, &logWorker->logTable);
+
+	while (offset < logWorker->endOffset) {
+		readSize = logWorker->endOffset - offset;
+
+		if (readSize > RANGE_BUFFER_SIZE) {
+			readSize = RANGE_BUFFER_SIZE;
+		}
+
+		numBytes = pread(fd, buffer, readSize, offset);
+
+		if (numBytes < 0) {
+			printFileError("Cannot read file", logWorker->fileName, errno);
+			exit(EXIT_FAILURE);
+		} else if (numBytes == END_OF_FILE) {
+			break;
+		}
+
+		scanLogData(&logScanner, buffer, numBytes);
+		offset += numBytes;
+	}
+
+	// Process a final line without a trailing newline
+	finishLogScanner(&logScanner);
+	cleanUpLogScanner(&logScanner);
+
+	f668c4bd_free(buffer);
+	close(fd);
+
+	return NULL;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ LogTable ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+static void initLogTable(LogTable *logTable) {
+	initLogRecordList(&logTable->inputList);
+	initLogRecordList(&logTable->outputList);
+	initHashIndex(&logTable->inputIndex, INDEX_INITIAL_CAPACITY);
+	initHashIndex(&logTable->outputIndex, INDEX_INITIAL_CAPACITY);
+	initStringPool(&logTable->stringPool);
+
+	logTable->statistics = (reportStatistics != NULL) ? createStatistics(reportStatistics->numTopEntries) : NULL;
+}
+
+static void cleanUpLogTable(LogTable *logTable) {
+	cleanUpLogRecordList(&logTable->inputList);
+	cleanUpLogRecordList(&logTable->outputList);
+	cleanUpHashIndex(&logTable->inputIndex);
+	cleanUpHashIndex(&logTable->outputIndex);
+	cleanUpStringPool(&logTable->stringPool);
+
+	if (logTable->statistics != NULL) {
+		destroyStatistics(logTable->statistics);
+	}
+}
+
+static bool hasLogTableEntries(LogTable *logTable) {
+	if (logTable->statistics != NULL) {
+		return logTable->statistics->numEvents > 0;
+	}
+
+	return logTable->inputList.length > 0 || logTable->outputList.length > 0;
+}
+
+// Move the string ids of a LogTable record over to the report StringPool
+static void translateLogRecord(LogRecord *logRecord, uint32_t *stringIds) {
+	uint32_t id;
+
+	logRecord->in = stringIds[logRecord->in];
+	logRecord->out = stringIds[logRecord->out];
+	logRecord->macAddress = stringIds[logRecord->macAddress];
+	logRecord->protocol = stringIds[logRecord->protocol];
+
+	if (logRecord->sourceFormat == ADDRESS_STRING) {
+		memcpy(&id, logRecord->sourceIPAddr, sizeof(uint32_t));
+		memcpy(logRecord->sourceIPAddr, &stringIds[id], sizeof(uint32_t));
+	}
+
+	if (logRecord->destFormat == ADDRESS_STRING) {
+		memcpy(&id, logRecord->destIPAddr, sizeof(uint32_t));
+		memcpy(logRecord->destIPAddr, &stringIds[id], sizeof(uint32_t));
+	}
+}
+
+/*
+ * Feeds the exact keys of a LogTable into the report in order of their first
+ * appearance. Every line with the same exact key joins the same report entry
+ * as the first one, so replaying each key once with its count yields the same
+ * counts as filtering the lines one at a time.
+ */
+static void replayLogTable(LogTable *logTable) {
+	StringPool *stringPool = &logTable->stringPool;
+	uint32_t *stringIds = f668c4bd_malloc((stringPool->length + 1) * sizeof(uint32_t));
+	LogRecord logRecord;
+
+	if (logTable->statistics != NULL) {
+		mergeStatistics(reportStatistics, logTable->statistics);
+	}
+
+	// The LogTable only holds a handful of distinct strings
+	for (uint32_t i = 0; i < stringPool->length; i++) {
+		stringIds[i] = internString(&reportStringPool, getString(stringPool, i));
+	}
+
+	for (uint32_t i = 0; i < logTable->inputList.length; i++) {
+		logRecord = logTable->inputList.values[i];
+		translateLogRecord(&logRecord, stringIds);
+		filterInputLogRecord(&logRecord);
+	}
+
+	for (uint32_t i = 0; i < logTable->outputList.length; i++) {
+		logRecord = logTable->outputList.values[i];
+		translateLogRecord(&logRecord, stringIds);
+		filterOutputLogRecord(&logRecord);
+	}
+
+	f668c4bd_free(stringIds);
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ LogRecordList ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+// Arrays restored from the state file are used in place until they grow
+static inline bool isStateMapping(void *values) {
+	return (char*) values >= stateMapping && (char*) values < stateMapping + stateMappingSize;
+}
+
+static void *growArray(void *values, size_t length, size_t size) {
+	if (isStateMapping(values)) {
+		void *newValues = f668c4bd_malloc(size);
+
+		memcpy(newValues, values, length);
+		return newValues;
+	}
+
+	return f668c4bd_realloc(values, size);
+}
+
+static void releaseArray(void *values) {
+	if (!isStateMapping(values)) {
+		f668c4bd_free(values);
+	}
+}
+
+static void initLogRecordList(LogRecordList *logRecordList) {
+	logRecordList->values = f668c4bd_malloc(RECORD_LIST_INITIAL_SIZE * sizeof(LogRecord));
+	logRecordList->length = 0;
+	logRecordList->size = RECORD_LIST_INITIAL_SIZE;
+}
+
+static void cleanUpLogRecordList(LogRecordList *logRecordList) {
+	releaseArray(logRecordList->values);
+}
+
+// Returns the one-based position of the copy added to the arena
+static uint32_t addLogRecord(LogRecordList *logRecordList, LogRecord *logRecord) {
+	if (logRecordList->length == logRecordList->size) {
+		logRecordList->size <<= 1;
+		logRecordList->values = growArray(logRecordList->values, logRecordList->length * sizeof(LogRecord),
+			logRecordList->size * sizeof(LogRecord));
+	}
+
+	logRecordList->values[logRecordList->length] = *logRecord;
+
+	return ++logRecordList->length;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ StringPool ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+static void initStringPool(StringPool *stringPool) {
+	initHashIndex(&stringPool->index, STRING_POOL_INITIAL_SIZE);
+	stringPool->offsets = f668c4bd_malloc(STRING_POOL_INITIAL_SIZE * sizeof(uint32_t));
+	stringPool->strings = f668c4bd_malloc(MEMORY_PAGE_SIZE);
+	stringPool->length = 0;
+	stringPool->size = STRING_POOL_INITIAL_SIZE;
+	stringPool->stringsLength = 0;
+	stringPool->stringsSize = MEMORY_PAGE_SIZE;
+}
+
+static void cleanUpStringPool(StringPool *stringPool) {
+	cleanUpHashIndex(&stringPool->index);
+	releaseArray(stringPool->offsets);
+	releaseArray(stringPool->strings);
+}
+
+static inline char *getString(StringPool *stringPool, uint32_t id) {
+	return stringPool->strings + stringPool->offsets[id];
+}
+
+static uint32_t internString(StringPool *stringPool, char *string) {
+	const uint32_t hashCode = hashString(FNV_OFFSET_BASIS, string);
+	const uint32_t mask = stringPool->index.capacity - 1;
+	uint32_t i = hashCode & mask;
+	uint32_t entryNum, length;
+
+	while ((entryNum = stringPool->index.slots[i]) != 0) {
+		if (stringPool->index.hashCodes[i] == hashCode && f6215943_isEqual(getString(stringPool, entryNum - 1), string)) {
+			return entryNum - 1;
+		}
+
+		i = (i + 1) & mask;
+	}
+
+	// Append the new string to the pool
+	length = f6215943_getLength(string) + 1;
+
+	if (stringPool->length == stringPool->size) {
+		stringPool->size <<= 1;
+		stringPool->offsets = growArray(stringPool->offsets, stringPool->length * sizeof(uint32_t),
+			stringPool->size * sizeof(uint32_t));
+	}
+
+	if (stringPool->stringsLength + length > stringPool->stringsSize) {
+		while (stringPool->stringsLength + length > stringPool->stringsSize) {
+			stringPool->stringsSize <<= 1;
+		}
+
+		stringPool->strings = growArray(stringPool->strings, stringPool->stringsLength, stringPool->stringsSize);
+	}
+
+	memcpy(stringPool->strings + stringPool->stringsLength, string, length);
+	stringPool->offsets[stringPool->length++] = stringPool->stringsLength;
+	stringPool->stringsLength += length;
+
+	putHashEntry(&stringPool->index, hashCode, stringPool->length);
+
+	return stringPool->length - 1;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ Addresses ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+// Accepts only the canonical dotted-decimal form, which formatIPv4Address() restores
+static bool parseIPv4Address(uint8_t *address, register const char *text) {
+	register uint32_t value, numDigits;
+	const char *octet;
+
+	for (uint32_t i = 0; i < 4; i++) {
+		value = numDigits = 0;
+		octet = text;
+
+		while (*text >= '0' && *text <= '9' && numDigits < 4) {
+			value = (value * 10) + (*text++ - '0');
+			numDigits++;
+		}
+
+		// Reject empty octets, leading zeros and values above 255
+		if (numDigits == 0 || value > 255 || (numDigits > 1 && *octet == '0')) {
+			return false;
+		}
+
+		address[i] = value;
+
+		if (*text++ != ((i < 3) ? '.' : '\0')) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Same dotted-decimal text as inet_ntop() without its generic formatting
+static char *formatIPv4Address(uint8_t *address, char *buffer) {
+	register char *position = buffer;
+
+	for (uint32_t i = 0; i < 4; i++) {
+		position = formatDecimal(position, address[i]);
+		*position++ = '.';
+	}
+
+	position[-1] = '\0';
+
+	return buffer;
+}
+
+// Formats all eight groups with leading zeros, as the kernel logs IPv6 addresses
+static char *formatFullIPv6Address(uint8_t *address, char *buffer) {
+	static const char hexDigits[] = "0123456789abcdef";
+	register char *position = buffer;
+
+	for (uint32_t i = 0; i < 16; i += 2) {
+		*position++ = hexDigits[address[i] >> 4];
+		*position++ = hexDigits[address[i] & 0x0F];
+		*position++ = hexDigits[address[i + 1] >> 4];
+		*position++ = hexDigits[address[i + 1] & 0x0F];
+		*position++ = ':';
+	}
+
+	position[-1] = '\0';
+
+	return buffer;
+}
+
+static uint8_t encodeAddress(StringPool *stringPool, uint8_t *address, char *text) {
+	char buffer[INET6_ADDRSTRLEN];
+	uint32_t id;
+
+	if (parseIPv4Address(address, text)) {
+		return ADDRESS_IPV4;
+	}
+
+	if (inet_pton(AF_INET6, text, address) == 1) {
+		if (f6215943_getLength(text) == FULL_IPV6_LENGTH) {
+			if (f6215943_isEqual(formatFullIPv6Address(address, buffer), text)) {
+				return ADDRESS_IPV6_FULL;
+			}
+		} else if (f6215943_isEqual(inet_ntop(AF_INET6, address, buffer, INET6_ADDRSTRLEN), text)) {
+			return ADDRESS_IPV6;
+		}
+	}
+
+	// Keep any other spelling verbatim
+	id = internString(stringPool, text);
+	f668c4bd_meminit(address, 16);
+	memcpy(address, &id, sizeof(uint32_t));
+
+	return ADDRESS_STRING;
+}
+
+static char *formatAddress(StringPool *stringPool, uint8_t *address, uint8_t format, char *buffer) {
+	uint32_t id;
+
+	switch (format) {
+		case ADDRESS_IPV4:
+			return formatIPv4Address(address, buffer);
+		case ADDRESS_IPV6:
+			return (char*) inet_ntop(AF_INET6, address, buffer, INET6_ADDRSTRLEN);
+		case ADDRESS_IPV6_FULL:
+			return formatFullIPv6Address(address, buffer);
+	}
+
+	memcpy(&id, address, sizeof(uint32_t));
+
+	return getString(stringPool, id);
+}
+
+// Interns the fields of a parsed BLOCK line into a zeroed LogRecord
+static void encodeLogRecord(StringPool *stringPool, LogRecord *logRecord, LogLine *logLine) {
+	f668c4bd_meminit(logRecord, sizeof(LogRecord));
+
+	logRecord->in = internString(stringPool, logLine->in);
+	logRecord->out = internString(stringPool, logLine->out);
+	logRecord->macAddress = internString(stringPool, logLine->macAddress);
+	logRecord->protocol = internString(stringPool, logLine->protocol);
+	logRecord->sourceFormat = encodeAddress(stringPool, logRecord->sourceIPAddr, logLine->sourceIPAddr);
+	logRecord->destFormat = encodeAddress(stringPool, logRecord->destIPAddr, logLine->destIPAddr);
+	logRecord->sourcePort = logLine->sourcePort;
+	logRecord->destPort = logLine->destPort;
+	logRecord->count = logLine->count;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ LogMatcher ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+// Fields of the iptables LOG target
+static const FieldSpec iptablesFieldSpecs[] = {
+	{ "IN=", FIELD_IN }, { "OUT=", FIELD_OUT }, { "MAC=", FIELD_MAC },
+	{ "SRC=", FIELD_SRC }, { "DST=", FIELD_DST }, { "PROTO=", FIELD_PROTO },
+	{ "SPT=", FIELD_SPT }, { "DPT=", FIELD_DPT }, { "TYPE=", FIELD_TYPE }
+};
+
+// The nftables bridge and netdev families log the link layer as MACSRC=
+static const FieldSpec nftablesFieldSpecs[] = {
+	{ "IN=", FIELD_IN }, { "OUT=", FIELD_OUT }, { "MAC=", FIELD_MAC },
+	{ "MACSRC=", FIELD_MAC }, { "SRC=", FIELD_SRC }, { "DST=", FIELD_DST },
+	{ "PROTO=", FIELD_PROTO }, { "SPT=", FIELD_SPT }, { "DPT=", FIELD_DPT },
+	{ "TYPE=", FIELD_TYPE }
+};
+
+// ufw "[UFW BLOCK] " and the firewalld "<zone>_REJECT: " and "<zone>_DROP: " prefixes
+static PrefixSpec defaultPrefixSpecs[] = {
+	{ "[", " BLOCK] ", DIALECT_IPTABLES },
+	{ "", "_REJECT: ", DIALECT_NFTABLES },
+	{ "", "_DROP: ", DIALECT_NFTABLES }
+};
+
+static_assert(sizeof(defaultPrefixSpecs) / sizeof(PrefixSpec) == NUM_DEFAULT_PREFIXES, "Check your assumptions");
+
+static void compileFieldMatcher(FieldMatcher *fieldMatcher, const FieldSpec *fieldSpecs, uint32_t numFieldSpecs) {
+	uint32_t numExtractors = 0;
+
+	// Counting sort of the specs by the first byte of their name
+	for (uint32_t c = 0; c < 256; c++) {
+		fieldMatcher->firstExtractor[c] = numExtractors;
+
+		for (uint32_t i = 0; i < numFieldSpecs; i++) {
+			if ((uint8_t) fieldSpecs[i].name[0] == c) {
+				fieldMatcher->extractors[numExtractors] = fieldSpecs[i];
+				fieldMatcher->nameLengths[numExtractors++] = f6215943_getLength(fieldSpecs[i].name);
+			}
+		}
+	}
+
+	fieldMatcher->firstExtractor[256] = numExtractors;
+}
+
+// The two bytes that end a log prefix select its chain in the LogMatcher
+static inline uint8_t getPrefixKey(const char *prefixEnd) {
+	return (uint8_t) ((uint8_t) prefixEnd[-2] * 7 + (uint8_t) prefixEnd[-1]);
+}
+
+static void addLogPrefix(LogMatcher *logMatcher, PrefixSpec *prefixSpec) {
+	LogPrefix *logPrefix = &logMatcher->prefixes[logMatcher->numPrefixes++];
+	uint8_t *prefixNum;
+
+	logPrefix->prefixStart = prefixSpec->prefixStart;
+	logPrefix->prefixEnd = prefixSpec->prefixEnd;
+	logPrefix->fieldMatcher = &logMatcher->fieldMatchers[prefixSpec->dialect];
+	logPrefix->startLength = f6215943_getLength(prefixSpec->prefixStart);
+	logPrefix->endLength = f6215943_getLength(prefixSpec->prefixEnd);
+	logPrefix->next = 0;
+
+	// Append to the end of the chain so earlier prefixes are tried first
+	prefixNum = &logMatcher->prefixChains[getPrefixKey(logPrefix->prefixEnd + logPrefix->endLength)];
+
+	while (*prefixNum != 0) {
+		prefixNum = &logMatcher->prefixes[*prefixNum - 1].next;
+	}
+
+	*prefixNum = logMatcher->numPrefixes;
+}
+
+/*
+ * Compiles the default log prefixes followed by the prefixes given with -p,
+ * which use the nftables field set. A '*' in a prefix stands for any text.
+ */
+static void compileLogMatcher(LogMatcher *logMatcher, char **logPrefixes, uint32_t numLogPrefixes) {
+	PrefixSpec prefixSpec;
+	char *wildcard;
+
+	f668c4bd_meminit(logMatcher, sizeof(LogMatcher));
+
+	compileFieldMatcher(&logMatcher->fieldMatchers[DIALECT_IPTABLES], iptablesFieldSpecs, sizeof(iptablesFieldSpecs) / sizeof(FieldSpec));
+	compileFieldMatcher(&logMatcher->fieldMatchers[DIALECT_NFTABLES], nftablesFieldSpecs, sizeof(nftablesFieldSpecs) / sizeof(FieldSpec));
+
+	for (uint32_t i = 0; i < sizeof(defaultPrefixSpecs) / sizeof(PrefixSpec); i++) {
+		addLogPrefix(logMatcher, &defaultPrefixSpecs[i]);
+	}
+
+	for (uint32_t i = 0; i < numLogPrefixes; i++) {
+		wildcard = strchr(logPrefixes[i], '*');
+		prefixSpec.dialect = DIALECT_NFTABLES;
+
+		if (wildcard == NULL) {
+			prefixSpec.prefixStart = "";
+			prefixSpec.prefixEnd = logPrefixes[i];
+		} else {
+			*wildcard = '\0';
+			prefixSpec.prefixStart = logPrefixes[i];
+			prefixSpec.prefixEnd = wildcard + 1;
+		}
+
+		addLogPrefix(logMatcher, &prefixSpec);
+	}
+}
+
+/*
+ * Returns the LogPrefix that ends right before the "IN=" anchor, or NULL if
+ * the anchor does not follow a known log prefix.
+ */
+static LogPrefix *matchLogPrefix(char *lineStart, char *anchor) {
+	LogPrefix *logPrefix;
+	char *prefixEnd;
+	uint32_t prefixNum;
+
+	if (anchor - lineStart < 2) {
+		return NULL;
+	}
+
+	prefixNum = logMatcher.prefixChains[getPrefixKey(anchor)];
+
+	while (prefixNum != 0) {
+		logPrefix = &logMatcher.prefixes[prefixNum - 1];
+		prefixEnd = anchor - logPrefix->endLength;
+
+		if (prefixEnd >= lineStart && memcmp(prefixEnd, logPrefix->prefixEnd, logPrefix->endLength) == 0) {
+			if (logPrefix->startLength == 0 || memmem(lineStart, prefixEnd - lineStart, logPrefix->prefixStart, logPrefix->startLength) != NULL) {
+				return logPrefix;
+			}
+		}
+
+		prefixNum = logPrefix->next;
+	}
+
+	return NULL;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ LogScanner ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+static void initLogScanner(LogScanner *logScanner, LogTable *logTable) {
+	logScanner->logTable = logTable;
+	logScanner->buffer = f668c4bd_malloc(MEMORY_PAGE_SIZE);
+	logScanner->length = 0;
+	logScanner->size = MEMORY_PAGE_SIZE;
+}
+
+static void cleanUpLogScanner(LogScanner *logScanner) {
+	f668c4bd_free(logScanner->buffer);
+}
+
+static void carryLogData(LogScanner *logScanner, char *data, uint32_t length) {
+	// Reserve one extra byte so the carried line can be NUL-terminated
+	if (logScanner->length + length + 1 > logScanner->size) {
+		while (logScanner->length + length + 1 > logScanner->size) {
+			logScanner->size <<= 1;
+		}
+
+		logScanner->buffer = f668c4bd_realloc(logScanner->buffer, logScanner->size);
+	}
+
+	memcpy(logScanner->buffer + logScanner->length, data, length);
+	logScanner->length += length;
+}
+
+static void scanLine(LogTable *logTable, char *lineStart, char *lineEnd) {
+	LogLine logLine;
+	char *anchor = findFieldAnchor(lineStart, lineEnd);
+
+	while (anchor != NULL) {
+		if (parseBlockLine(&logLine, lineStart, anchor, lineEnd)) {
+			processLogLine(logTable, &logLine, lineStart, lineEnd);
+			return;
+		}
+
+		anchor = findFieldAnchor(anchor + 1, lineEnd);
+	}
+}
+
+/*
+ * Scans one block of syslog data in a single forward pass. Only lines holding
+ * an "IN=" anchor are ever looked at line-by-line; everything else is skipped
+ * by the SIMD anchor search. The fields of a BLOCK line are NUL-terminated in
+ * place, so the data block is modified.
+ */
+static void scanLogData(LogScanner *logScanner, char *data, uint32_t length) {
+	LogLine logLine;
+	char *end = data + length;
+	char *position = data;
+	char *anchor, *lineStart, *lineEnd;
+
+	// 1. Complete the line carried over from the previous block
+	if (logScanner->length > 0) {
+		lineEnd = memchr(data, '\n', length);
+
+		if (lineEnd == NULL) {
+			carryLogData(logScanner, data, length);
+			return;
+		}
+
+		carryLogData(logScanner, data, lineEnd - data);
+		scanLine(logScanner->logTable, logScanner->buffer, logScanner->buffer + logScanner->length);
+		logScanner->length = 0;
+		position = lineEnd + 1;
+	}
+
+	// 2. Jump from one "IN=" anchor to the next
+	anchor = findFieldAnchor(position, end);
+
+	while (anchor != NULL) {
+		lineEnd = memchr(anchor, '\n', end - anchor);
+
+		// Leave a partial line for the carry-over below
+		if (lineEnd == NULL) {
+			break;
+		}
+
+		lineStart = memrchr(position, '\n', anchor - position);
+		lineStart = (lineStart == NULL) ? position : lineStart + 1;
+
+		if (parseBlockLine(&logLine, lineStart, anchor, lineEnd)) {
+			processLogLine(logScanner->logTable, &logLine, lineStart, lineEnd);
+			position = lineEnd + 1;
+			anchor = findFieldAnchor(position, end);
+		} else {
+			anchor = findFieldAnchor(anchor + 1, end);
+		}
+	}
+
+	// 3. Carry the trailing partial line over to the next block
+	lineStart = memrchr(position, '\n', end - position);
+	lineStart = (lineStart == NULL) ? position : lineStart + 1;
+
+	if (lineStart < end) {
+		carryLogData(logScanner, lineStart, end - lineStart);
+	}
+}
+
+static void finishLogScanner(LogScanner *logScanner) {
+	if (logScanner->length > 0) {
+		scanLine(logScanner->logTable, logScanner->buffer, logScanner->buffer + logScanner->length);
+		logScanner->length = 0;
+	}
+}
+
+/*
+ * SSE2 search for the "IN=" anchor using a two-byte filter: sixteen candidate
+ * positions are tested at once for 'I' and for '=' two bytes later, and only
+ * the survivors are checked for the 'N' in between.
+ */
+static char *findFieldAnchor(char *position, char *end) {
+	const __m128i firstChar = _mm_set1_epi8('I');
+	const __m128i lastChar = _mm_set1_epi8('=');
+	__m128i firstBlock, lastBlock;
+	uint32_t mask;
+	char *candidate;
+
+	while (position + FIELD_ANCHOR_LENGTH + 16 <= end) {
+		firstBlock = _mm_loadu_si128((const __m128i*) position);
+		lastBlock = _mm_loadu_si128((const __m128i*) (position + 2));
+		mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(firstBlock, firstChar), _mm_cmpeq_epi8(lastBlock, lastChar)));
+
+		while (mask != 0) {
+			candidate = position + __builtin_ctz(mask);
+
+			if (candidate[1] == 'N') {
+				return candidate;
+			}
+
+			mask &= (mask - 1);
+		}
+
+		position += 16;
+	}
+
+	if (position >= end) {
+		return NULL;
+	}
+
+	return memmem(position, end - position, FIELD_ANCHOR, FIELD_ANCHOR_LENGTH);
+}
+
+static inline uint32_t parsePort(register const char *value) {
+	register uint32_t port = 0;
+
+	while (*value >= '0' && *value <= '9') {
+		port = (port * 10) + (*value++ - '0');
+	}
+
+	return port;
+}
+
+// Compares byte-by-byte so the NUL at the end of the line stops the match
+static inline bool hasFieldName(register const char *position, register const char *name, uint32_t nameLength) {
+	for (uint32_t i = 0; i < nameLength; i++) {
+		if (position[i] != name[i]) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Extracts the fields following the log prefix with the field extractors of
+ * its dialect. The LogLine points directly into the line, whose field
+ * separators are overwritten with NUL characters. Only the first occurrence
+ * of a field counts; ICMP error payloads repeat SRC= and DST=.
+ *
+ * Returns false if the "IN=" anchor does not follow a known log prefix.
+ */
+static bool parseBlockLine(LogLine *logLine, char *lineStart, char *anchor, char *lineEnd) {
+	static char emptyField[] = "";
+	char **stringFields[] = {
+		&logLine->in, &logLine->out, &logLine->macAddress,
+		&logLine->sourceIPAddr, &logLine->destIPAddr, &logLine->protocol
+	};
+	LogPrefix *logPrefix = matchLogPrefix(lineStart, anchor);
+	FieldMatcher *fieldMatcher;
+	register char *position;
+	char *value;
+	char **field;
+	uint32_t icmpType = 0, firstByte;
+	bool hasSourcePort = false, hasDestPort = false, hasType = false;
+
+	if (logPrefix == NULL) {
+		return false;
+	}
+
+	fieldMatcher = logPrefix->fieldMatcher;
+
+	logLine->in = logLine->out = logLine->macAddress = emptyField;
+	logLine->sourceIPAddr = logLine->destIPAddr = logLine->protocol = emptyField;
+	logLine->sourcePort = logLine->destPort = 0;
+	logLine->count = 1;
+
+	*lineEnd = '\0';
+	position = anchor;
+
+	while (position < lineEnd) {
+		field = NULL;
+		value = NULL;
+		firstByte = (uint8_t) *position;
+
+		// Only the extractors whose name starts with the same byte are tried
+		for (uint32_t i = fieldMatcher->firstExtractor[firstByte]; i < fieldMatcher->firstExtractor[firstByte + 1]; i++) {
+			if (!hasFieldName(position, fieldMatcher->extractors[i].name, fieldMatcher->nameLengths[i])) {
+				continue;
+			}
+
+			value = position + fieldMatcher->nameLengths[i];
+
+			switch (fieldMatcher->extractors[i].field) {
+				case FIELD_SPT:
+					if (!hasSourcePort) {
+						logLine->sourcePort = parsePort(value);
+						hasSourcePort = true;
+					}
+					break;
+				case FIELD_DPT:
+					if (!hasDestPort) {
+						logLine->destPort = parsePort(value);
+						hasDestPort = true;
+					}
+					break;
+				case FIELD_TYPE:
+					if (!hasType) {
+						icmpType = parsePort(value);
+						hasType = true;
+					}
+					break;
+				default:
+					field = stringFields[fieldMatcher->extractors[i].field];
+			}
+
+			break;
+		}
+
+		// Advance to the next space-separated token
+		position = strchrnul(position, ' ');
+
+		if (field != NULL && *field == emptyField) {
+			*field = value;
+		}
+
+		if (*position == ' ') {
+			*position++ = '\0';
+		}
+	}
+
+	// ICMP entries record the TYPE in place of the ports
+	if (hasType) {
+		logLine->sourcePort = icmpType;
+		logLine->destPort = 0;
+	}
+
+	return true;
+}
+
+/*
+ * Counts a BLOCK line in the LogTable of the current thread under its exact
+ * key; the merge rules are applied later by replayLogTable().
+ */
+static void processLogLine(LogTable *logTable, LogLine *logLine, char *lineStart, char *lineEnd) {
+	LogRecordList *logRecordList;
+	HashIndex *index;
+	LogRecordMatcher isMatch;
+	LogRecord logRecord;
+	uint32_t hashCode, entryNum;
+
+	if (logTable->statistics != NULL) {
+		updateStatistics(logTable->statistics, logLine, parseTimestamp(lineStart, lineEnd));
+		return;
+	}
+
+	encodeLogRecord(&logTable->stringPool, &logRecord, logLine);
+
+	if (*logLine->in) {
+		logRecordList = &logTable->inputList;
+		index = &logTable->inputIndex;
+		hashCode = hashInputLine(&logRecord);
+		isMatch = isSameInputLine;
+	} else {
+		logRecordList = &logTable->outputList;
+		index = &logTable->outputIndex;
+		hashCode = hashOutputTuple(&logRecord);
+		isMatch = isSameOutputTuple;
+	}
+
+	entryNum = findLogRecord(index, logRecordList, hashCode, &logRecord, isMatch);
+
+	if (entryNum != 0) {
+		logRecordList->values[entryNum - 1].count++;
+	} else {
+		putHashEntry(index, hashCode, addLogRecord(logRecordList, &logRecord));
+	}
+}
+
+/*
+ * IN=enp4s0 OUT= MAC=ff:ff:ff:ff:ff:ff:aa:bb:cc:dd:ee:ff:11:00 SRC=192.168.1.110 DST=192.168.1.255 PROTO=UDP SPT=59391 DPT=15600
+ *
+ * If an input rule triggered:
+ *   o Use MAC Address filtering
+ *   o Ignore changes in SRC
+ *   o Ignore changes in SPT and/or DPT
+ *
+ * An entry matches when the IN/OUT/MAC/SRC/PROTO tuple is equal and either the
+ * SPT or the DPT is the same. Both ports are indexed separately and the entry
+ * added first wins, which is the entry a linear scan of the list would find.
+ */
+void filterInputLogRecord(register LogRecord *logRecord) {
+	const uint32_t tupleHash = hashInputTuple(logRecord);
+	const uint32_t sourcePortHash = (tupleHash ^ logRecord->sourcePort) * FNV_PRIME;
+	const uint32_t destPortHash = (tupleHash ^ (logRecord->destPort | 0x10000)) * FNV_PRIME;
+	uint32_t sourcePortNum, destPortNum, entryNum;
+
+	// 1. Look up the earliest entry with the same SPT and/or DPT
+	sourcePortNum = findLogRecord(&inputSourcePortIndex, &inputRecordList, sourcePortHash, logRecord, isSameSourcePort);
+	destPortNum = findLogRecord(&inputDestPortIndex, &inputRecordList, destPortHash, logRecord, isSameDestPort);
+
+	if (sourcePortNum != 0 && (destPortNum == 0 || sourcePortNum < destPortNum)) {
+		entryNum = sourcePortNum;
+	} else {
+		entryNum = destPortNum;
+	}
+
+	if (entryNum != 0) {
+		inputRecordList.values[entryNum - 1].count += logRecord->count;
+		return;
+	}
+
+	// 2. Add the LogRecord to the input report
+	entryNum = addLogRecord(&inputRecordList, logRecord);
+
+	// 3. Index the new entry under both its SPT and DPT keys
+	putHashEntry(&inputSourcePortIndex, sourcePortHash, entryNum);
+	putHashEntry(&inputDestPortIndex, destPortHash, entryNum);
+}
+
+/*
+ * IN= OUT=enp4s0 SRC=2001:db8:85a3:8d3:1319:8a2e:370:7348 DST=2607:f8b0:4003:0c0c:0000:0000:0000:007f PROTO=UDP SPT=45771 DPT=19302
+ *
+ * If an output rule triggered:
+ *   o Ignore changes in SPT
+ */
+void filterOutputLogRecord(register LogRecord *logRecord) {
+	const uint32_t hashCode = hashOutputTuple(logRecord);
+	uint32_t entryNum;
+
+	// 1. Look up an existing output report entry
+	entryNum = findLogRecord(&outputIndex, &outputRecordList, hashCode, logRecord, isSameOutputTuple);
+
+	if (entryNum != 0) {
+		outputRecordList.values[entryNum - 1].count += logRecord->count;
+		return;
+	}
+
+	// 2. Add the LogRecord to the output report
+	putHashEntry(&outputIndex, hashCode, addLogRecord(&outputRecordList, logRecord));
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ Statistics ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+static Statistics *createStatistics(uint32_t numTopEntries) {
+	Statistics *statistics = f668c4bd_malloc(sizeof(Statistics));
+	uint32_t capacity = numTopEntries * SKETCH_CAPACITY_FACTOR;
+
+	if (capacity < SKETCH_MIN_CAPACITY) {
+		capacity = SKETCH_MIN_CAPACITY;
+	}
+
+	initTopSketch(&statistics->topSources, capacity);
+	initTopSketch(&statistics->topDestPorts, capacity);
+	initTopSketch(&statistics->topInterfaces, capacity);
+	initTimeHistogram(&statistics->minuteHistogram, MINUTES_PER_HOUR, 1);
+	initTimeHistogram(&statistics->hourHistogram, HOURS_PER_DAY, MINUTES_PER_HOUR);
+
+	statistics->numEvents = 0;
+	statistics->numTopEntries = numTopEntries;
+
+	return statistics;
+}
+
+static void destroyStatistics(Statistics *statistics) {
+	cleanUpTopSketch(&statistics->topSources);
+	cleanUpTopSketch(&statistics->topDestPorts);
+	cleanUpTopSketch(&statistics->topInterfaces);
+
+	f668c4bd_free(statistics);
+}
+
+// Appends text to a sketch key, truncating whatever does not fit
+static char *appendKey(char *position, char *keyEnd, const char *text) {
+	while (*text != '\0' && position < keyEnd - 1) {
+		*position++ = *text++;
+	}
+
+	*position = '\0';
+
+	return position;
+}
+
+/*
+ * Counts a BLOCK line in the sketches of the top sources, destination ports
+ * and interfaces and in the time buckets of its timestamp. Sources and ports
+ * are those of input lines, where they describe who knocked on which door.
+ */
+static void updateStatistics(Statistics *statistics, LogLine *logLine, int64_t timestamp) {
+	char key[SKETCH_KEY_SIZE];
+	char *keyEnd = key + SKETCH_KEY_SIZE;
+	char portText[12];
+	char *position;
+
+	if (*logLine->in) {
+		appendKey(appendKey(key, keyEnd, "SRC="), keyEnd, logLine->sourceIPAddr);
+		updateTopSketch(&statistics->topSources, key, 1, 0);
+
+		// ICMP entries have no destination port
+		if (logLine->destPort != 0) {
+			formatDecimal(portText, logLine->destPort);
+			position = appendKey(appendKey(key, keyEnd, "DPT="), keyEnd, portText);
+			appendKey(appendKey(position, keyEnd, " PROTO="), keyEnd, logLine->protocol);
+			updateTopSketch(&statistics->topDestPorts, key, 1, 0);
+		}
+
+		appendKey(appendKey(key, keyEnd, "IN="), keyEnd, logLine->in);
+	} else {
+		appendKey(appendKey(key, keyEnd, "OUT="), keyEnd, logLine->out);
+	}
+
+	updateTopSketch(&statistics->topInterfaces, key, 1, 0);
+
+	if (timestamp >= 0) {
+		addTimeBucket(&statistics->minuteHistogram, timestamp, 1);
+		addTimeBucket(&statistics->hourHistogram, timestamp / MINUTES_PER_HOUR, 1);
+	}
+
+	statistics->numEvents++;
+}
+
+static void mergeStatistics(Statistics *statistics, Statistics *other) {
+	mergeTopSketch(&statistics->topSources, &other->topSources);
+	mergeTopSketch(&statistics->topDestPorts, &other->topDestPorts);
+	mergeTopSketch(&statistics->topInterfaces, &other->topInterfaces);
+	mergeTimeHistogram(&statistics->minuteHistogram, &other->minuteHistogram);
+	mergeTimeHistogram(&statistics->hourHistogram, &other->hourHistogram);
+
+	statistics->numEvents += other->numEvents;
+}
+
+static void printStatistics(Statistics *statistics) {
+	char title[64];
+
+	sprintf(title, "firelog Top %u INPUT Sources", statistics->numTopEntries);
+	printTopSketch(&statistics->topSources, title, statistics->numTopEntries);
+
+	sprintf(title, "firelog Top %u INPUT Destination Ports", statistics->numTopEntries);
+	printTopSketch(&statistics->topDestPorts, title, statistics->numTopEntries);
+
+	sprintf(title, "firelog Top %u Interfaces", statistics->numTopEntries);
+	printTopSketch(&statistics->topInterfaces, title, statistics->numTopEntries);
+
+	printTimeHistogram(&statistics->minuteHistogram, "firelog BLOCK Events per Minute");
+	printTimeHistogram(&statistics->hourHistogram, "firelog BLOCK Events per Hour");
+
+	fflush(stdout);
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ TopSketch ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+static void initTopSketch(TopSketch *topSketch, uint32_t capacity) {
+	uint32_t numSlots = 2;
+
+	// Keep the index at most half full
+	while (numSlots < capacity * 2) {
+		numSlots <<= 1;
+	}
+
+	topSketch->counters = f668c4bd_malloc(capacity * sizeof(SketchCounter));
+	topSketch->heap = f668c4bd_malloc(capacity * sizeof(uint32_t));
+	topSketch->heapPositions = f668c4bd_malloc(capacity * sizeof(uint32_t));
+	topSketch->slots = f668c4bd_malloc(numSlots * sizeof(uint32_t));
+	topSketch->capacity = capacity;
+	topSketch->length = 0;
+	topSketch->mask = numSlots - 1;
+
+	f668c4bd_meminit(topSketch->slots, numSlots * sizeof(uint32_t));
+}
+
+static void cleanUpTopSketch(TopSketch *topSketch) {
+	f668c4bd_free(topSketch->counters);
+	f668c4bd_free(topSketch->heap);
+	f668c4bd_free(topSketch->heapPositions);
+	f668c4bd_free(topSketch->slots);
+}
+
+static inline uint32_t getHeapCount(TopSketch *topSketch, uint32_t position) {
+	return topSketch->counters[topSketch->heap[position]].count;
+}
+
+static void swapHeapEntries(TopSketch *topSketch, uint32_t a, uint32_t b) {
+	const uint32_t counterNum = topSketch->heap[a];
+
+	topSketch->heap[a] = topSketch->heap[b];
+	topSketch->heap[b] = counterNum;
+	topSketch->heapPositions[topSketch->heap[a]] = a;
+	topSketch->heapPositions[topSketch->heap[b]] = b;
+}
+
+// Restores the min-heap after the count at the given position grew
+static void siftDown(TopSketch *topSketch, uint32_t position) {
+	uint32_t child, smallest;
+
+	while (true) {
+		smallest = position;
+		child = (position << 1) + 1;
+
+		if (child < topSketch->length && getHeapCount(topSketch, child) < getHeapCount(topSketch, smallest)) {
+			smallest = child;
+		}
+
+		if (child + 1 < topSketch->length && getHeapCount(topSketch, child + 1) < getHeapCount(topSketch, smallest)) {
+			smallest = child + 1;
+		}
+
+		if (smallest == position) {
+			return;
+		}
+
+		swapHeapEntries(topSketch, position, smallest);
+		position = smallest;
+	}
+}
+
+// Moves a newly added counter up to its place in the min-heap
+static void siftUp(TopSketch *topSketch, uint32_t position) {
+	uint32_t parent;
+
+	while (position > 0) {
+		parent = (position - 1) >> 1;
+
+		if (getHeapCount(topSketch, parent) <= getHeapCount(topSketch, position)) {
+			return;
+		}
+
+		swapHeapEntries(topSketch, position, parent);
+		position = parent;
+	}
+}
+
+// Returns the index slot holding the key, or the empty slot it belongs in
+static uint32_t findSketchSlot(TopSketch *topSketch, uint32_t hashCode, char *key) {
+	register uint32_t i = hashCode & topSketch->mask;
+	register uint32_t counterNum;
+	SketchCounter *counter;
+
+	while ((counterNum = topSketch->slots[i]) != 0) {
+		counter = &topSketch->counters[counterNum - 1];
+
+		if (counter->hashCode == hashCode && f6215943_isEqual(counter->key, key)) {
+			break;
+		}
+
+		i = (i + 1) & topSketch->mask;
+	}
+
+	return i;
+}
+
+/*
+ * Empties an index slot and shifts the entries of the following probe run
+ * back, so linear probing never needs tombstones.
+ */
+static void removeSketchSlot(TopSketch *topSketch, uint32_t i) {
+	const uint32_t mask = topSketch->mask;
+	uint32_t j = i, counterNum, home;
+
+	while (true) {
+		topSketch->slots[i] = 0;
+
+		do {
+			j = (j + 1) & mask;
+
+			if ((counterNum = topSketch->slots[j]) == 0) {
+				return;
+			}
+
+			home = topSketch->counters[counterNum - 1].hashCode & mask;
+		} while (((j - home) & mask) < ((j - i) & mask));
+
+		topSketch->slots[i] = counterNum;
+		i = j;
+	}
+}
+
+/*
+ * Space-Saving update: a tracked key adds to its counter, an unseen key takes
+ * a free counter or else evicts the smallest one. The evicted count becomes
+ * the error of the new key, since that key may have been seen up to that many
+ * times before. The error of a merged counter is added on top.
+ */
+static void updateTopSketch(TopSketch *topSketch, char *key, uint32_t count, uint32_t error) {
+	const uint32_t hashCode = hashString(FNV_OFFSET_BASIS, key);
+	uint32_t slot = findSketchSlot(topSketch, hashCode, key);
+	uint32_t counterNum;
+	SketchCounter *counter;
+
+	if (topSketch->slots[slot] != 0) {
+		counterNum = topSketch->slots[slot] - 1;
+		counter = &topSketch->counters[counterNum];
+		counter->count += count;
+		counter->error += error;
+
+		siftDown(topSketch, topSketch->heapPositions[counterNum]);
+		return;
+	}
+
+	if (topSketch->length < topSketch->capacity) {
+		counterNum = topSketch->length++;
+		counter = &topSketch->counters[counterNum];
+		counter->count = count;
+		counter->error = error;
+
+		topSketch->heap[counterNum] = counterNum;
+		topSketch->heapPositions[counterNum] = counterNum;
+		siftUp(topSketch, counterNum);
+	} else {
+		counterNum = topSketch->heap[0];
+		counter = &topSketch->counters[counterNum];
+
+		removeSketchSlot(topSketch, findSketchSlot(topSketch, counter->hashCode, counter->key));
+		slot = findSketchSlot(topSketch, hashCode, key);
+
+		counter->error = counter->count + error;
+		counter->count += count;
+
+		siftDown(topSketch, 0);
+	}
+
+	memcpy(counter->key, key, f6215943_getLength(key) + 1);
+	counter->hashCode = hashCode;
+	topSketch->slots[slot] = counterNum + 1;
+}
+
+static void mergeTopSketch(TopSketch *topSketch, TopSketch *other) {
+	for (uint32_t i = 0; i < other->length; i++) {
+		updateTopSketch(topSketch, other->counters[i].key, other->counters[i].count, other->counters[i].error);
+	}
+}
+
+// Orders counters by descending count, then by key
+static int compareSketchCounters(const void *a, const void *b) {
+	const SketchCounter *counterA = a;
+	const SketchCounter *counterB = b;
+
+	if (counterA->count != counterB->count) {
+		return (counterA->count > counterB->count) ? -1 : 1;
+	}
+
+	return strcmp(counterA->key, counterB->key);
+}
+
+static void printTopSketch(TopSketch *topSketch, char *title, uint32_t numTopEntries) {
+	SketchCounter *ranking;
+	SketchCounter *counter;
+
+	if (topSketch->length == 0) {
+		return;
+	}
+
+	ranking = f668c4bd_malloc(topSketch->length * sizeof(SketchCounter));
+	memcpy(ranking, topSketch->counters, topSketch->length * sizeof(SketchCounter));
+	qsort(ranking, topSketch->length, sizeof(SketchCounter), compareSketchCounters);
+
+	if (numTopEntries > topSketch->length) {
+		numTopEntries = topSketch->length;
+	}
+
+	d99c60f5_printBox(title, false);
+
+	for (counter = ranking; counter < ranking + numTopEntries; counter++) {
+		if (counter->error == 0) {
+			printf("Count: %u %s\n", counter->count, counter->key);
+		} else {
+			printf("Count: %u %s (overcounted by at most %u)\n", counter->count, counter->key, counter->error);
+		}
+	}
+
+	printf("\n");
+
+	f668c4bd_free(ranking);
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ TimeHistogram ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+static void initTimeHistogram(TimeHistogram *timeHistogram, uint32_t numBuckets, uint32_t bucketWidth) {
+	for (uint32_t i = 0; i < MINUTES_PER_HOUR; i++) {
+		timeHistogram->bucketTimes[i] = -1;
+		timeHistogram->counts[i] = 0;
+	}
+
+	timeHistogram->latestBucket = -1;
+	timeHistogram->numBuckets = numBuckets;
+	timeHistogram->bucketWidth = bucketWidth;
+}
+
+/*
+ * Adds to the count of a bucket, given as minutes since the epoch divided by
+ * the bucket width. A slot is reused once a newer bucket maps to it; a bucket
+ * older than the one in its slot lies outside the window and is dropped.
+ */
+static void addTimeBucket(TimeHistogram *timeHistogram, int64_t bucket, uint32_t count) {
+	const uint32_t slot = bucket % timeHistogram->numBuckets;
+
+	if (timeHistogram->bucketTimes[slot] != bucket) {
+		if (timeHistogram->bucketTimes[slot] > bucket) {
+			return;
+		}
+
+		timeHistogram->bucketTimes[slot] = bucket;
+		timeHistogram->counts[slot] = 0;
+	}
+
+	timeHistogram->counts[slot] += count;
+
+	if (bucket > timeHistogram->latestBucket) {
+		timeHistogram->latestBucket = bucket;
+	}
+}
+
+static void mergeTimeHistogram(TimeHistogram *timeHistogram, TimeHistogram *other) {
+	for (uint32_t i = 0; i < other->numBuckets; i++) {
+		if (other->bucketTimes[i] >= 0) {
+			addTimeBucket(timeHistogram, other->bucketTimes[i], other->counts[i]);
+		}
+	}
+}
+
+static inline uint32_t getBucketCount(TimeHistogram *timeHistogram, int64_t bucket) {
+	const uint32_t slot = bucket % timeHistogram->numBuckets;
+
+	return (timeHistogram->bucketTimes[slot] == bucket) ? timeHistogram->counts[slot] : 0;
+}
+
+// Prints the window of buckets up to the latest one as a bar chart
+static void printTimeHistogram(TimeHistogram *timeHistogram, char *title) {
+	static const char monthNames[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+	char bar[HISTOGRAM_BAR_WIDTH + 1];
+	int64_t bucket, firstBucket, minutes;
+	uint32_t count, maxCount = 0, barLength, month, day;
+
+	if (timeHistogram->latestBucket < 0) {
+		return;
+	}
+
+	firstBucket = timeHistogram->latestBucket - timeHistogram->numBuckets + 1;
+
+	if (firstBucket < 0) {
+		firstBucket = 0;
+	}
+
+	for (bucket = firstBucket; bucket <= timeHistogram->latestBucket; bucket++) {
+		count = getBucketCount(timeHistogram, bucket);
+		maxCount = (count > maxCount) ? count : maxCount;
+	}
+
+	memset(bar, '#', HISTOGRAM_BAR_WIDTH);
+	bar[HISTOGRAM_BAR_WIDTH] = '\0';
+
+	d99c60f5_printBox(title, false);
+
+	for (bucket = firstBucket; bucket <= timeHistogram->latestBucket; bucket++) {
+		count = getBucketCount(timeHistogram, bucket);
+		barLength = (uint32_t) (((uint64_t) count * HISTOGRAM_BAR_WIDTH + maxCount - 1) / maxCount);
+		minutes = bucket * timeHistogram->bucketWidth;
+
+		civilFromDays(minutes / MINUTES_PER_DAY, &month, &day);
+
+		printf("%.3s %2u %02u:%02u %10u %.*s\n", &monthNames[(month - 1) * 3], day,
+			(uint32_t) (minutes % MINUTES_PER_DAY) / MINUTES_PER_HOUR, (uint32_t) (minutes % MINUTES_PER_HOUR),
+			count, barLength, bar);
+	}
+
+	printf("\n");
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ Timestamps ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+static void initTimestamps() {
+	time_t now = time(NULL);
+	struct tm today;
+
+	localtime_r(&now, &today);
+
+	currentYear = today.tm_year + 1900;
+	currentMonth = today.tm_mon + 1;
+}
+
+// Days since 1970-01-01 of a date in the proleptic Gregorian calendar
+static int64_t daysFromCivil(int32_t year, uint32_t month, uint32_t day) {
+	year -= (month <= 2);
+
+	const int32_t era = ((year >= 0) ? year : year - 399) / 400;
+	const uint32_t yearOfEra = (uint32_t) (year - era * 400);
+	const uint32_t dayOfYear = (153 * ((month > 2) ? month - 3 : month + 9) + 2) / 5 + day - 1;
+	const uint32_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+
+	return (int64_t) era * 146097 + dayOfEra - 719468;
+}
+
+// Inverse of daysFromCivil() for the month and day of a non-negative day count
+static void civilFromDays(int64_t days, uint32_t *month, uint32_t *day) {
+	days += 719468;
+
+	const int64_t era = days / 146097;
+	const uint32_t dayOfEra = (uint32_t) (days - era * 146097);
+	const uint32_t yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+	const uint32_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+	const uint32_t monthIndex = (5 * dayOfYear + 2) / 153;
+
+	*day = dayOfYear - (153 * monthIndex + 2) / 5 + 1;
+	*month = (monthIndex < 10) ? monthIndex + 3 : monthIndex - 9;
+}
+
+// Value of numDigits decimal digits, or -1 if any of them is not a digit
+static inline int32_t parseDigits(const char *text, uint32_t numDigits) {
+	int32_t value = 0;
+
+	for (uint32_t i = 0; i < numDigits; i++) {
+		if (text[i] < '0' || text[i] > '9') {
+			return -1;
+		}
+
+		value = value * 10 + (text[i] - '0');
+	}
+
+	return value;
+}
+
+/*
+ * Minutes since the epoch of the timestamp that starts a syslog line, either
+ * the traditional "Oct 16 14:02:11" or the RFC 3339 "2020-10-16T14:02:11.5+02:00"
+ * format. The time is taken as written, without converting the time zone.
+ *
+ * Returns -1 if the line does not start with a timestamp.
+ */
+static int64_t parseTimestamp(char *lineStart, char *lineEnd) {
+	static const char monthNames[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+	int32_t year, month, day, hour, minute;
+	char *monthName;
+
+	if (lineEnd - lineStart < 16) {
+		return -1;
+	}
+
+	if (lineStart[4] == '-') {
+		if (lineStart[7] != '-' || lineStart[10] != 'T' || lineStart[13] != ':') {
+			return -1;
+		}
+
+		year = parseDigits(lineStart, 4);
+		month = parseDigits(lineStart + 5, 2);
+		day = parseDigits(lineStart + 8, 2);
+		hour = parseDigits(lineStart + 11, 2);
+		minute = parseDigits(lineStart + 14, 2);
+	} else {
+		if (lineStart[3] != ' ' || lineStart[6] != ' ' || lineStart[9] != ':') {
+			return -1;
+		}
+
+		monthName = memmem(monthNames, sizeof(monthNames) - 1, lineStart, 3);
+
+		if (monthName == NULL || (monthName - monthNames) % 3 != 0) {
+			return -1;
+		}
+
+		month = (monthName - monthNames) / 3 + 1;
+		day = (lineStart[4] == ' ') ? parseDigits(lineStart + 5, 1) : parseDigits(lineStart + 4, 2);
+		hour = parseDigits(lineStart + 7, 2);
+		minute = parseDigits(lineStart + 10, 2);
+
+		// A month later in the year than today must be from last year
+		year = currentYear - ((uint32_t) month > currentMonth);
+	}
+
+	if (year < 1970 || month < 1 || month > 12 || day < 1 || day > 31 || hour < 0 || hour > 23 || minute < 0 || minute > 59) {
+		return -1;
+	}
+
+	return daysFromCivil(year, month, day) * MINUTES_PER_DAY + hour * MINUTES_PER_HOUR + minute;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ HashIndex ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+static void initHashIndex(HashIndex *index, uint32_t capacity) {
+	index->slots = f668c4bd_malloc(capacity * sizeof(uint32_t));
+	index->hashCodes = f668c4bd_malloc(capacity * sizeof(uint32_t));
+	index->capacity = capacity;
+	index->length = 0;
+
+	f668c4bd_meminit(index->slots, capacity * sizeof(uint32_t));
+}
+
+static void cleanUpHashIndex(HashIndex *index) {
+	f668c4bd_free(index->slots);
+	f668c4bd_free(index->hashCodes);
+}
+
+static uint32_t findLogRecord(HashIndex *index, LogRecordList *logRecordList, uint32_t hashCode, LogRecord *logRecord, LogRecordMatcher isMatch) {
+	register const uint32_t mask = index->capacity - 1;
+	register uint32_t i = hashCode & mask;
+	register uint32_t entryNum;
+
+	// Linear probing until an empty slot is reached
+	while ((entryNum = index->slots[i]) != 0) {
+		if (index->hashCodes[i] == hashCode && isMatch(&logRecordList->values[entryNum - 1], logRecord)) {
+			return entryNum;
+		}
+
+		i = (i + 1) & mask;
+	}
+
+	return 0;
+}
+
+static void putHashEntry(HashIndex *index, uint32_t hashCode, uint32_t entryNum) {
+	register uint32_t mask;
+	register uint32_t i;
+
+	// Double the capacity once the index is three-quarters full
+	if ((index->length + 1) * 4 > index->capacity * 3) {
+		HashIndex oldIndex = *index;
+
+		initHashIndex(index, oldIndex.capacity << 1);
+		mask = index->capacity - 1;
+
+		for (uint32_t j = 0; j < oldIndex.capacity; j++) {
+			if (oldIndex.slots[j] != 0) {
+				i = oldIndex.hashCodes[j] & mask;
+
+				while (index->slots[i] != 0) {
+					i = (i + 1) & mask;
+				}
+
+				index->slots[i] = oldIndex.slots[j];
+				index->hashCodes[i] = oldIndex.hashCodes[j];
+			}
+		}
+
+		index->length = oldIndex.length;
+		cleanUpHashIndex(&oldIndex);
+	}
+
+	mask = index->capacity - 1;
+	i = hashCode & mask;
+
+	while (index->slots[i] != 0) {
+		i = (i + 1) & mask;
+	}
+
+	index->slots[i] = entryNum;
+	index->hashCodes[i] = hashCode;
+	index->length++;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ Hash Functions ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+// FNV-1a hash of the string including its NUL terminator as a field separator
+static inline uint32_t hashString(register uint32_t hashCode, register const char *str) {
+	do {
+		hashCode = (hashCode ^ (uint8_t) *str) * FNV_PRIME;
+	} while (*str++ != '\0');
+
+	return hashCode;
+}
+
+// FNV-1a hash of an address and its format
+static inline uint32_t hashAddress(register uint32_t hashCode, register const uint8_t *address, uint8_t format) {
+	for (uint32_t i = 0; i < 16; i++) {
+		hashCode = (hashCode ^ address[i]) * FNV_PRIME;
+	}
+
+	return (hashCode ^ format) * FNV_PRIME;
+}
+
+static inline uint32_t hashValue(register uint32_t hashCode, register uint32_t value) {
+	return (hashCode ^ value) * FNV_PRIME;
+}
+
+static uint32_t hashInputTuple(LogRecord *logRecord) {
+	uint32_t hashCode = FNV_OFFSET_BASIS;
+
+	hashCode = hashValue(hashCode, logRecord->in);
+	hashCode = hashValue(hashCode, logRecord->out);
+	hashCode = hashValue(hashCode, logRecord->macAddress);
+	hashCode = hashAddress(hashCode, logRecord->sourceIPAddr, logRecord->sourceFormat);
+	hashCode = hashValue(hashCode, logRecord->protocol);
+
+	return hashCode;
+}
+
+static uint32_t hashInputLine(LogRecord *logRecord) {
+	uint32_t hashCode = hashInputTuple(logRecord);
+
+	hashCode = hashValue(hashCode, logRecord->sourcePort);
+	hashCode = hashValue(hashCode, logRecord->destPort);
+
+	return hashCode;
+}
+
+static uint32_t hashOutputTuple(LogRecord *logRecord) {
+	uint32_t hashCode = FNV_OFFSET_BASIS;
+
+	hashCode = hashValue(hashCode, logRecord->in);
+	hashCode = hashValue(hashCode, logRecord->out);
+	hashCode = hashAddress(hashCode, logRecord->destIPAddr, logRecord->destFormat);
+	hashCode = hashValue(hashCode, logRecord->protocol);
+
+	return hashValue(hashCode, logRecord->destPort);
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ Match Functions ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+static inline bool isSameInputTuple(LogRecord *listEntry, LogRecord *logRecord) {
+	return listEntry->in == logRecord->in
+		&& listEntry->out == logRecord->out
+		&& listEntry->macAddress == logRecord->macAddress
+		&& listEntry->protocol == logRecord->protocol
+		&& listEntry->sourceFormat == logRecord->sourceFormat
+		&& memcmp(listEntry->sourceIPAddr, logRecord->sourceIPAddr, 16) == 0;
+}
+
+static bool isSameInputLine(LogRecord *listEntry, LogRecord *logRecord) {
+	return listEntry->sourcePort == logRecord->sourcePort
+		&& listEntry->destPort == logRecord->destPort
+		&& isSameInputTuple(listEntry, logRecord);
+}
+
+static bool isSameSourcePort(LogRecord *listEntry, LogRecord *logRecord) {
+	return listEntry->sourcePort == logRecord->sourcePort && isSameInputTuple(listEntry, logRecord);
+}
+
+static bool isSameDestPort(LogRecord *listEntry, LogRecord *logRecord) {
+	return listEntry->destPort == logRecord->destPort && isSameInputTuple(listEntry, logRecord);
+}
+
+static bool isSameOutputTuple(LogRecord *listEntry, LogRecord *logRecord) {
+	return listEntry->destPort == logRecord->destPort
+		&& listEntry->in == logRecord->in
+		&& listEntry->out == logRecord->out
+		&& listEntry->protocol == logRecord->protocol
+		&& listEntry->destFormat == logRecord->destFormat
+		&& memcmp(listEntry->destIPAddr, logRecord->destIPAddr, 16) == 0;
 }
@@ -1,5 +1,5 @@
 /*
- * md5hash.c - DevOpsBroker utility for generating MD5 hashes
+ * md5hash.c - DevOpsBroker utility for generating MD5, SHA and BLAKE3 hashes
  *
  * Copyright (C) 2020 Edward Smith <edwardsmith@devopsbroker.org>
  *
@@ -28,8 +28,30 @@
 
 // ═════════════════════════════════ Includes ═════════════════════════════════
 
+#include <limits.h>
+#include <stdatomic.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <immintrin.h>
+#include <linux/aio_abi.h>
+#include <linux/fiemap.h>
+#include <linux/fs.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
 
 #include "org/devopsbroker/hash/md5.h"
 #include "org/devopsbroker/io/async.h"
@@ -45,21 +67,579 @@
 
 // ═══════════════════════════════ Preprocessor ═══════════════════════════════
 
-#define USAGE_MSG "md5hash " ANSI_GOLD "{ -n numRounds | -s salt | -h }" ANSI_YELLOW " [FILE]"
+#define USAGE_MSG "md5hash " ANSI_GOLD "{ -a algorithm | -c manifest | -j numThreads | -n numRounds | -s salt | --batch | --bench[=size] | --cache | --chunks file | --diff | --fail-fast | --io mode | --json | --stats | --tee file | --tree size | -h }" ANSI_YELLOW " [FILE...]"
+
+#define MAX_NUM_THREADS   256
+
+#define HASH_FILE_LIST_INITIAL_SIZE   256
+
+// Files up to this size are read in one go, and with MD5 hashed side by side
+// in the lanes of an MD5Lanes
+#define MAX_LANES                16
+#define SMALL_FILE_SIZE          (32 * 1024)
+#define MD5_LANE_BUFFER_SIZE     (SMALL_FILE_SIZE + 128)
+
+#define MAX_DIGEST_LENGTH   32
+
+// --cache keeps digests in an open-addressed table of this many slots
+#define HASH_CACHE_VERSION      1
+#define HASH_CACHE_NUM_SLOTS    (1 << 18)
+#define HASH_CACHE_MAX_PROBES   8
+
+// --tree hashes each file as chunks, every thread streaming its chunks through one buffer
+#define TREE_DEFAULT_CHUNK_SIZE   (64 * 1024 * 1024)
+#define TREE_MIN_CHUNK_SIZE       (64 * 1024)
+#define TREE_BUFFER_SIZE          (4 * 1024 * 1024)
+#define CHUNK_LIST_MAGIC          "md5hash chunks "
+
+// --bench hashes messages from one buffer until about BENCH_TARGET_BYTES are done
+#define BENCH_BUFFER_SIZE      (64 * 1024 * 1024)
+#define BENCH_TARGET_BYTES     (64 * 1024 * 1024)
+#define BENCH_DEFAULT_DIR      "/var/tmp"
+
+// Files modified this recently may still change within the same mtime tick
+#define HASH_CACHE_SETTLE_NS    (2 * 1000000000LL)
+
+#define BLAKE3_CHUNK_SIZE   1024
+#define BLAKE3_MAX_DEPTH    54
+
+// Subtrees of this many chunks are hashed on separate threads
+#define BLAKE3_SUBTREE_LOG2   6
+#define BLAKE3_SUBTREE_SIZE   (1 << BLAKE3_SUBTREE_LOG2)
+
+#define BLAKE3_CHUNK_START   (1 << 0)
+#define BLAKE3_CHUNK_END     (1 << 1)
+#define BLAKE3_PARENT        (1 << 2)
+#define BLAKE3_ROOT          (1 << 3)
+
+#define XXH3_STRIPE_SIZE          64
+#define XXH3_STRIPES_PER_BLOCK    16
+#define XXH3_SECRET_SIZE          192
+#define XXH3_MAX_SHORT_INPUT      240
+
+#define XXH_PRIME32_1   0x9e3779b1U
+#define XXH_PRIME32_2   0x85ebca77U
+#define XXH_PRIME32_3   0xc2b2ae3dU
+#define XXH_PRIME64_1   0x9e3779b185ebca87ULL
+#define XXH_PRIME64_2   0xc2b2ae3d27d4eb4fULL
+#define XXH_PRIME64_3   0x165667b19e3779f9ULL
+#define XXH_PRIME64_4   0x85ebca77c2b2ae63ULL
+#define XXH_PRIME64_5   0x27d4eb2f165667c5ULL
+#define XXH_PRIME_MX1   0x165667919e3779f9ULL
+#define XXH_PRIME_MX2   0x9fb21c651e98df25ULL
+
+// STDIN is read by a separate thread into a ring of large buffers
+#define STDIN_NUM_BUFFERS   4
+#define STDIN_BUFFER_SIZE   (2 * 1024 * 1024)
+#define STDIN_PIPE_SIZE     (1024 * 1024)
+
+// --io=mmap maps files in windows that start on a hugepage boundary
+#define HUGEPAGE_SIZE      (2 * 1024 * 1024)
+#define MMAP_WINDOW_SIZE   (32 * HUGEPAGE_SIZE)
+
+// --io=direct reads into two aligned buffers, hashing one while filling the other
+#define DIRECT_BUFFER_SIZE   (4 * 1024 * 1024)
+#define DIRECT_ALIGNMENT     MEMORY_PAGE_SIZE
+
+#define ROTATE_LEFT(x, s)  (((x) << (s)) | ((x) >> (32 - (s))))
+#define ROTATE_RIGHT(x, s) (((x) >> (s)) | ((x) << (32 - (s))))
+
+#define MD5_F(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+#define MD5_G(x, y, z) ((y) ^ ((z) & ((x) ^ (y))))
+#define MD5_H(x, y, z) ((x) ^ (y) ^ (z))
+#define MD5_I(x, y, z) ((y) ^ ((x) | ~(z)))
+
+#define MD5_STEP(f, a, b, c, d, m, k, s) \
+	a += f(b, c, d) + (m) + md5Constants[k]; \
+	a = b + ROTATE_LEFT(a, s)
+
+// The 64 MD5 steps on vectors holding one word of each lane
+#define MD5_ROUNDS(M, a, b, c, d) \
+	for (int k = 0; k < 16; k += 4) { \
+		MD5_STEP(MD5_F, a, b, c, d, M[k], k, 7); \
+		MD5_STEP(MD5_F, d, a, b, c, M[k + 1], k + 1, 12); \
+		MD5_STEP(MD5_F, c, d, a, b, M[k + 2], k + 2, 17); \
+		MD5_STEP(MD5_F, b, c, d, a, M[k + 3], k + 3, 22); \
+	} \
+	for (int k = 16; k < 32; k += 4) { \
+		MD5_STEP(MD5_G, a, b, c, d, M[(5 * k + 1) & 15], k, 5); \
+		MD5_STEP(MD5_G, d, a, b, c, M[(5 * k + 6) & 15], k + 1, 9); \
+		MD5_STEP(MD5_G, c, d, a, b, M[(5 * k + 11) & 15], k + 2, 14); \
+		MD5_STEP(MD5_G, b, c, d, a, M[(5 * k) & 15], k + 3, 20); \
+	} \
+	for (int k = 32; k < 48; k += 4) { \
+		MD5_STEP(MD5_H, a, b, c, d, M[(3 * k + 5) & 15], k, 4); \
+		MD5_STEP(MD5_H, d, a, b, c, M[(3 * k + 8) & 15], k + 1, 11); \
+		MD5_STEP(MD5_H, c, d, a, b, M[(3 * k + 11) & 15], k + 2, 16); \
+		MD5_STEP(MD5_H, b, c, d, a, M[(3 * k + 14) & 15], k + 3, 23); \
+	} \
+	for (int k = 48; k < 64; k += 4) { \
+		MD5_STEP(MD5_I, a, b, c, d, M[(7 * k) & 15], k, 6); \
+		MD5_STEP(MD5_I, d, a, b, c, M[(7 * k + 7) & 15], k + 1, 10); \
+		MD5_STEP(MD5_I, c, d, a, b, M[(7 * k + 14) & 15], k + 2, 15); \
+		MD5_STEP(MD5_I, b, c, d, a, M[(7 * k + 5) & 15], k + 3, 21); \
+	}
+
+#define BLAKE3_G(a, b, c, d, x, y) \
+	a += b + (x); d = ROTATE_RIGHT(d ^ a, 16); \
+	c += d;       b = ROTATE_RIGHT(b ^ c, 12); \
+	a += b + (y); d = ROTATE_RIGHT(d ^ a, 8); \
+	c += d;       b = ROTATE_RIGHT(b ^ c, 7)
+
+// The seven BLAKE3 rounds on the 16 state words v and the message words m
+#define BLAKE3_ROUNDS(v, m) \
+	for (int r = 0; r < 7; r++) { \
+		const uint8_t *s = blake3Schedule[r]; \
+		BLAKE3_G(v[0], v[4], v[8], v[12], m[s[0]], m[s[1]]); \
+		BLAKE3_G(v[1], v[5], v[9], v[13], m[s[2]], m[s[3]]); \
+		BLAKE3_G(v[2], v[6], v[10], v[14], m[s[4]], m[s[5]]); \
+		BLAKE3_G(v[3], v[7], v[11], v[15], m[s[6]], m[s[7]]); \
+		BLAKE3_G(v[0], v[5], v[10], v[15], m[s[8]], m[s[9]]); \
+		BLAKE3_G(v[1], v[6], v[11], v[12], m[s[10]], m[s[11]]); \
+		BLAKE3_G(v[2], v[7], v[8], v[13], m[s[12]], m[s[13]]); \
+		BLAKE3_G(v[3], v[4], v[9], v[14], m[s[14]], m[s[15]]); \
+	}
 
 // ═════════════════════════════════ Typedefs ═════════════════════════════════
 
+typedef enum IOMode {
+	IO_AIO,
+	IO_MMAP,
+	IO_DIRECT
+} IOMode;
+
 typedef struct MD5Params {
-	char    *fileName;
+	char   **fileNames;
 	char    *salt;
+	char    *teeFileName;
+	char    *manifestName;
+	char    *chunkListName;
+	uint64_t chunkSize;
+	uint32_t numFiles;
 	uint32_t saltLength;
 	uint32_t numRounds;
+	uint32_t numThreads;
+	bool     isBatch;
+	bool     isCached;
+	bool     isDiff;
+	bool     isFailFast;
 } MD5Params;
 
-static_assert(sizeof(MD5Params) == 24, "Check your assumptions");
+static_assert(sizeof(MD5Params) == 72, "Check your assumptions");
+
+/*
+ * Read stage of STDIN. The reader thread fills the ring buffers in order and
+ * the hashing thread empties them in the same order; numFull is the only state
+ * they share. Every buffer but the last is filled completely, so the hashing
+ * thread can always stream whole MD5 blocks.
+ */
+typedef struct StdinReader {
+	pthread_mutex_t mutex;
+	pthread_cond_t  isNotEmpty;
+	pthread_cond_t  isNotFull;
+	uint8_t        *buffers[STDIN_NUM_BUFFERS];
+	uint32_t        lengths[STDIN_NUM_BUFFERS];
+	char           *teeFileName;
+	int             teePipe[2];
+	int             teeFd;
+	uint32_t        numFull;
+} StdinReader;
+
+static_assert(sizeof(StdinReader) == 208, "Check your assumptions");
+
+/*
+ * Regular file to hash; errorNumber is set if it could not be read. With -c,
+ * expectedDigest points into the manifest and isChecked is set once the file
+ * has been compared against it.
+ */
+typedef struct HashFile {
+	char          *fileName;
+	const uint8_t *expectedDigest;
+	uint8_t        digest[MAX_DIGEST_LENGTH];
+	int            errorNumber;
+	bool           isChecked;
+} HashFile;
+
+static_assert(sizeof(HashFile) == 56, "Check your assumptions");
+
+/*
+ * One line of a -c manifest. Files are read in order of device and location,
+ * which is the physical offset of the first extent or else the inode number.
+ */
+typedef struct ManifestEntry {
+	char    *fileName;
+	uint8_t  digest[MAX_DIGEST_LENGTH];
+	uint64_t device;
+	uint64_t location;
+	uint32_t hashFileNum;
+} ManifestEntry;
+
+static_assert(sizeof(ManifestEntry) == 64, "Check your assumptions");
+
+typedef struct Manifest {
+	ManifestEntry *values;
+	uint32_t       length;
+	uint32_t       numInvalid;
+} Manifest;
+
+static_assert(sizeof(Manifest) == 16, "Check your assumptions");
+
+typedef struct HashFileList {
+	HashFile *values;
+	uint32_t  length;
+	uint32_t  size;
+} HashFileList;
+
+static_assert(sizeof(HashFileList) == 16, "Check your assumptions");
+
+// Identifies the contents of a file for as long as it is not modified
+typedef struct HashCacheKey {
+	uint64_t device;
+	uint64_t inode;
+	uint64_t size;
+	int64_t  mtime;
+} HashCacheKey;
+
+static_assert(sizeof(HashCacheKey) == 32, "Check your assumptions");
+
+/*
+ * Slot of the --cache table. Writers make sequence odd while they fill the
+ * slot and even again when done, so readers never take a lock: a slot that is
+ * odd or changes while being copied is a miss. The checksum covers everything
+ * after it and rejects slots torn by a crash.
+ */
+typedef struct HashCacheSlot {
+	_Atomic uint32_t sequence;
+	uint32_t         checksum;
+	HashCacheKey     key;
+	uint32_t         algorithm;
+	uint32_t         numRounds;
+	uint8_t          digest[MAX_DIGEST_LENGTH];
+} HashCacheSlot;
+
+static_assert(sizeof(HashCacheSlot) == 80, "Check your assumptions");
+
+typedef struct HashCacheHeader {
+	char     magic[8];
+	uint32_t version;
+	uint32_t slotSize;
+	uint64_t numSlots;
+	uint8_t  padding[40];
+} HashCacheHeader;
+
+static_assert(sizeof(HashCacheHeader) == 64, "Check your assumptions");
+
+typedef struct HashCache {
+	HashCacheHeader *header;
+	HashCacheSlot   *slots;
+	uint64_t         mapLength;
+	int64_t          maxMtime;
+	uint32_t         algorithm;
+	_Atomic uint32_t numHits;
+} HashCache;
+
+static_assert(sizeof(HashCache) == 40, "Check your assumptions");
+
+/*
+ * Range [head, tail) of HashFileList positions still to be hashed by one
+ * worker, packed into a single word so the owner taking a file from the head
+ * and a thief taking files from the tail each need only one compare-and-swap.
+ * Padded to a cache line so the queues of different workers never share one.
+ */
+typedef struct WorkQueue {
+	_Atomic uint64_t range;
+	uint8_t          padding[CACHE_LINE_SIZE - sizeof(uint64_t)];
+} WorkQueue;
+
+static_assert(sizeof(WorkQueue) == CACHE_LINE_SIZE, "Check your assumptions");
+
+typedef struct HashWorker {
+	pthread_t thread;
+	uint64_t  numBytes;
+	uint32_t  workerNum;
+} HashWorker;
+
+static_assert(sizeof(HashWorker) == 24, "Check your assumptions");
+
+// Kernel AIO context and the two O_DIRECT buffers of one worker
+typedef struct DirectReader {
+	aio_context_t aioContext;
+	uint8_t      *buffers[2];
+} DirectReader;
+
+static_assert(sizeof(DirectReader) == 24, "Check your assumptions");
+
+typedef uint32_t LaneVector4 __attribute__ ((vector_size (16)));
+typedef uint32_t LaneVector8 __attribute__ ((vector_size (32)));
+typedef uint32_t LaneVector16 __attribute__ ((vector_size (64)));
+
+/*
+ * Multi-buffer MD5: every lane hashes a different small file held in its own
+ * buffer, one 64-byte block per lane per call of the md5TransformLanes kernel.
+ * The state is stored lane by lane so each of A, B, C and D loads as a single
+ * vector. An idle lane hashes a block of zeros whose result is thrown away.
+ */
+typedef struct MD5Lanes {
+	uint32_t       state[4][MAX_LANES];
+	const uint8_t *blocks[MAX_LANES];
+	HashFile      *hashFiles[MAX_LANES];
+	HashCacheKey   cacheKeys[MAX_LANES];
+	uint8_t       *buffers[MAX_LANES];
+	uint32_t       numBlocks[MAX_LANES];
+	uint32_t       numLanes;
+	uint32_t       numActive;
+} MD5Lanes;
+
+static_assert(sizeof(MD5Lanes) == 1224, "Check your assumptions");
+
+typedef void (*MD5TransformLanes)(uint32_t state[4][MAX_LANES], const uint8_t *blocks[MAX_LANES]);
+typedef void (*MD5StretchLanes)(uint32_t state[4][MAX_LANES], uint32_t numRounds);
+
+// Passwords read from STDIN by --batch, one per line
+typedef struct PasswordList {
+	uint8_t  *input;
+	uint8_t **values;
+	uint32_t *lengths;
+	uint8_t  *digests;
+	uint32_t  length;
+} PasswordList;
+
+static_assert(sizeof(PasswordList) == 40, "Check your assumptions");
+
+/*
+ * XXH3 keeps the last stripe seen back from the accumulators, because the
+ * final stripe of the input is mixed in with a different part of the secret.
+ * Inputs of up to 240 bytes use separate algorithms, so their first bytes are
+ * kept as well.
+ */
+typedef struct XXH3State {
+	uint64_t accumulators[8];
+	uint8_t  lastStripe[XXH3_STRIPE_SIZE];
+	uint8_t  shortInput[XXH3_MAX_SHORT_INPUT + 16];
+	uint32_t shortLength;
+	uint32_t numStripes;
+	bool     hasLastStripe;
+} XXH3State;
+
+static_assert(sizeof(XXH3State) == 400, "Check your assumptions");
+
+/*
+ * BLAKE3 keeps the chaining values of the completed subtrees on a stack, and
+ * the last chunk seen in chunk until more input shows it is not the root.
+ */
+typedef struct Blake3State {
+	uint32_t chainingValues[BLAKE3_MAX_DEPTH][8];
+	uint8_t  chunk[BLAKE3_CHUNK_SIZE];
+	uint64_t chunkCounter;
+	uint32_t chunkLength;
+	uint32_t numChainingValues;
+} Blake3State;
+
+static_assert(sizeof(Blake3State) == 2768, "Check your assumptions");
+
+typedef union DigestState {
+	uint32_t    md5[4];
+	uint32_t    sha1[5];
+	uint32_t    sha256[8];
+	XXH3State   xxh3;
+	Blake3State blake3;
+} DigestState;
+
+/*
+ * Common interface of the digest algorithms. The stream function takes a
+ * multiple of 64 bytes and may be followed by any number of stream calls and
+ * then exactly one streamEnd call, which takes the rest of the input and
+ * stores the digest.
+ */
+typedef struct DigestAlgorithm {
+	const char *name;
+	void      (*init)(DigestState *state);
+	void      (*stream)(DigestState *state, void *buffer, uint32_t length);
+	void      (*streamEnd)(DigestState *state, void *buffer, uint32_t length, uint64_t totalLength, uint8_t *digest);
+	void      (*print)(uint8_t *digest);
+	uint32_t    digestLength;
+} DigestAlgorithm;
+
+static_assert(sizeof(DigestAlgorithm) == 48, "Check your assumptions");
+
+typedef void (*Blake3CompressLanes)(uint32_t chainingValues[8][MAX_LANES], const uint8_t *blocks[MAX_LANES],
+                                    const uint32_t counters[2][MAX_LANES], uint32_t blockLength, uint32_t flags);
+
+typedef void (*ShaTransform)(uint32_t *state, const uint8_t *blocks, uint32_t numBlocks);
+
+typedef void (*XXH3Accumulate)(uint64_t accumulators[8], const uint8_t *stripes, const uint8_t *secret, uint32_t numStripes);
+
+// Subtrees of one stream call shared by the threads hashing them
+typedef struct Blake3Job {
+	const uint8_t   *input;
+	uint32_t       (*chainingValues)[8];
+	uint64_t         chunkCounter;
+	uint32_t         numSubtrees;
+	_Atomic uint32_t nextSubtree;
+} Blake3Job;
+
+static_assert(sizeof(Blake3Job) == 32, "Check your assumptions");
+
+// Digests of the fixed-size chunks of one file, in file order
+typedef struct ChunkList {
+	const DigestAlgorithm *algorithm;
+	uint8_t               *digests;
+	uint64_t               fileSize;
+	uint64_t               chunkSize;
+	uint64_t               numChunks;
+} ChunkList;
+
+static_assert(sizeof(ChunkList) == 40, "Check your assumptions");
+
+// Chunks of one --tree file shared by the threads hashing them
+typedef struct TreeJob {
+	ChunkList       *chunkList;
+	char            *fileName;
+	_Atomic uint64_t nextChunk;
+	_Atomic int      errorNumber;
+} TreeJob;
+
+static_assert(sizeof(TreeJob) == 32, "Check your assumptions");
+
+typedef struct BenchParams {
+	uint8_t *buffer;
+	char    *dirName;
+	uint64_t maxSize;
+	uint32_t numResults;
+	int      syscallCounter;
+	bool     isJson;
+} BenchParams;
+
+static_assert(sizeof(BenchParams) == 40, "Check your assumptions");
+
+typedef struct BenchResult {
+	const char     *name;
+	uint64_t        size;
+	uint64_t        numBytes;
+	uint64_t        numCycles;
+	uint64_t        numSyscalls;
+	struct timespec startTime;
+	double          seconds;
+} BenchResult;
+
+static_assert(sizeof(BenchResult) == 64, "Check your assumptions");
 
 // ═════════════════════════════ Global Variables ═════════════════════════════
 
+// Command-line parameters; the workers read the salt and number of rounds
+MD5Params md5Params;
+
+// Files to hash, sorted by name
+HashFileList hashFileList;
+
+PasswordList passwordList;
+
+// Entries of the -c manifest in the order they were listed
+Manifest manifest;
+
+// Set by --fail-fast at the first file that fails verification
+atomic_bool isStopped;
+
+// Digests of unchanged files kept between runs by --cache
+HashCache hashCache;
+
+// One WorkQueue per HashWorker
+WorkQueue *workQueues;
+uint32_t   numWorkers;
+
+// How files too large for the MD5Lanes are read
+IOMode ioMode = IO_AIO;
+
+static const char *const ioModeNames[] = { "aio", "mmap", "direct" };
+static const char *const benchIONames[] = { "io-aio", "io-mmap", "io-direct" };
+
+// --bench settings; the I/O test file goes in dirName
+BenchParams benchParams = { .dirName = BENCH_DEFAULT_DIR, .syscallCounter = -1 };
+
+// Print a throughput line to STDERR when done
+bool reportStats = false;
+
+// Total bytes hashed by all workers
+_Atomic uint64_t totalBytes;
+
+// Kernels selected for this CPU
+MD5TransformLanes   md5TransformLanes;
+MD5StretchLanes     md5StretchLanes;
+Blake3CompressLanes blake3CompressLanes;
+ShaTransform        sha1Transform;
+ShaTransform        sha256Transform;
+XXH3Accumulate      xxh3Accumulate;
+uint32_t            numLanes;
+
+// Threads hashing the BLAKE3 subtrees of one file
+uint32_t numBlake3Threads = 1;
+
+static const uint8_t zeroBlock[64];
+
+/*
+ * Message block of the MD5 rounds after the first, which hash the previous
+ * digest and the salt. Words 0-3 are replaced by the digest each round.
+ */
+uint32_t md5StretchBlock[16];
+bool     isOneBlockStretch = false;
+
+static const uint32_t md5Constants[64] = {
+	0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+	0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+	0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+	0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+	0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+	0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+	0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+	0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+};
+
+static const uint32_t sha1InitialState[5] = {
+	0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0
+};
+
+// Also the BLAKE3 IV
+static const uint32_t sha256InitialState[8] = {
+	0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+static const uint32_t sha256Constants[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+// Default XXH3 secret
+static const uint8_t xxh3Secret[XXH3_SECRET_SIZE] = {
+	0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+	0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+	0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+	0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+	0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+	0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+	0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+	0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+	0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+	0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+	0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+	0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e
+};
+
+// Message word order of each BLAKE3 round
+static const uint8_t blake3Schedule[7][16] = {
+	{  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15 },
+	{  2,  6,  3, 10,  7,  0,  4, 13,  1, 11, 12,  5,  9, 14, 15,  8 },
+	{  3,  4, 10, 12, 13,  2,  7, 14,  6,  5,  9,  0, 11, 15,  8,  1 },
+	{ 10,  7, 12,  9, 14,  3, 13, 15,  4,  0, 11,  2,  5,  8,  1,  6 },
+	{ 12, 13,  9, 11, 15, 10, 14,  8,  7,  2,  5,  3,  0,  1,  6,  4 },
+	{  9, 14, 11,  5,  8, 12, 15,  1, 13,  3,  0, 10,  2,  6,  4,  7 },
+	{ 11, 15,  5,  0,  1,  9,  8,  6, 14, 10,  2, 12,  3,  4,  7, 13 }
+};
 
 // ════════════════════════════ Function Prototypes ═══════════════════════════
 
@@ -67,98 +647,199 @@ static void processCmdLine(CmdLineParam *cmdLineParam, MD5Params *md5Params);
 
 static void printHelp();
 
+static void hashStdin(MD5Params *md5Params, DigestState *digestState, uint8_t *digest);
+static void *runStdinReader(void *stdinReader);
+static void teeError(StdinReader *stdinReader);
+
+static void printFileError(char *fileName, int errorNumber);
+static bool collectFiles(char *fileName);
+static void hashFiles(uint32_t numThreads);
+static bool printFileDigests();
+static void printFileName(char *fileName);
+static int compareHashFiles(const void *a, const void *b);
+
+static bool readManifest(char *manifestName);
+static void checkHashFile(HashFile *hashFile);
+static bool printVerifyResults();
+
+static void openHashCache();
+static void initCacheKey(HashCacheKey *cacheKey, FileStatus *fileStatus);
+static bool lookupCachedDigest(const HashCacheKey *cacheKey, uint8_t *digest);
+static void cacheHashFile(const HashCacheKey *cacheKey, HashFile *hashFile);
+
+static void hashTreeFiles(uint32_t numThreads);
+static bool diffChunkLists();
+
+static void *runHashWorker(void *hashWorker);
+static bool takeHashFile(WorkQueue *workQueue, uint32_t *fileNum);
+static bool stealHashFiles(uint32_t workerNum);
+
+static void selectHashKernels();
+static void initMD5Lanes(MD5Lanes *md5Lanes);
+static void cleanUpMD5Lanes(MD5Lanes *md5Lanes);
+static void loadMD5Lane(MD5Lanes *md5Lanes, HashFile *hashFile, const HashCacheKey *cacheKey, int fd, uint32_t fileSize);
+static void runMD5Lanes(MD5Lanes *md5Lanes, bool isDraining);
+
+static void hashMappedFile(HashFile *hashFile, DigestState *digestState, int fd, uint64_t fileSize);
+static void initDirectReader(DirectReader *directReader);
+static void cleanUpDirectReader(DirectReader *directReader);
+static bool hashDirectFile(DirectReader *directReader, HashFile *hashFile, DigestState *digestState, uint64_t fileSize);
+
+static void md5Init(DigestState *state);
+static void md5Stream(DigestState *state, void *buffer, uint32_t length);
+static void md5StreamEnd(DigestState *state, void *buffer, uint32_t length, uint64_t totalLength, uint8_t *digest);
+static void md5Print(uint8_t *digest);
+
+static void sha1Init(DigestState *state);
+static void sha1Stream(DigestState *state, void *buffer, uint32_t length);
+static void sha1StreamEnd(DigestState *state, void *buffer, uint32_t length, uint64_t totalLength, uint8_t *digest);
+static void sha1Print(uint8_t *digest);
+
+static void sha256Init(DigestState *state);
+static void sha256Stream(DigestState *state, void *buffer, uint32_t length);
+static void sha256StreamEnd(DigestState *state, void *buffer, uint32_t length, uint64_t totalLength, uint8_t *digest);
+static void sha256Print(uint8_t *digest);
+
+static void xxh3Init(DigestState *state);
+static void xxh3Stream(DigestState *state, void *buffer, uint32_t length);
+static void xxh3StreamEnd(DigestState *state, void *buffer, uint32_t length, uint64_t totalLength, uint8_t *digest);
+static void xxh3Print(uint8_t *digest);
+
+static void blake3Init(DigestState *state);
+static void blake3Stream(DigestState *state, void *buffer, uint32_t length);
+static void blake3StreamEnd(DigestState *state, void *buffer, uint32_t length, uint64_t totalLength, uint8_t *digest);
+static void blake3Print(uint8_t *digest);
+
+static void finishDigest(DigestState *digestState, uint8_t *buffer, uint32_t length, uint64_t totalLength, uint8_t *digest);
+static void stretchDigest(uint8_t *digest);
+static void initStretchBlock();
+
+static uint8_t *readWholeFile(int fd, char *fileName, uint64_t *length);
+static void readPasswords();
+static void hashPasswords(uint32_t numThreads);
+
+static void printStats(struct timespec *startTime, const char *ioModeName);
+static void runBench();
+
+static const DigestAlgorithm digestAlgorithms[] = {
+	{ "md5",    md5Init,    md5Stream,    md5StreamEnd,    md5Print,    16 },
+	{ "sha1",   sha1Init,   sha1Stream,   sha1StreamEnd,   sha1Print,   20 },
+	{ "sha256", sha256Init, sha256Stream, sha256StreamEnd, sha256Print, 32 },
+	{ "xxh3",   xxh3Init,   xxh3Stream,   xxh3StreamEnd,   xxh3Print,    8 },
+	{ "blake3", blake3Init, blake3Stream, blake3StreamEnd, blake3Print, 32 }
+};
+
+#define NUM_DIGEST_ALGORITHMS (sizeof(digestAlgorithms) / sizeof(DigestAlgorithm))
+
+const DigestAlgorithm *digestAlgorithm = &digestAlgorithms[0];
+
 // ══════════════════════════════════ main() ══════════════════════════════════
 
 int main(int argc, char *argv[]) {
 	CmdLineParam cmdLineParam;
-	MD5Params md5Params;
+	bool isSuccess = true;
 
 	programName = "md5hash";
 
 	d7ad7024_initCmdLineParam(&cmdLineParam, argc, argv, USAGE_MSG);
 	processCmdLine(&cmdLineParam, &md5Params);
 
-	// Common variables
-	uint32_t md5State[4];
-	ssize_t numBytes;
+	struct timespec startTime;
+	clock_gettime(CLOCK_MONOTONIC, &startTime);
 
-	// Initialize MD5 state
-	f1518caf_initMD5State(md5State);
+	selectHashKernels();
+	initStretchBlock();
 
-	if (md5Params.fileName == NULL) {
-		char buffer[MEMORY_PAGE_SIZE];
+	if (benchParams.maxSize != 0) {
+		runBench();
+		exit(EXIT_SUCCESS);
+	}
 
-		numBytes = e2f74138_readFile(STDIN_FILENO, buffer, MEMORY_PAGE_SIZE, "STDIN");
+	if (md5Params.isBatch) {
+		readPasswords();
+		hashPasswords(md5Params.numThreads);
 
-		while (numBytes != END_OF_FILE) {
-			if (numBytes == MEMORY_PAGE_SIZE) {
-				f1518caf_md5Stream(md5State, buffer, numBytes);
-			} else {
-				if (md5Params.salt == NULL) {
-					f1518caf_md5(md5State, buffer, numBytes);
-				} else {
-					f1518caf_md5WithSalt(md5State, (uint8_t*)md5Params.salt, md5Params.saltLength, buffer, numBytes);
-				}
-			}
+		for (uint32_t i = 0; i < passwordList.length; i++) {
+			digestAlgorithm->print(passwordList.digests + (i * digestAlgorithm->digestLength));
+			putchar('\n');
+		}
+
+		fflush(stdout);
 
-			numBytes = e2f74138_readFile(STDIN_FILENO, buffer, MEMORY_PAGE_SIZE, "STDIN");
+		if (reportStats) {
+			printStats(&startTime, "batch");
 		}
 
-	} else {
-		AIOContext aioContext;
-		AIOFile aioFile;
-		FileBufferList fileBufferList;
-		FileBuffer *fileBuffer;
-		int64_t dataLength;
+		exit(EXIT_SUCCESS);
+	}
+
+	if (md5Params.numFiles == 0 && md5Params.manifestName == NULL) {
+		DigestState digestState;
+		uint8_t digest[MAX_DIGEST_LENGTH];
+
+		numBlake3Threads = md5Params.numThreads;
+		hashStdin(&md5Params, &digestState, digest);
 
-		// Initialize the AIOContext and AIOFile
-		f1207515_initAIOContext(&aioContext, 16);
-		f1207515_initAIOFile(&aioContext, &aioFile, md5Params.fileName);
+		// Print the digest
+		digestAlgorithm->print(digest);
+		printf("  -\n");
+		fflush(stdout);
 
-		// Initialize the FileBufferList struct
-		ce97d170_initFileBufferList(&fileBufferList);
+		if (reportStats) {
+			printStats(&startTime, "stdin");
+		}
 
-		// Open the file
-		f1207515_open(&aioFile, FOPEN_READONLY, 0);
-		dataLength = aioFile.fileSize;
+		// Exit with success
+		exit(EXIT_SUCCESS);
+	}
 
-		while (dataLength != 0) {
-			ce97d170_readFileBufferList(&aioFile, &fileBufferList, dataLength);
-			fileBuffer = fileBufferList.values[0];
+	if (md5Params.isDiff) {
+		isSuccess = diffChunkLists();
 
-			while (fileBuffer != NULL) {
-				dataLength -= fileBuffer->numBytes;
+		if (reportStats) {
+			printStats(&startTime, "tree");
+		}
 
-				if (dataLength == 0) {
-					f1518caf_md5StreamEnd(md5State, fileBuffer->buffer, fileBuffer->numBytes, aioFile.fileSize);
-				} else {
-					f1518caf_md5Stream(md5State, fileBuffer->buffer, fileBuffer->numBytes);
-				}
+		exit(isSuccess ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
 
-				fileBuffer = fileBuffer->next;
+	// Expand directories into the regular files below them
+	hashFileList.values = f668c4bd_malloc(HASH_FILE_LIST_INITIAL_SIZE * sizeof(HashFile));
+	hashFileList.length = 0;
+	hashFileList.size = HASH_FILE_LIST_INITIAL_SIZE;
 
-				if (fileBuffer == NULL)  {
-					ce97d170_resetFileBufferList(&fileBufferList, f502a409_releasePage);
-				}
-			}
+	if (md5Params.manifestName != NULL) {
+		isSuccess &= readManifest(md5Params.manifestName);
+	} else {
+		for (uint32_t i = 0; i < md5Params.numFiles; i++) {
+			isSuccess &= collectFiles(md5Params.fileNames[i]);
 		}
 
-//		f1207515_printContext(&aioContext);
+		qsort(hashFileList.values, hashFileList.length, sizeof(HashFile), compareHashFiles);
+	}
 
-		f1207515_cleanUpAIOFile(&aioFile);
-		f1207515_cleanUpAIOContext(&aioContext);
-		ce97d170_cleanUpFileBufferList(&fileBufferList, f502a409_releasePage);
-		b86b2c8d_destroyMemoryPool(false);
-		f502a409_destroyPagePool(false);
-		b426145b_destroySlabPool(false);
+	// A salted digest depends on more than the file, so it is never cached
+	if (md5Params.isCached && md5Params.salt == NULL) {
+		openHashCache();
 	}
 
-	// Print the MD5 digest
-	f1518caf_printMD5(md5State);
-	printf("  %s\n", (md5Params.fileName == NULL) ? "-" : md5Params.fileName);
+	if (md5Params.chunkSize != 0) {
+		hashTreeFiles(md5Params.numThreads);
+	} else {
+		hashFiles(md5Params.numThreads);
+	}
+
+	b86b2c8d_destroyMemoryPool(false);
+	f502a409_destroyPagePool(false);
+	b426145b_destroySlabPool(false);
+
+	isSuccess &= (md5Params.manifestName != NULL) ? printVerifyResults() : printFileDigests();
+
+	if (reportStats) {
+		printStats(&startTime, (md5Params.chunkSize != 0) ? "tree" : ioModeNames[ioMode]);
+	}
 
-	// Exit with success
-	exit(EXIT_SUCCESS);
+	exit(isSuccess ? EXIT_SUCCESS : EXIT_FAILURE);
 }
 
 // ═════════════════════════ Function Implementations ═════════════════════════
@@ -166,22 +847,142 @@ int main(int argc, char *argv[]) {
 /* ¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯
  * Possible command-line options:
  *
- *   -n -> Number of Rounds
- *   -s -> Salt
- *   -h -> Help
+ *   -a      -> Digest algorithm
+ *   -c      -> Verify the files listed in a manifest
+ *   -j      -> Number of threads
+ *   -n      -> Number of Rounds
+ *   -s      -> Salt
+ *   --batch -> Hash each line of STDIN as a password
+ *   --bench -> Measure the kernels and --io modes up to the given message size
+ *   --cache -> Keep the digests of unchanged files between runs
+ *   --chunks -> Write the --tree chunk digests to a file
+ *   --diff  -> Print the regions where two images or chunk lists differ
+ *   --fail-fast -> Stop -c at the first file that fails
+ *   --io    -> How large files are read (aio, mmap or direct)
+ *   --json  -> Print the --bench results as JSON
+ *   --stats -> Print the throughput to STDERR
+ *   --tee   -> Copy STDIN to a file while hashing it
+ *   --tree  -> Hash files as chunks of the given size in parallel
+ *   -h      -> Help
+ *
+ * Any other arguments are files or directories, which are hashed recursively
  * ----------------------------------------------------------------------------
  */
+// Parses a number of bytes with an optional K, M or G suffix; zero if invalid
+static uint64_t parseByteSize(char *value) {
+	char *end;
+	uint64_t size = strtoull(value, &end, 10);
+
+	if (*end == 'K') {
+		size <<= 10;
+		end++;
+	} else if (*end == 'M') {
+		size <<= 20;
+		end++;
+	} else if (*end == 'G') {
+		size <<= 30;
+		end++;
+	}
+
+	return (end != value && *end == '\0') ? size : 0;
+}
+
 static void processCmdLine(CmdLineParam *cmdLineParam, MD5Params *md5Params) {
 	register int argc = cmdLineParam->argc;
 	register char **argv = cmdLineParam->argv;
 
 	// Perform initializations
 	f668c4bd_meminit(md5Params, sizeof(MD5Params));
+	md5Params->fileNames = f668c4bd_malloc(argc * sizeof(char*));
+	md5Params->numRounds = 1;
+	md5Params->numThreads = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (md5Params->numThreads == 0 || md5Params->numThreads > MAX_NUM_THREADS) {
+		md5Params->numThreads = (md5Params->numThreads == 0) ? 1 : MAX_NUM_THREADS;
+	}
 
 	for (int i = 1; i < argc; i++) {
 		if (argv[i][0] == '-') {
-			if (argv[i][1] == 'n') {
+			if (strncmp(argv[i], "--tree", 6) == 0 && (argv[i][6] == '\0' || argv[i][6] == '=')) {
+				char *size = (argv[i][6] == '=') ? &argv[i][7] : d7ad7024_getString(cmdLineParam, "chunk size", i++);
+
+				if ((md5Params->chunkSize = parseByteSize(size)) < TREE_MIN_CHUNK_SIZE) {
+					c7c88e52_invalidValue("chunk size", size);
+					c7c88e52_printUsage(USAGE_MSG);
+					exit(EXIT_FAILURE);
+				}
+			} else if (strncmp(argv[i], "--io", 4) == 0 && (argv[i][4] == '\0' || argv[i][4] == '=')) {
+				char *mode = (argv[i][4] == '=') ? &argv[i][5] : d7ad7024_getString(cmdLineParam, "I/O mode", i++);
+
+				if (f6215943_isEqual(mode, "aio")) {
+					ioMode = IO_AIO;
+				} else if (f6215943_isEqual(mode, "mmap")) {
+					ioMode = IO_MMAP;
+				} else if (f6215943_isEqual(mode, "direct")) {
+					ioMode = IO_DIRECT;
+				} else {
+					c7c88e52_invalidValue("I/O mode", mode);
+					c7c88e52_printUsage(USAGE_MSG);
+					exit(EXIT_FAILURE);
+				}
+			} else if (strncmp(argv[i], "--bench", 7) == 0 && (argv[i][7] == '\0' || argv[i][7] == '=')) {
+				benchParams.maxSize = (argv[i][7] == '=') ? parseByteSize(&argv[i][8]) : (1UL << 30);
+
+				if (benchParams.maxSize < 64) {
+					c7c88e52_invalidValue("benchmark size", &argv[i][8]);
+					c7c88e52_printUsage(USAGE_MSG);
+					exit(EXIT_FAILURE);
+				}
+			} else if (f6215943_isEqual(argv[i], "--json")) {
+				benchParams.isJson = true;
+			} else if (f6215943_isEqual(argv[i], "--fail-fast")) {
+				md5Params->isFailFast = true;
+			} else if (f6215943_isEqual(argv[i], "--batch")) {
+				md5Params->isBatch = true;
+			} else if (f6215943_isEqual(argv[i], "--cache")) {
+				md5Params->isCached = true;
+			} else if (f6215943_isEqual(argv[i], "--chunks")) {
+				md5Params->chunkListName = d7ad7024_getString(cmdLineParam, "chunk list", i++);
+			} else if (f6215943_isEqual(argv[i], "--diff")) {
+				md5Params->isDiff = true;
+			} else if (f6215943_isEqual(argv[i], "--stats")) {
+				reportStats = true;
+			} else if (f6215943_isEqual(argv[i], "--tee")) {
+				md5Params->teeFileName = d7ad7024_getString(cmdLineParam, "tee file", i++);
+			} else if (argv[i][1] == 'a') {
+				char *name = d7ad7024_getString(cmdLineParam, "digest algorithm", i++);
+
+				digestAlgorithm = NULL;
+
+				for (uint32_t j = 0; j < NUM_DIGEST_ALGORITHMS; j++) {
+					if (f6215943_isEqual(name, digestAlgorithms[j].name)) {
+						digestAlgorithm = &digestAlgorithms[j];
+					}
+				}
+
+				if (digestAlgorithm == NULL) {
+					c7c88e52_invalidValue("digest algorithm", name);
+					c7c88e52_printUsage(USAGE_MSG);
+					exit(EXIT_FAILURE);
+				}
+			} else if (argv[i][1] == 'c') {
+				md5Params->manifestName = d7ad7024_getString(cmdLineParam, "manifest", i++);
+			} else if (argv[i][1] == 'j') {
+				md5Params->numThreads = d7ad7024_getUint32(cmdLineParam, "number of threads", i++);
+
+				if (md5Params->numThreads == 0 || md5Params->numThreads > MAX_NUM_THREADS) {
+					c7c88e52_invalidValue("number of threads", argv[i]);
+					c7c88e52_printUsage(USAGE_MSG);
+					exit(EXIT_FAILURE);
+				}
+			} else if (argv[i][1] == 'n') {
 				md5Params->numRounds = d7ad7024_getUint32(cmdLineParam, "number of rounds", i++);
+
+				if (md5Params->numRounds == 0) {
+					c7c88e52_invalidValue("number of rounds", argv[i]);
+					c7c88e52_printUsage(USAGE_MSG);
+					exit(EXIT_FAILURE);
+				}
 			} else if (argv[i][1] == 's') {
 				md5Params->salt = d7ad7024_getString(cmdLineParam, "salt", i++);
 				md5Params->saltLength = f6215943_getLength(md5Params->salt);
@@ -194,7 +995,94 @@ static void processCmdLine(CmdLineParam *cmdLineParam, MD5Params *md5Params) {
 				exit(EXIT_FAILURE);
 			}
 		} else {
-			md5Params->fileName = argv[i];
+			md5Params->fileNames[md5Params->numFiles++] = argv[i];
+		}
+	}
+
+	if (md5Params->teeFileName != NULL && md5Params->numFiles > 0) {
+		c7c88e52_printError_string("--tee only applies to STDIN\n\n");
+		c7c88e52_printUsage(USAGE_MSG);
+		exit(EXIT_FAILURE);
+	}
+
+	if (md5Params->manifestName != NULL && (md5Params->numFiles > 0 || md5Params->teeFileName != NULL || md5Params->isBatch)) {
+		c7c88e52_printError_string("-c takes the files from the manifest and cannot be combined with --tee or --batch\n\n");
+		c7c88e52_printUsage(USAGE_MSG);
+		exit(EXIT_FAILURE);
+	}
+
+	if (md5Params->isFailFast && md5Params->manifestName == NULL) {
+		c7c88e52_printError_string("--fail-fast only applies to -c\n\n");
+		c7c88e52_printUsage(USAGE_MSG);
+		exit(EXIT_FAILURE);
+	}
+
+	if (md5Params->isBatch && (md5Params->numFiles > 0 || md5Params->teeFileName != NULL)) {
+		c7c88e52_printError_string("--batch only applies to STDIN and cannot be combined with --tee\n\n");
+		c7c88e52_printUsage(USAGE_MSG);
+		exit(EXIT_FAILURE);
+	}
+
+	if (md5Params->isCached && ((md5Params->numFiles == 0 && md5Params->manifestName == NULL) || md5Params->chunkSize != 0)) {
+		c7c88e52_printError_string("--cache only applies to files and cannot be combined with --tree\n\n");
+		c7c88e52_printUsage(USAGE_MSG);
+		exit(EXIT_FAILURE);
+	}
+
+	if (md5Params->chunkSize != 0 && (md5Params->numFiles == 0 || md5Params->manifestName != NULL)) {
+		c7c88e52_printError_string("--tree only applies to files and cannot be combined with -c\n\n");
+		c7c88e52_printUsage(USAGE_MSG);
+		exit(EXIT_FAILURE);
+	}
+
+	if (md5Params->chunkListName != NULL && (md5Params->chunkSize == 0 || md5Params->numFiles != 1 || md5Params->isDiff)) {
+		c7c88e52_printError_string("--chunks needs --tree and exactly one file\n\n");
+		c7c88e52_printUsage(USAGE_MSG);
+		exit(EXIT_FAILURE);
+	}
+
+	// A directory would write the chunk list of each of its files over the last
+	if (md5Params->chunkListName != NULL) {
+		FileStatus fileStatus;
+
+		if (stat(md5Params->fileNames[0], &fileStatus) != 0) {
+			printFileError(md5Params->fileNames[0], errno);
+			exit(EXIT_FAILURE);
+		}
+
+		if (!S_ISREG(fileStatus.st_mode)) {
+			c7c88e52_printError_string("--chunks needs a regular file\n\n");
+			c7c88e52_printUsage(USAGE_MSG);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if (benchParams.maxSize != 0) {
+		if (md5Params->numFiles > 1 || md5Params->manifestName != NULL || md5Params->teeFileName != NULL || md5Params->isBatch
+		        || md5Params->isDiff || md5Params->chunkSize != 0 || md5Params->isCached) {
+			c7c88e52_printError_string("--bench takes at most one directory for its test file and no other mode\n\n");
+			c7c88e52_printUsage(USAGE_MSG);
+			exit(EXIT_FAILURE);
+		}
+
+		if (md5Params->numFiles == 1) {
+			benchParams.dirName = md5Params->fileNames[0];
+		}
+	} else if (benchParams.isJson) {
+		c7c88e52_printError_string("--json only applies to --bench\n\n");
+		c7c88e52_printUsage(USAGE_MSG);
+		exit(EXIT_FAILURE);
+	}
+
+	if (md5Params->isDiff) {
+		if (md5Params->numFiles != 2 || md5Params->isCached) {
+			c7c88e52_printError_string("--diff compares exactly two images or chunk lists\n\n");
+			c7c88e52_printUsage(USAGE_MSG);
+			exit(EXIT_FAILURE);
+		}
+
+		if (md5Params->chunkSize == 0) {
+			md5Params->chunkSize = TREE_DEFAULT_CHUNK_SIZE;
 		}
 	}
 }
@@ -202,14 +1090,3497 @@ static void processCmdLine(CmdLineParam *cmdLineParam, MD5Params *md5Params) {
 static void printHelp() {
 	c7c88e52_printUsage(USAGE_MSG);
 
-	puts("\nCalculates the MD5 hash of either a file or STDIN");
+	puts("\nCalculates the MD5, SHA-1, SHA-256, XXH3 or BLAKE3 hash of either files or STDIN");
+	puts("Directories are hashed recursively and the output is sorted by file name in md5sum format");
 
 	puts(ANSI_BOLD "\nExamples:" ANSI_RESET);
 	puts("  md5hash -n 1234 foo.txt");
+	puts("  md5hash -j 8 usr etc");
+	puts("  md5hash --cache -a sha256 /var/backups");
+	puts("  md5hash -a sha256 ubuntu.iso");
+	puts("  md5hash -c DEBIAN/md5sums --fail-fast");
+	puts("  md5hash --io=direct --stats disk.img");
+	puts("  md5hash --tree 64M --chunks disk.chunks disk.img");
+	puts("  md5hash --diff disk.chunks disk.img");
+	puts("  md5hash --bench=256M --json /srv/data");
 	puts("  echo mypassword | md5hash -s abcdefghijklmnop");
+	puts("  md5hash --batch -n 10000 -s abcdefghijklmnop < passwords.txt");
+	puts("  tar c usr | md5hash --tee usr.tar");
 
 	puts(ANSI_BOLD "\nValid Options:\n");
-	puts(ANSI_YELLOW "  -n\t" ANSI_ROMANTIC "Number of MD5 Rounds");
-	puts(ANSI_BOLD ANSI_YELLOW "  -s\t" ANSI_ROMANTIC "Salt");
+	puts(ANSI_YELLOW "  -a\t" ANSI_ROMANTIC "Digest algorithm: md5 (default), sha1, sha256, xxh3 or blake3");
+	puts(ANSI_BOLD ANSI_YELLOW "  -c\t" ANSI_ROMANTIC "Verify the files listed in an md5sum-style manifest");
+	puts(ANSI_BOLD ANSI_YELLOW "  -j\t" ANSI_ROMANTIC "Number of threads hashing files in parallel (default: number of CPUs)");
+	puts(ANSI_BOLD ANSI_YELLOW "  -n\t" ANSI_ROMANTIC "Number of rounds; each round after the first hashes the previous digest and the salt");
+	puts(ANSI_BOLD ANSI_YELLOW "  -s\t" ANSI_ROMANTIC "Salt appended to the input of every round");
+	puts(ANSI_BOLD ANSI_YELLOW "  --batch\t" ANSI_ROMANTIC "Hash each line of STDIN separately and print one digest per line");
+	puts(ANSI_BOLD ANSI_YELLOW "  --bench\t" ANSI_ROMANTIC "Report GB/s, cycles/byte and syscalls/GB of every kernel and --io mode from 64 B up to size (default: 1G)");
+	puts(ANSI_BOLD ANSI_YELLOW "  --cache\t" ANSI_ROMANTIC "Skip unchanged files hashed before (~/.cache/devopsbroker/hashcache); not used with -s");
+	puts(ANSI_BOLD ANSI_YELLOW "  --chunks\t" ANSI_ROMANTIC "Write the chunk digests of a --tree file to a chunk list");
+	puts(ANSI_BOLD ANSI_YELLOW "  --diff\t" ANSI_ROMANTIC "Print the offset and length of each region where two images or chunk lists differ");
+	puts(ANSI_BOLD ANSI_YELLOW "  --fail-fast\t" ANSI_ROMANTIC "Stop -c at the first file that is missing or does not match");
+	puts(ANSI_BOLD ANSI_YELLOW "  --io\t" ANSI_ROMANTIC "Read files over 32 KiB with aio (default), mmap or direct (O_DIRECT)");
+	puts(ANSI_BOLD ANSI_YELLOW "  --json\t" ANSI_ROMANTIC "Print the --bench results as JSON");
+	puts(ANSI_BOLD ANSI_YELLOW "  --stats\t" ANSI_ROMANTIC "Print the I/O mode and throughput to STDERR");
+	puts(ANSI_BOLD ANSI_YELLOW "  --tee\t" ANSI_ROMANTIC "Write STDIN to a file while hashing it");
+	puts(ANSI_BOLD ANSI_YELLOW "  --tree\t" ANSI_ROMANTIC "Hash chunks of this size (K, M or G) on all threads; the digest is of the chunk digests");
 	puts(ANSI_BOLD ANSI_YELLOW "  -h\t" ANSI_ROMANTIC "Print this help message\n");
 }
+
+// Fills one buffer completely unless STDIN ends first
+static uint32_t readStdinBuffer(uint8_t *buffer) {
+	uint32_t length = 0;
+	ssize_t numBytes;
+
+	do {
+		numBytes = e2f74138_readFile(STDIN_FILENO, buffer + length, STDIN_BUFFER_SIZE - length, "STDIN");
+		length += numBytes;
+	} while (numBytes != END_OF_FILE && length < STDIN_BUFFER_SIZE);
+
+	return length;
+}
+
+static void teeError(StdinReader *stdinReader) {
+	c7c88e52_printLibError(stdinReader->teeFileName, errno);
+	exit(EXIT_FAILURE);
+}
+
+/*
+ * Forwards a buffer to the --tee file. The buffer pages are spliced into a
+ * pipe and from there into the file, so the data is never copied through
+ * userspace again. Files that cannot be spliced into are written to instead.
+ */
+static void teeStdinBuffer(StdinReader *stdinReader, uint8_t *buffer, uint32_t length) {
+	struct iovec iovec;
+	ssize_t numBytes, numMoved;
+
+	while (length > 0) {
+		if (stdinReader->teePipe[0] < 0) {
+			numBytes = write(stdinReader->teeFd, buffer, length);
+		} else {
+			iovec.iov_base = buffer;
+			iovec.iov_len = length;
+			numBytes = vmsplice(stdinReader->teePipe[1], &iovec, 1, 0);
+
+			// The pipe must be empty again before the buffer can be reused
+			for (ssize_t i = 0; i < numBytes; i += numMoved) {
+				numMoved = splice(stdinReader->teePipe[0], NULL, stdinReader->teeFd, NULL, numBytes - i, SPLICE_F_MOVE);
+
+				if (numMoved < 0) {
+					if (errno != EINTR) {
+						teeError(stdinReader);
+					}
+
+					numMoved = 0;
+				}
+			}
+		}
+
+		if (numBytes < 0) {
+			if (errno != EINTR) {
+				teeError(stdinReader);
+			}
+
+			continue;
+		}
+
+		buffer += numBytes;
+		length -= numBytes;
+	}
+}
+
+// Read stage: fills free buffers in order until the end of STDIN
+static void *runStdinReader(void *stdinReaderPtr) {
+	StdinReader *stdinReader = stdinReaderPtr;
+	uint32_t bufferNum = 0;
+	uint32_t numBytes;
+
+	do {
+		// 1. Wait for the hashing thread to hand back a buffer
+		pthread_mutex_lock(&stdinReader->mutex);
+
+		while (stdinReader->numFull == STDIN_NUM_BUFFERS) {
+			pthread_cond_wait(&stdinReader->isNotFull, &stdinReader->mutex);
+		}
+
+		pthread_mutex_unlock(&stdinReader->mutex);
+
+		// 2. Read into the buffer without holding the lock
+		numBytes = readStdinBuffer(stdinReader->buffers[bufferNum]);
+
+		if (stdinReader->teeFd >= 0) {
+			teeStdinBuffer(stdinReader, stdinReader->buffers[bufferNum], numBytes);
+		}
+
+		// 3. Pass the buffer on to the hashing thread
+		pthread_mutex_lock(&stdinReader->mutex);
+
+		stdinReader->lengths[bufferNum] = numBytes;
+		stdinReader->numFull++;
+		pthread_cond_signal(&stdinReader->isNotEmpty);
+
+		pthread_mutex_unlock(&stdinReader->mutex);
+
+		bufferNum = (bufferNum + 1) % STDIN_NUM_BUFFERS;
+	} while (numBytes == STDIN_BUFFER_SIZE);
+
+	return NULL;
+}
+
+static void openTeeFile(StdinReader *stdinReader, char *teeFileName) {
+	FileStatus fileStatus;
+
+	stdinReader->teeFileName = teeFileName;
+	stdinReader->teePipe[0] = -1;
+	stdinReader->teePipe[1] = -1;
+
+	if (teeFileName == NULL) {
+		stdinReader->teeFd = -1;
+		return;
+	}
+
+	stdinReader->teeFd = open(teeFileName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+	if (stdinReader->teeFd < 0) {
+		c7c88e52_printLibError(teeFileName, errno);
+		exit(EXIT_FAILURE);
+	}
+
+	// Only regular files and pipes reliably accept splice()
+	fstat(stdinReader->teeFd, &fileStatus);
+
+	if ((S_ISREG(fileStatus.st_mode) || S_ISFIFO(fileStatus.st_mode)) && pipe(stdinReader->teePipe) == 0) {
+		fcntl(stdinReader->teePipe[1], F_SETPIPE_SZ, STDIN_PIPE_SIZE);
+	}
+}
+
+/*
+ * Hashes STDIN while a separate thread reads ahead into a ring of large
+ * buffers, so a pipe costs one read() per buffer filled by the producer
+ * rather than one per page.
+ */
+static void hashStdin(MD5Params *md5Params, DigestState *digestState, uint8_t *digest) {
+	StdinReader stdinReader;
+	pthread_t thread;
+	uint32_t bufferNum = 0;
+	uint32_t numBytes;
+	uint64_t totalLength = 0;
+	uint8_t *buffer;
+
+	openTeeFile(&stdinReader, md5Params->teeFileName);
+
+	// Let the producer write more per wakeup when STDIN is a pipe
+	fcntl(STDIN_FILENO, F_SETPIPE_SZ, STDIN_PIPE_SIZE);
+
+	stdinReader.numFull = 0;
+	pthread_mutex_init(&stdinReader.mutex, NULL);
+	pthread_cond_init(&stdinReader.isNotEmpty, NULL);
+	pthread_cond_init(&stdinReader.isNotFull, NULL);
+
+	for (uint32_t i = 0; i < STDIN_NUM_BUFFERS; i++) {
+		stdinReader.buffers[i] = aligned_alloc(MEMORY_PAGE_SIZE, STDIN_BUFFER_SIZE);
+	}
+
+	if (pthread_create(&thread, NULL, runStdinReader, &stdinReader) != 0) {
+		c7c88e52_printLibError("Cannot create STDIN reader thread", errno);
+		exit(EXIT_FAILURE);
+	}
+
+	digestAlgorithm->init(digestState);
+
+	do {
+		pthread_mutex_lock(&stdinReader.mutex);
+
+		while (stdinReader.numFull == 0) {
+			pthread_cond_wait(&stdinReader.isNotEmpty, &stdinReader.mutex);
+		}
+
+		numBytes = stdinReader.lengths[bufferNum];
+		pthread_mutex_unlock(&stdinReader.mutex);
+
+		buffer = stdinReader.buffers[bufferNum];
+		totalLength += numBytes;
+
+		if (numBytes == STDIN_BUFFER_SIZE) {
+			digestAlgorithm->stream(digestState, buffer, numBytes);
+		} else {
+			finishDigest(digestState, buffer, numBytes, totalLength, digest);
+		}
+
+		pthread_mutex_lock(&stdinReader.mutex);
+
+		stdinReader.numFull--;
+		pthread_cond_signal(&stdinReader.isNotFull);
+
+		pthread_mutex_unlock(&stdinReader.mutex);
+
+		bufferNum = (bufferNum + 1) % STDIN_NUM_BUFFERS;
+	} while (numBytes == STDIN_BUFFER_SIZE);
+
+	pthread_join(thread, NULL);
+
+	if (stdinReader.teeFd >= 0 && close(stdinReader.teeFd) != 0) {
+		teeError(&stdinReader);
+	}
+
+	atomic_store(&totalBytes, totalLength);
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ HashFileList ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+static void addHashFile(char *fileName) {
+	HashFile *hashFile;
+
+	if (hashFileList.length == hashFileList.size) {
+		hashFileList.size <<= 1;
+		hashFileList.values = f668c4bd_realloc(hashFileList.values, hashFileList.size * sizeof(HashFile));
+	}
+
+	hashFile = &hashFileList.values[hashFileList.length++];
+	hashFile->fileName = fileName;
+	hashFile->expectedDigest = NULL;
+	hashFile->errorNumber = 0;
+	hashFile->isChecked = false;
+}
+
+static void printFileError(char *fileName, int errorNumber) {
+	fflush(stdout);
+	fprintf(stderr, "%s: %s: %s\n", programName, fileName, strerror(errorNumber));
+}
+
+/*
+ * Adds the regular files below a directory the same way find(1) walks it:
+ * symbolic links to regular files are hashed, symbolic links to directories
+ * are not followed.
+ */
+static bool collectDirectory(char *dirName) {
+	DIR *dir = opendir(dirName);
+	struct dirent *entry;
+	FileStatus fileStatus;
+	size_t dirLength;
+	char *fileName;
+	bool isSuccess = true;
+
+	if (dir == NULL) {
+		printFileError(dirName, errno);
+		return false;
+	}
+
+	dirLength = f6215943_getLength(dirName);
+
+	// Do not double the slash of a directory name like "/" or "usr/"
+	if (dirLength > 0 && dirName[dirLength - 1] == '/') {
+		dirLength--;
+	}
+
+	while ((entry = readdir(dir)) != NULL) {
+		if (entry->d_name[0] == '.' && (entry->d_name[1] == '\0' || (entry->d_name[1] == '.' && entry->d_name[2] == '\0'))) {
+			continue;
+		}
+
+		fileName = f668c4bd_malloc(dirLength + f6215943_getLength(entry->d_name) + 2);
+		memcpy(fileName, dirName, dirLength);
+		fileName[dirLength] = '/';
+		strcpy(fileName + dirLength + 1, entry->d_name);
+
+		if (entry->d_type == DT_REG) {
+			addHashFile(fileName);
+		} else if (entry->d_type == DT_DIR) {
+			isSuccess &= collectDirectory(fileName);
+			f668c4bd_free(fileName);
+		} else if (entry->d_type == DT_LNK || entry->d_type == DT_UNKNOWN) {
+			if (stat(fileName, &fileStatus) != 0) {
+				printFileError(fileName, errno);
+				f668c4bd_free(fileName);
+				isSuccess = false;
+			} else if (S_ISREG(fileStatus.st_mode)) {
+				addHashFile(fileName);
+			} else if (S_ISDIR(fileStatus.st_mode) && entry->d_type == DT_UNKNOWN && lstat(fileName, &fileStatus) == 0 && S_ISDIR(fileStatus.st_mode)) {
+				isSuccess &= collectDirectory(fileName);
+				f668c4bd_free(fileName);
+			} else {
+				f668c4bd_free(fileName);
+			}
+		} else {
+			f668c4bd_free(fileName);
+		}
+	}
+
+	closedir(dir);
+
+	return isSuccess;
+}
+
+// Adds a command-line file, or the regular files below a directory
+static bool collectFiles(char *fileName) {
+	FileStatus fileStatus;
+
+	if (stat(fileName, &fileStatus) != 0) {
+		printFileError(fileName, errno);
+		return false;
+	}
+
+	if (S_ISDIR(fileStatus.st_mode)) {
+		return collectDirectory(fileName);
+	}
+
+	addHashFile(fileName);
+
+	return true;
+}
+
+static int compareHashFiles(const void *a, const void *b) {
+	return strcmp(((const HashFile*) a)->fileName, ((const HashFile*) b)->fileName);
+}
+
+/*
+ * Prints the digests in md5sum(1) format. Like md5sum, a file name holding a
+ * backslash or newline is escaped and its line starts with a backslash.
+ */
+static bool printFileDigests() {
+	HashFile *hashFile;
+	bool isSuccess = true;
+
+	for (uint32_t i = 0; i < hashFileList.length; i++) {
+		hashFile = &hashFileList.values[i];
+
+		if (hashFile->errorNumber != 0) {
+			printFileError(hashFile->fileName, hashFile->errorNumber);
+			isSuccess = false;
+			continue;
+		}
+
+		if (strpbrk(hashFile->fileName, "\\\n") == NULL) {
+			digestAlgorithm->print(hashFile->digest);
+			printf("  %s\n", hashFile->fileName);
+			continue;
+		}
+
+		putchar('\\');
+		digestAlgorithm->print(hashFile->digest);
+		fputs("  ", stdout);
+		printFileName(hashFile->fileName);
+		putchar('\n');
+	}
+
+	fflush(stdout);
+
+	return isSuccess;
+}
+
+// Prints a file name with backslashes and newlines escaped the way md5sum does
+static void printFileName(char *fileName) {
+	for (char *position = fileName; *position != '\0'; position++) {
+		if (*position == '\\') {
+			fputs("\\\\", stdout);
+		} else if (*position == '\n') {
+			fputs("\\n", stdout);
+		} else {
+			putchar(*position);
+		}
+	}
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ HashWorker ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+static inline uint64_t packRange(uint32_t head, uint32_t tail) {
+	return ((uint64_t) tail << 32) | head;
+}
+
+/*
+ * Hashes the HashFileList on numThreads workers. Each worker starts with a
+ * contiguous slice, so neighbouring files tend to be read by the same thread,
+ * and steals from the others once its own slice runs out.
+ */
+static void hashFiles(uint32_t numThreads) {
+	HashWorker *hashWorkers;
+	uint32_t sliceStart, sliceEnd;
+
+	numWorkers = (numThreads < hashFileList.length) ? numThreads : hashFileList.length;
+
+	if (numWorkers == 0) {
+		return;
+	}
+
+	// Threads left over when there are fewer files than threads hash BLAKE3 subtrees
+	numBlake3Threads = numThreads / numWorkers;
+
+	workQueues = aligned_alloc(CACHE_LINE_SIZE, numWorkers * sizeof(WorkQueue));
+	hashWorkers = f668c4bd_malloc(numWorkers * sizeof(HashWorker));
+
+	for (uint32_t i = 0; i < numWorkers; i++) {
+		sliceStart = (uint32_t) (((uint64_t) hashFileList.length * i) / numWorkers);
+		sliceEnd = (uint32_t) (((uint64_t) hashFileList.length * (i + 1)) / numWorkers);
+		atomic_init(&workQueues[i].range, packRange(sliceStart, sliceEnd));
+	}
+
+	for (uint32_t i = 0; i < numWorkers; i++) {
+		hashWorkers[i].numBytes = 0;
+		hashWorkers[i].workerNum = i;
+
+		if (numWorkers > 1) {
+			int errorNumber = pthread_create(&hashWorkers[i].thread, NULL, runHashWorker, &hashWorkers[i]);
+
+			if (errorNumber != 0) {
+				c7c88e52_printLibError("Cannot create thread", errorNumber);
+				exit(EXIT_FAILURE);
+			}
+		}
+	}
+
+	if (numWorkers == 1) {
+		runHashWorker(&hashWorkers[0]);
+	} else {
+		for (uint32_t i = 0; i < numWorkers; i++) {
+			pthread_join(hashWorkers[i].thread, NULL);
+		}
+	}
+
+	f668c4bd_free(hashWorkers);
+	free(workQueues);
+}
+
+// Reads up to fileSize bytes, stopping there even if the file grew since it was stat'ed
+static int readSmallFile(int fd, uint8_t *buffer, uint32_t fileSize, uint32_t *length) {
+	ssize_t numBytes;
+
+	*length = 0;
+
+	while (*length < fileSize) {
+		numBytes = read(fd, buffer + *length, fileSize - *length);
+
+		if (numBytes == 0) {
+			break;
+		} else if (numBytes < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			return errno;
+		}
+
+		*length += numBytes;
+	}
+
+	return 0;
+}
+
+static void hashSmallFile(uint8_t *buffer, HashFile *hashFile, DigestState *digestState, int fd, uint32_t fileSize) {
+	uint32_t length;
+
+	if ((hashFile->errorNumber = readSmallFile(fd, buffer, fileSize, &length)) == 0) {
+		digestAlgorithm->init(digestState);
+		finishDigest(digestState, buffer, length, length, hashFile->digest);
+	}
+}
+
+static void hashLargeFile(AIOContext *aioContext, FileBufferList *fileBufferList, HashFile *hashFile, DigestState *digestState) {
+	AIOFile aioFile;
+	FileBuffer *fileBuffer;
+	int64_t dataLength;
+
+	digestAlgorithm->init(digestState);
+
+	f1207515_initAIOFile(aioContext, &aioFile, hashFile->fileName);
+	f1207515_open(&aioFile, FOPEN_READONLY, 0);
+	dataLength = aioFile.fileSize;
+
+	if (dataLength == 0) {
+		finishDigest(digestState, NULL, 0, 0, hashFile->digest);
+	}
+
+	while (dataLength != 0) {
+		ce97d170_readFileBufferList(&aioFile, fileBufferList, dataLength);
+		fileBuffer = fileBufferList->values[0];
+
+		while (fileBuffer != NULL) {
+			dataLength -= fileBuffer->numBytes;
+
+			if (dataLength == 0) {
+				finishDigest(digestState, fileBuffer->buffer, fileBuffer->numBytes, aioFile.fileSize, hashFile->digest);
+			} else {
+				digestAlgorithm->stream(digestState, fileBuffer->buffer, fileBuffer->numBytes);
+			}
+
+			fileBuffer = fileBuffer->next;
+
+			if (fileBuffer == NULL)  {
+				ce97d170_resetFileBufferList(fileBufferList, f502a409_releasePage);
+			}
+		}
+	}
+
+	f1207515_cleanUpAIOFile(&aioFile);
+}
+
+/*
+ * Each worker owns its AIOContext, FileBufferList, MD5Lanes and DigestState.
+ * Small files are read in one go, and with unsalted MD5 go to the MD5Lanes.
+ * Larger ones are streamed through the selected I/O mode.
+ */
+static void *runHashWorker(void *hashWorkerPtr) {
+	HashWorker *hashWorker = hashWorkerPtr;
+	WorkQueue *workQueue = &workQueues[hashWorker->workerNum];
+	AIOContext aioContext;
+	FileBufferList fileBufferList;
+	MD5Lanes md5Lanes;
+	DirectReader directReader;
+	DigestState digestState;
+	FileStatus fileStatus;
+	HashCacheKey cacheKey;
+	HashFile *hashFile;
+	uint32_t fileNum;
+	int fd;
+
+	f1207515_initAIOContext(&aioContext, 16);
+	ce97d170_initFileBufferList(&fileBufferList);
+	initMD5Lanes(&md5Lanes);
+
+	if (ioMode == IO_DIRECT) {
+		initDirectReader(&directReader);
+	}
+
+	do {
+		while (!atomic_load_explicit(&isStopped, memory_order_relaxed) && takeHashFile(workQueue, &fileNum)) {
+			hashFile = &hashFileList.values[fileNum];
+
+			// Report unreadable files instead of letting the AIO open exit
+			if ((fd = open(hashFile->fileName, O_RDONLY)) < 0) {
+				hashFile->errorNumber = errno;
+				checkHashFile(hashFile);
+				continue;
+			}
+
+			if (fstat(fd, &fileStatus) != 0) {
+				hashFile->errorNumber = errno;
+				checkHashFile(hashFile);
+				close(fd);
+				continue;
+			}
+
+			initCacheKey(&cacheKey, &fileStatus);
+
+			// Unchanged files are not read at all
+			if (hashCache.slots != NULL && lookupCachedDigest(&cacheKey, hashFile->digest)) {
+				close(fd);
+				checkHashFile(hashFile);
+				continue;
+			}
+
+			hashWorker->numBytes += fileStatus.st_size;
+
+			if (fileStatus.st_size <= SMALL_FILE_SIZE && digestAlgorithm == &digestAlgorithms[0] && md5Params.salt == NULL) {
+				runMD5Lanes(&md5Lanes, false);
+				loadMD5Lane(&md5Lanes, hashFile, &cacheKey, fd, fileStatus.st_size);
+				close(fd);
+
+				// Files in a lane are checked when their lane finishes
+				if (hashFile->errorNumber == 0) {
+					continue;
+				}
+			} else if (fileStatus.st_size <= SMALL_FILE_SIZE) {
+				hashSmallFile(md5Lanes.buffers[0], hashFile, &digestState, fd, fileStatus.st_size);
+				close(fd);
+			} else if (ioMode == IO_MMAP) {
+				hashMappedFile(hashFile, &digestState, fd, fileStatus.st_size);
+				close(fd);
+			} else {
+				close(fd);
+
+				// Filesystems without O_DIRECT support fall back to AIO
+				if (ioMode == IO_AIO || !hashDirectFile(&directReader, hashFile, &digestState, fileStatus.st_size)) {
+					hashLargeFile(&aioContext, &fileBufferList, hashFile, &digestState);
+				}
+			}
+
+			cacheHashFile(&cacheKey, hashFile);
+			checkHashFile(hashFile);
+		}
+	} while (!atomic_load_explicit(&isStopped, memory_order_relaxed) && stealHashFiles(hashWorker->workerNum));
+
+	runMD5Lanes(&md5Lanes, true);
+
+	if (ioMode == IO_DIRECT) {
+		cleanUpDirectReader(&directReader);
+	}
+
+	atomic_fetch_add(&totalBytes, hashWorker->numBytes);
+
+	cleanUpMD5Lanes(&md5Lanes);
+	ce97d170_cleanUpFileBufferList(&fileBufferList, f502a409_releasePage);
+	f1207515_cleanUpAIOContext(&aioContext);
+
+	return NULL;
+}
+
+// Takes the file at the head of the WorkQueue
+static bool takeHashFile(WorkQueue *workQueue, uint32_t *fileNum) {
+	uint64_t range = atomic_load(&workQueue->range);
+	uint32_t head, tail;
+
+	do {
+		head = (uint32_t) range;
+		tail = (uint32_t) (range >> 32);
+
+		if (head >= tail) {
+			return false;
+		}
+	} while (!atomic_compare_exchange_weak(&workQueue->range, &range, packRange(head + 1, tail)));
+
+	*fileNum = head;
+
+	return true;
+}
+
+/*
+ * Moves the back half of the first non-empty WorkQueue of another worker into
+ * the empty WorkQueue of this worker. Returns false once there is no work left
+ * to steal.
+ */
+static bool stealHashFiles(uint32_t workerNum) {
+	WorkQueue *victim;
+	uint64_t range;
+	uint32_t head, tail, numStolen;
+
+	for (uint32_t i = 1; i < numWorkers; i++) {
+		victim = &workQueues[(workerNum + i) % numWorkers];
+		range = atomic_load(&victim->range);
+
+		while (true) {
+			head = (uint32_t) range;
+			tail = (uint32_t) (range >> 32);
+
+			if (head >= tail) {
+				break;
+			}
+
+			numStolen = (tail - head + 1) >> 1;
+
+			if (atomic_compare_exchange_weak(&victim->range, &range, packRange(head, tail - numStolen))) {
+				atomic_store(&workQueues[workerNum].range, packRange(tail - numStolen, tail));
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ MD5Lanes ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+// Gathers word w of every lane's block into words[w]
+static inline __attribute__ ((always_inline))
+void transposeBlocks(uint32_t words[16][MAX_LANES], const uint8_t *blocks[MAX_LANES], uint32_t numLanes) {
+	for (uint32_t lane = 0; lane < numLanes; lane++) {
+		for (uint32_t w = 0; w < 16; w++) {
+			memcpy(&words[w][lane], blocks[lane] + (w << 2), sizeof(uint32_t));
+		}
+	}
+}
+
+// SSE2 is part of x86-64, so four lanes are always available
+static void md5TransformLanes4(uint32_t state[4][MAX_LANES], const uint8_t *blocks[MAX_LANES]) {
+	uint32_t words[16][MAX_LANES];
+	LaneVector4 M[16], a, b, c, d, aa, bb, cc, dd;
+
+	transposeBlocks(words, blocks, 4);
+
+	for (int w = 0; w < 16; w++) {
+		memcpy(&M[w], words[w], sizeof(LaneVector4));
+	}
+
+	memcpy(&a, state[0], sizeof(LaneVector4));
+	memcpy(&b, state[1], sizeof(LaneVector4));
+	memcpy(&c, state[2], sizeof(LaneVector4));
+	memcpy(&d, state[3], sizeof(LaneVector4));
+	aa = a; bb = b; cc = c; dd = d;
+
+	MD5_ROUNDS(M, a, b, c, d);
+
+	a += aa; b += bb; c += cc; d += dd;
+	memcpy(state[0], &a, sizeof(LaneVector4));
+	memcpy(state[1], &b, sizeof(LaneVector4));
+	memcpy(state[2], &c, sizeof(LaneVector4));
+	memcpy(state[3], &d, sizeof(LaneVector4));
+}
+
+__attribute__ ((target ("avx2")))
+static void md5TransformLanes8(uint32_t state[4][MAX_LANES], const uint8_t *blocks[MAX_LANES]) {
+	uint32_t words[16][MAX_LANES];
+	LaneVector8 M[16], a, b, c, d, aa, bb, cc, dd;
+
+	transposeBlocks(words, blocks, 8);
+
+	for (int w = 0; w < 16; w++) {
+		memcpy(&M[w], words[w], sizeof(LaneVector8));
+	}
+
+	memcpy(&a, state[0], sizeof(LaneVector8));
+	memcpy(&b, state[1], sizeof(LaneVector8));
+	memcpy(&c, state[2], sizeof(LaneVector8));
+	memcpy(&d, state[3], sizeof(LaneVector8));
+	aa = a; bb = b; cc = c; dd = d;
+
+	MD5_ROUNDS(M, a, b, c, d);
+
+	a += aa; b += bb; c += cc; d += dd;
+	memcpy(state[0], &a, sizeof(LaneVector8));
+	memcpy(state[1], &b, sizeof(LaneVector8));
+	memcpy(state[2], &c, sizeof(LaneVector8));
+	memcpy(state[3], &d, sizeof(LaneVector8));
+}
+
+__attribute__ ((target ("avx512f")))
+static void md5TransformLanes16(uint32_t state[4][MAX_LANES], const uint8_t *blocks[MAX_LANES]) {
+	uint32_t words[16][MAX_LANES];
+	LaneVector16 M[16], a, b, c, d, aa, bb, cc, dd;
+
+	transposeBlocks(words, blocks, 16);
+
+	for (int w = 0; w < 16; w++) {
+		memcpy(&M[w], words[w], sizeof(LaneVector16));
+	}
+
+	memcpy(&a, state[0], sizeof(LaneVector16));
+	memcpy(&b, state[1], sizeof(LaneVector16));
+	memcpy(&c, state[2], sizeof(LaneVector16));
+	memcpy(&d, state[3], sizeof(LaneVector16));
+	aa = a; bb = b; cc = c; dd = d;
+
+	MD5_ROUNDS(M, a, b, c, d);
+
+	a += aa; b += bb; c += cc; d += dd;
+	memcpy(state[0], &a, sizeof(LaneVector16));
+	memcpy(state[1], &b, sizeof(LaneVector16));
+	memcpy(state[2], &c, sizeof(LaneVector16));
+	memcpy(state[3], &d, sizeof(LaneVector16));
+}
+
+static void initMD5Lanes(MD5Lanes *md5Lanes) {
+	uint8_t *buffer = f668c4bd_malloc(numLanes * MD5_LANE_BUFFER_SIZE);
+
+	for (uint32_t lane = 0; lane < MAX_LANES; lane++) {
+		md5Lanes->blocks[lane] = zeroBlock;
+		md5Lanes->hashFiles[lane] = NULL;
+		md5Lanes->buffers[lane] = (lane < numLanes) ? buffer + (lane * MD5_LANE_BUFFER_SIZE) : NULL;
+		md5Lanes->numBlocks[lane] = 0;
+	}
+
+	md5Lanes->numLanes = numLanes;
+	md5Lanes->numActive = 0;
+}
+
+static void cleanUpMD5Lanes(MD5Lanes *md5Lanes) {
+	f668c4bd_free(md5Lanes->buffers[0]);
+}
+
+/*
+ * Reads a small file into a free lane and appends the MD5 padding, so the lane
+ * only has whole blocks left to hash. The caller must have freed a lane first.
+ */
+static void loadMD5Lane(MD5Lanes *md5Lanes, HashFile *hashFile, const HashCacheKey *cacheKey, int fd, uint32_t fileSize) {
+	uint32_t lane = 0;
+	uint8_t *buffer;
+	uint64_t numBits;
+	uint32_t length;
+
+	while (md5Lanes->hashFiles[lane] != NULL) {
+		lane++;
+	}
+
+	buffer = md5Lanes->buffers[lane];
+
+	if ((hashFile->errorNumber = readSmallFile(fd, buffer, fileSize, &length)) != 0) {
+		return;
+	}
+
+	numBits = ((uint64_t) length) << 3;
+	buffer[length++] = 0x80;
+
+	while ((length & 63) != 56) {
+		buffer[length++] = 0;
+	}
+
+	memcpy(buffer + length, &numBits, sizeof(uint64_t));
+	length += sizeof(uint64_t);
+
+	md5Lanes->state[0][lane] = 0x67452301;
+	md5Lanes->state[1][lane] = 0xefcdab89;
+	md5Lanes->state[2][lane] = 0x98badcfe;
+	md5Lanes->state[3][lane] = 0x10325476;
+
+	md5Lanes->blocks[lane] = buffer;
+	md5Lanes->hashFiles[lane] = hashFile;
+	md5Lanes->cacheKeys[lane] = *cacheKey;
+	md5Lanes->numBlocks[lane] = length >> 6;
+	md5Lanes->numActive++;
+}
+
+/*
+ * Hashes until the shortest file in the lanes is finished and stores its
+ * digest. Does nothing while a lane is still free unless isDraining is set,
+ * in which case every lane is run to completion.
+ */
+static void runMD5Lanes(MD5Lanes *md5Lanes, bool isDraining) {
+	const uint32_t numLanes = md5Lanes->numLanes;
+	uint32_t numBlocks;
+	HashFile *hashFile;
+
+	while (md5Lanes->numActive == numLanes || (isDraining && md5Lanes->numActive > 0)) {
+		numBlocks = UINT32_MAX;
+
+		for (uint32_t lane = 0; lane < numLanes; lane++) {
+			if (md5Lanes->hashFiles[lane] != NULL && md5Lanes->numBlocks[lane] < numBlocks) {
+				numBlocks = md5Lanes->numBlocks[lane];
+			}
+		}
+
+		for (uint32_t i = 0; i < numBlocks; i++) {
+			md5TransformLanes(md5Lanes->state, md5Lanes->blocks);
+
+			for (uint32_t lane = 0; lane < numLanes; lane++) {
+				if (md5Lanes->hashFiles[lane] != NULL) {
+					md5Lanes->blocks[lane] += 64;
+				}
+			}
+		}
+
+		for (uint32_t lane = 0; lane < numLanes; lane++) {
+			hashFile = md5Lanes->hashFiles[lane];
+
+			if (hashFile != NULL) {
+				md5Lanes->numBlocks[lane] -= numBlocks;
+
+				if (md5Lanes->numBlocks[lane] == 0) {
+					for (uint32_t i = 0; i < 4; i++) {
+						memcpy(hashFile->digest + (i * 4), &md5Lanes->state[i][lane], sizeof(uint32_t));
+					}
+
+					stretchDigest(hashFile->digest);
+					cacheHashFile(&md5Lanes->cacheKeys[lane], hashFile);
+					checkHashFile(hashFile);
+
+					md5Lanes->blocks[lane] = zeroBlock;
+					md5Lanes->hashFiles[lane] = NULL;
+					md5Lanes->numActive--;
+				}
+			}
+		}
+	}
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ --io=mmap ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/*
+ * Hashes the file through read-only mappings of MMAP_WINDOW_SIZE bytes. Each
+ * window is hashed front to back, so it is marked MADV_SEQUENTIAL, and the
+ * next window is read ahead while the current one is being hashed.
+ */
+static void hashMappedFile(HashFile *hashFile, DigestState *digestState, int fd, uint64_t fileSize) {
+	uint64_t offset = 0;
+	uint64_t length;
+	void *window;
+
+	digestAlgorithm->init(digestState);
+
+	while (true) {
+		length = fileSize - offset;
+
+		if (length > MMAP_WINDOW_SIZE) {
+			length = MMAP_WINDOW_SIZE;
+		}
+
+		window = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, offset);
+
+		if (window == MAP_FAILED) {
+			hashFile->errorNumber = errno;
+			return;
+		}
+
+		madvise(window, length, MADV_SEQUENTIAL);
+		madvise(window, length, MADV_HUGEPAGE);
+
+		if (offset + length == fileSize) {
+			finishDigest(digestState, window, length, fileSize, hashFile->digest);
+			munmap(window, length);
+			return;
+		}
+
+		posix_fadvise(fd, offset + length, MMAP_WINDOW_SIZE, POSIX_FADV_WILLNEED);
+		digestAlgorithm->stream(digestState, window, length);
+		munmap(window, length);
+
+		offset += length;
+	}
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ --io=direct ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+static void initDirectReader(DirectReader *directReader) {
+	directReader->aioContext = 0;
+
+	if (syscall(SYS_io_setup, 1, &directReader->aioContext) != 0) {
+		c7c88e52_printLibError("Cannot create kernel AIO context", errno);
+		exit(EXIT_FAILURE);
+	}
+
+	directReader->buffers[0] = aligned_alloc(DIRECT_ALIGNMENT, DIRECT_BUFFER_SIZE);
+	directReader->buffers[1] = aligned_alloc(DIRECT_ALIGNMENT, DIRECT_BUFFER_SIZE);
+}
+
+static void cleanUpDirectReader(DirectReader *directReader) {
+	syscall(SYS_io_destroy, directReader->aioContext);
+	free(directReader->buffers[0]);
+	free(directReader->buffers[1]);
+}
+
+static int submitDirectRead(DirectReader *directReader, int fd, uint8_t *buffer, uint64_t offset) {
+	struct iocb iocb;
+	struct iocb *iocbList[1] = { &iocb };
+
+	memset(&iocb, 0, sizeof(struct iocb));
+	iocb.aio_fildes = fd;
+	iocb.aio_lio_opcode = IOCB_CMD_PREAD;
+	iocb.aio_buf = (uint64_t) buffer;
+	iocb.aio_nbytes = DIRECT_BUFFER_SIZE;
+	iocb.aio_offset = offset;
+
+	return (syscall(SYS_io_submit, directReader->aioContext, 1, iocbList) == 1) ? 0 : errno;
+}
+
+// Returns the number of bytes read, or a negated errno
+static int64_t waitDirectRead(DirectReader *directReader) {
+	struct io_event ioEvent;
+
+	while (syscall(SYS_io_getevents, directReader->aioContext, 1, 1, &ioEvent, NULL) != 1) {
+		if (errno != EINTR) {
+			return -errno;
+		}
+	}
+
+	return ioEvent.res;
+}
+
+/*
+ * Hashes the file with O_DIRECT reads that bypass the page cache. The read of
+ * the next buffer is in flight while the current buffer is being hashed.
+ * Returns false if the filesystem does not support O_DIRECT.
+ */
+static bool hashDirectFile(DirectReader *directReader, HashFile *hashFile, DigestState *digestState, uint64_t fileSize) {
+	uint64_t offset = 0;
+	int64_t numBytes;
+	uint32_t current = 0;
+	int fd, errorNumber;
+
+	if ((fd = open(hashFile->fileName, O_RDONLY | O_DIRECT)) < 0) {
+		if (errno == EINVAL) {
+			return false;
+		}
+
+		hashFile->errorNumber = errno;
+		return true;
+	}
+
+	digestAlgorithm->init(digestState);
+
+	if ((errorNumber = submitDirectRead(directReader, fd, directReader->buffers[0], 0)) != 0) {
+		close(fd);
+
+		if (errorNumber == EINVAL) {
+			return false;
+		}
+
+		hashFile->errorNumber = errorNumber;
+		return true;
+	}
+
+	while (true) {
+		numBytes = waitDirectRead(directReader);
+
+		if (numBytes < 0) {
+			close(fd);
+
+			if (numBytes == -EINVAL && offset == 0) {
+				return false;
+			}
+
+			hashFile->errorNumber = -numBytes;
+			return true;
+		}
+
+		offset += numBytes;
+
+		if (numBytes < DIRECT_BUFFER_SIZE || offset >= fileSize) {
+			finishDigest(digestState, directReader->buffers[current], numBytes, offset, hashFile->digest);
+			close(fd);
+			return true;
+		}
+
+		if ((errorNumber = submitDirectRead(directReader, fd, directReader->buffers[current ^ 1], offset)) != 0) {
+			hashFile->errorNumber = errorNumber;
+			close(fd);
+			return true;
+		}
+
+		digestAlgorithm->stream(digestState, directReader->buffers[current], numBytes);
+		current ^= 1;
+	}
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ MD5 ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+static void md5Init(DigestState *state) {
+	f1518caf_initMD5State(state->md5);
+}
+
+static void md5Stream(DigestState *state, void *buffer, uint32_t length) {
+	f1518caf_md5Stream(state->md5, buffer, length);
+}
+
+static void md5StreamEnd(DigestState *state, void *buffer, uint32_t length, uint64_t totalLength, uint8_t *digest) {
+	if (totalLength == 0) {
+		f1518caf_md5(state->md5, NULL, 0);
+	} else {
+		f1518caf_md5StreamEnd(state->md5, buffer, length, totalLength);
+	}
+
+	memcpy(digest, state->md5, 16);
+}
+
+static void md5Print(uint8_t *digest) {
+	uint32_t md5State[4];
+
+	memcpy(md5State, digest, 16);
+	f1518caf_printMD5(md5State);
+}
+
+static void printDigest(uint8_t *digest, uint32_t length) {
+	for (uint32_t i = 0; i < length; i++) {
+		printf("%02x", digest[i]);
+	}
+}
+
+static inline uint32_t loadBigEndian32(const uint8_t *source) {
+	uint32_t value;
+
+	memcpy(&value, source, sizeof(uint32_t));
+
+	return __builtin_bswap32(value);
+}
+
+static inline void storeBigEndian32(uint8_t *target, uint32_t value) {
+	value = __builtin_bswap32(value);
+	memcpy(target, &value, sizeof(uint32_t));
+}
+
+static inline uint64_t loadLittleEndian64(const uint8_t *source) {
+	uint64_t value;
+
+	memcpy(&value, source, sizeof(uint64_t));
+
+	return value;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ SHA-1 / SHA-256 ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+static void sha1TransformScalar(uint32_t *state, const uint8_t *blocks, uint32_t numBlocks) {
+	uint32_t W[80];
+	uint32_t a, b, c, d, e, f, k, t;
+
+	while (numBlocks-- > 0) {
+		for (int i = 0; i < 16; i++) {
+			W[i] = loadBigEndian32(blocks + (i << 2));
+		}
+
+		for (int i = 16; i < 80; i++) {
+			W[i] = ROTATE_LEFT(W[i - 3] ^ W[i - 8] ^ W[i - 14] ^ W[i - 16], 1);
+		}
+
+		a = state[0]; b = state[1]; c = state[2]; d = state[3]; e = state[4];
+
+		for (int i = 0; i < 80; i++) {
+			if (i < 20) {
+				f = (b & c) | (~b & d);
+				k = 0x5a827999;
+			} else if (i < 40) {
+				f = b ^ c ^ d;
+				k = 0x6ed9eba1;
+			} else if (i < 60) {
+				f = (b & c) | (b & d) | (c & d);
+				k = 0x8f1bbcdc;
+			} else {
+				f = b ^ c ^ d;
+				k = 0xca62c1d6;
+			}
+
+			t = ROTATE_LEFT(a, 5) + f + e + k + W[i];
+			e = d; d = c; c = ROTATE_LEFT(b, 30); b = a; a = t;
+		}
+
+		state[0] += a; state[1] += b; state[2] += c; state[3] += d; state[4] += e;
+		blocks += 64;
+	}
+}
+
+// Four rounds of SHA-1 on the SHA extensions; func selects the round function
+#define SHA1_ROUNDS4(g, func) \
+	if ((g) >= 4) { \
+		W[(g) & 3] = _mm_sha1msg2_epu32(_mm_xor_si128(_mm_sha1msg1_epu32(W[(g) & 3], W[((g) + 1) & 3]), \
+		                                              W[((g) + 2) & 3]), W[((g) + 3) & 3]); \
+	} \
+	E = ((g) == 0) ? _mm_add_epi32(E0, W[0]) : _mm_sha1nexte_epu32(previousABCD, W[(g) & 3]); \
+	previousABCD = ABCD; \
+	ABCD = _mm_sha1rnds4_epu32(ABCD, E, func)
+
+__attribute__ ((target ("sha,sse4.1")))
+static void sha1TransformShaNI(uint32_t *state, const uint8_t *blocks, uint32_t numBlocks) {
+	const __m128i byteOrder = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+	__m128i ABCD, E0, E, previousABCD, savedABCD, savedE0, W[4];
+
+	ABCD = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) state), 0x1B);
+	E0 = _mm_set_epi32(state[4], 0, 0, 0);
+	previousABCD = ABCD;
+
+	while (numBlocks-- > 0) {
+		savedABCD = ABCD;
+		savedE0 = E0;
+
+		for (int i = 0; i < 4; i++) {
+			W[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (blocks + (i << 4))), byteOrder);
+		}
+
+		for (int g = 0; g < 5; g++) {
+			SHA1_ROUNDS4(g, 0);
+		}
+
+		for (int g = 5; g < 10; g++) {
+			SHA1_ROUNDS4(g, 1);
+		}
+
+		for (int g = 10; g < 15; g++) {
+			SHA1_ROUNDS4(g, 2);
+		}
+
+		for (int g = 15; g < 20; g++) {
+			SHA1_ROUNDS4(g, 3);
+		}
+
+		E0 = _mm_sha1nexte_epu32(previousABCD, savedE0);
+		ABCD = _mm_add_epi32(ABCD, savedABCD);
+		blocks += 64;
+	}
+
+	_mm_storeu_si128((__m128i *) state, _mm_shuffle_epi32(ABCD, 0x1B));
+	state[4] = _mm_extract_epi32(E0, 3);
+}
+
+static void sha256TransformScalar(uint32_t *state, const uint8_t *blocks, uint32_t numBlocks) {
+	uint32_t W[64];
+	uint32_t a, b, c, d, e, f, g, h, s0, s1, t1, t2;
+
+	while (numBlocks-- > 0) {
+		for (int i = 0; i < 16; i++) {
+			W[i] = loadBigEndian32(blocks + (i << 2));
+		}
+
+		for (int i = 16; i < 64; i++) {
+			s0 = ROTATE_RIGHT(W[i - 15], 7) ^ ROTATE_RIGHT(W[i - 15], 18) ^ (W[i - 15] >> 3);
+			s1 = ROTATE_RIGHT(W[i - 2], 17) ^ ROTATE_RIGHT(W[i - 2], 19) ^ (W[i - 2] >> 10);
+			W[i] = W[i - 16] + s0 + W[i - 7] + s1;
+		}
+
+		a = state[0]; b = state[1]; c = state[2]; d = state[3];
+		e = state[4]; f = state[5]; g = state[6]; h = state[7];
+
+		for (int i = 0; i < 64; i++) {
+			s1 = ROTATE_RIGHT(e, 6) ^ ROTATE_RIGHT(e, 11) ^ ROTATE_RIGHT(e, 25);
+			t1 = h + s1 + ((e & f) ^ (~e & g)) + sha256Constants[i] + W[i];
+			s0 = ROTATE_RIGHT(a, 2) ^ ROTATE_RIGHT(a, 13) ^ ROTATE_RIGHT(a, 22);
+			t2 = s0 + ((a & b) ^ (a & c) ^ (b & c));
+			h = g; g = f; f = e; e = d + t1; d = c; c = b; b = a; a = t1 + t2;
+		}
+
+		state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+		state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+		blocks += 64;
+	}
+}
+
+/*
+ * The SHA extensions keep the SHA-256 state as ABEF and CDGH, so the state is
+ * shuffled into that layout once and back when all blocks are done.
+ */
+__attribute__ ((target ("sha,sse4.1")))
+static void sha256TransformShaNI(uint32_t *state, const uint8_t *blocks, uint32_t numBlocks) {
+	const __m128i byteOrder = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+	__m128i ABEF, CDGH, savedABEF, savedCDGH, message, swap, W[4];
+
+	swap = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) state), 0xB1);
+	CDGH = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) (state + 4)), 0x1B);
+	ABEF = _mm_alignr_epi8(swap, CDGH, 8);
+	CDGH = _mm_blend_epi16(CDGH, swap, 0xF0);
+
+	while (numBlocks-- > 0) {
+		savedABEF = ABEF;
+		savedCDGH = CDGH;
+
+		for (int g = 0; g < 16; g++) {
+			if (g < 4) {
+				W[g] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (blocks + (g << 4))), byteOrder);
+			} else {
+				message = _mm_add_epi32(_mm_sha256msg1_epu32(W[g & 3], W[(g + 1) & 3]),
+				                        _mm_alignr_epi8(W[(g + 3) & 3], W[(g + 2) & 3], 4));
+				W[g & 3] = _mm_sha256msg2_epu32(message, W[(g + 3) & 3]);
+			}
+
+			message = _mm_add_epi32(W[g & 3], _mm_loadu_si128((const __m128i *) (sha256Constants + (g << 2))));
+			CDGH = _mm_sha256rnds2_epu32(CDGH, ABEF, message);
+			ABEF = _mm_sha256rnds2_epu32(ABEF, CDGH, _mm_shuffle_epi32(message, 0x0E));
+		}
+
+		ABEF = _mm_add_epi32(ABEF, savedABEF);
+		CDGH = _mm_add_epi32(CDGH, savedCDGH);
+		blocks += 64;
+	}
+
+	swap = _mm_shuffle_epi32(ABEF, 0x1B);
+	CDGH = _mm_shuffle_epi32(CDGH, 0xB1);
+	_mm_storeu_si128((__m128i *) state, _mm_blend_epi16(swap, CDGH, 0xF0));
+	_mm_storeu_si128((__m128i *) (state + 4), _mm_alignr_epi8(CDGH, swap, 8));
+}
+
+// Hashes the rest of the input plus the padding with its big-endian bit count
+static void shaStreamEnd(uint32_t *state, ShaTransform transform, uint8_t *buffer, uint32_t length, uint64_t totalLength) {
+	const uint32_t fullLength = length & ~63U;
+	uint32_t tailLength = length - fullLength;
+	uint64_t numBits = __builtin_bswap64(totalLength << 3);
+	uint8_t block[128];
+	uint32_t paddedLength;
+
+	if (fullLength > 0) {
+		transform(state, buffer, fullLength >> 6);
+	}
+
+	if (tailLength > 0) {
+		memcpy(block, buffer + fullLength, tailLength);
+	}
+
+	block[tailLength++] = 0x80;
+	paddedLength = (tailLength <= 56) ? 64 : 128;
+
+	memset(block + tailLength, 0, paddedLength - sizeof(uint64_t) - tailLength);
+	memcpy(block + paddedLength - sizeof(uint64_t), &numBits, sizeof(uint64_t));
+
+	transform(state, block, paddedLength >> 6);
+}
+
+static void sha1Init(DigestState *state) {
+	memcpy(state->sha1, sha1InitialState, sizeof(sha1InitialState));
+}
+
+static void sha1Stream(DigestState *state, void *buffer, uint32_t length) {
+	sha1Transform(state->sha1, buffer, length >> 6);
+}
+
+static void sha1StreamEnd(DigestState *state, void *buffer, uint32_t length, uint64_t totalLength, uint8_t *digest) {
+	shaStreamEnd(state->sha1, sha1Transform, buffer, length, totalLength);
+
+	for (int i = 0; i < 5; i++) {
+		storeBigEndian32(digest + (i << 2), state->sha1[i]);
+	}
+}
+
+static void sha1Print(uint8_t *digest) {
+	printDigest(digest, 20);
+}
+
+static void sha256Init(DigestState *state) {
+	memcpy(state->sha256, sha256InitialState, sizeof(sha256InitialState));
+}
+
+static void sha256Stream(DigestState *state, void *buffer, uint32_t length) {
+	sha256Transform(state->sha256, buffer, length >> 6);
+}
+
+static void sha256StreamEnd(DigestState *state, void *buffer, uint32_t length, uint64_t totalLength, uint8_t *digest) {
+	shaStreamEnd(state->sha256, sha256Transform, buffer, length, totalLength);
+
+	for (int i = 0; i < 8; i++) {
+		storeBigEndian32(digest + (i << 2), state->sha256[i]);
+	}
+}
+
+static void sha256Print(uint8_t *digest) {
+	printDigest(digest, 32);
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ XXH3 ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+static inline uint64_t xxh3Multiply128Fold64(uint64_t a, uint64_t b) {
+	__uint128_t product = (__uint128_t) a * b;
+
+	return (uint64_t) product ^ (uint64_t) (product >> 64);
+}
+
+static inline uint64_t xxh3Avalanche(uint64_t hash) {
+	hash ^= hash >> 37;
+	hash *= XXH_PRIME_MX1;
+
+	return hash ^ (hash >> 32);
+}
+
+static inline uint64_t xxh64Avalanche(uint64_t hash) {
+	hash ^= hash >> 33;
+	hash *= XXH_PRIME64_2;
+	hash ^= hash >> 29;
+	hash *= XXH_PRIME64_3;
+
+	return hash ^ (hash >> 32);
+}
+
+static inline uint64_t xxh3Mix16(const uint8_t *input, const uint8_t *secret) {
+	return xxh3Multiply128Fold64(loadLittleEndian64(input) ^ loadLittleEndian64(secret),
+	                             loadLittleEndian64(input + 8) ^ loadLittleEndian64(secret + 8));
+}
+
+// XXH3 of inputs up to XXH3_MAX_SHORT_INPUT bytes, which skip the accumulators
+static uint64_t xxh3HashShort(const uint8_t *input, uint64_t length) {
+	const uint8_t *secret = xxh3Secret;
+	uint64_t hash, low, high;
+	uint32_t combined;
+
+	if (length == 0) {
+		return xxh64Avalanche(loadLittleEndian64(secret + 56) ^ loadLittleEndian64(secret + 64));
+	} else if (length <= 3) {
+		combined = ((uint32_t) input[0] << 16) | ((uint32_t) input[length >> 1] << 24) | input[length - 1] | (length << 8);
+		low = (uint32_t) (loadLittleEndian64(secret) ^ (loadLittleEndian64(secret) >> 32));
+
+		return xxh64Avalanche(combined ^ low);
+	} else if (length <= 8) {
+		uint32_t first, last;
+
+		memcpy(&first, input, sizeof(uint32_t));
+		memcpy(&last, input + length - 4, sizeof(uint32_t));
+		hash = (last + ((uint64_t) first << 32)) ^ (loadLittleEndian64(secret + 8) ^ loadLittleEndian64(secret + 16));
+
+		hash ^= ((hash << 49) | (hash >> 15)) ^ ((hash << 24) | (hash >> 40));
+		hash *= XXH_PRIME_MX2;
+		hash ^= (hash >> 35) + length;
+		hash *= XXH_PRIME_MX2;
+
+		return hash ^ (hash >> 28);
+	} else if (length <= 16) {
+		low = loadLittleEndian64(input) ^ (loadLittleEndian64(secret + 24) ^ loadLittleEndian64(secret + 32));
+		high = loadLittleEndian64(input + length - 8) ^ (loadLittleEndian64(secret + 40) ^ loadLittleEndian64(secret + 48));
+
+		return xxh3Avalanche(length + __builtin_bswap64(low) + high + xxh3Multiply128Fold64(low, high));
+	}
+
+	hash = length * XXH_PRIME64_1;
+
+	if (length <= 128) {
+		// Pairs of 16 byte lanes from both ends meet in the middle
+		for (uint32_t i = 0; i < 4 && (i == 0 || length > 32 * i); i++) {
+			hash += xxh3Mix16(input + (16 * i), secret + (32 * i));
+			hash += xxh3Mix16(input + length - (16 * (i + 1)), secret + (32 * i) + 16);
+		}
+
+		return xxh3Avalanche(hash);
+	}
+
+	for (uint32_t i = 0; i < 8; i++) {
+		hash += xxh3Mix16(input + (16 * i), secret + (16 * i));
+	}
+
+	hash = xxh3Avalanche(hash);
+
+	for (uint32_t i = 8; i < length / 16; i++) {
+		hash += xxh3Mix16(input + (16 * i), secret + (16 * (i - 8)) + 3);
+	}
+
+	hash += xxh3Mix16(input + length - 16, secret + 136 - 17);
+
+	return xxh3Avalanche(hash);
+}
+
+static void xxh3AccumulateScalar(uint64_t accumulators[8], const uint8_t *stripes, const uint8_t *secret, uint32_t numStripes) {
+	uint64_t data, key;
+
+	while (numStripes-- > 0) {
+		for (int i = 0; i < 8; i++) {
+			data = loadLittleEndian64(stripes + (i << 3));
+			key = data ^ loadLittleEndian64(secret + (i << 3));
+			accumulators[i ^ 1] += data;
+			accumulators[i] += (uint32_t) key * (key >> 32);
+		}
+
+		stripes += XXH3_STRIPE_SIZE;
+		secret += 8;
+	}
+}
+
+__attribute__ ((target ("avx2")))
+static void xxh3AccumulateAVX2(uint64_t accumulators[8], const uint8_t *stripes, const uint8_t *secret, uint32_t numStripes) {
+	__m256i acc[2], data, key;
+
+	acc[0] = _mm256_loadu_si256((const __m256i *) accumulators);
+	acc[1] = _mm256_loadu_si256((const __m256i *) (accumulators + 4));
+
+	while (numStripes-- > 0) {
+		for (int i = 0; i < 2; i++) {
+			data = _mm256_loadu_si256((const __m256i *) (stripes + (i << 5)));
+			key = _mm256_xor_si256(data, _mm256_loadu_si256((const __m256i *) (secret + (i << 5))));
+			key = _mm256_mul_epu32(key, _mm256_srli_epi64(key, 32));
+			acc[i] = _mm256_add_epi64(acc[i], _mm256_shuffle_epi32(data, 0x4E));
+			acc[i] = _mm256_add_epi64(acc[i], key);
+		}
+
+		stripes += XXH3_STRIPE_SIZE;
+		secret += 8;
+	}
+
+	_mm256_storeu_si256((__m256i *) accumulators, acc[0]);
+	_mm256_storeu_si256((__m256i *) (accumulators + 4), acc[1]);
+}
+
+// Feeds whole stripes into the accumulators, scrambling them after each block
+static void xxh3ConsumeStripes(XXH3State *state, const uint8_t *stripes, uint32_t numStripes) {
+	uint32_t count;
+	uint64_t key;
+
+	while (numStripes > 0) {
+		count = XXH3_STRIPES_PER_BLOCK - state->numStripes;
+
+		if (count > numStripes) {
+			count = numStripes;
+		}
+
+		xxh3Accumulate(state->accumulators, stripes, xxh3Secret + (state->numStripes << 3), count);
+		state->numStripes += count;
+		stripes += count * XXH3_STRIPE_SIZE;
+		numStripes -= count;
+
+		if (state->numStripes == XXH3_STRIPES_PER_BLOCK) {
+			for (int i = 0; i < 8; i++) {
+				key = loadLittleEndian64(xxh3Secret + XXH3_SECRET_SIZE - XXH3_STRIPE_SIZE + (i << 3));
+				state->accumulators[i] ^= state->accumulators[i] >> 47;
+				state->accumulators[i] = (state->accumulators[i] ^ key) * XXH_PRIME32_1;
+			}
+
+			state->numStripes = 0;
+		}
+	}
+}
+
+static void xxh3Init(DigestState *state) {
+	XXH3State *xxh3 = &state->xxh3;
+
+	xxh3->accumulators[0] = XXH_PRIME32_3;
+	xxh3->accumulators[1] = XXH_PRIME64_1;
+	xxh3->accumulators[2] = XXH_PRIME64_2;
+	xxh3->accumulators[3] = XXH_PRIME64_3;
+	xxh3->accumulators[4] = XXH_PRIME64_4;
+	xxh3->accumulators[5] = XXH_PRIME32_2;
+	xxh3->accumulators[6] = XXH_PRIME64_5;
+	xxh3->accumulators[7] = XXH_PRIME32_1;
+
+	xxh3->shortLength = 0;
+	xxh3->numStripes = 0;
+	xxh3->hasLastStripe = false;
+}
+
+/*
+ * The last stripe of the buffer is held back, since only streamEnd knows
+ * whether it is the final stripe of the input.
+ */
+static void xxh3Stream(DigestState *state, void *buffer, uint32_t length) {
+	XXH3State *xxh3 = &state->xxh3;
+	uint32_t count;
+
+	if (length == 0) {
+		return;
+	}
+
+	if (xxh3->shortLength < XXH3_MAX_SHORT_INPUT) {
+		count = sizeof(xxh3->shortInput) - xxh3->shortLength;
+		count = (count < length) ? count : length;
+
+		memcpy(xxh3->shortInput + xxh3->shortLength, buffer, count);
+		xxh3->shortLength += count;
+	}
+
+	if (xxh3->hasLastStripe) {
+		xxh3ConsumeStripes(xxh3, xxh3->lastStripe, 1);
+	}
+
+	xxh3ConsumeStripes(xxh3, buffer, (length / XXH3_STRIPE_SIZE) - 1);
+	memcpy(xxh3->lastStripe, buffer + length - XXH3_STRIPE_SIZE, XXH3_STRIPE_SIZE);
+	xxh3->hasLastStripe = true;
+}
+
+static void xxh3StreamEnd(DigestState *state, void *buffer, uint32_t length, uint64_t totalLength, uint8_t *digest) {
+	XXH3State *xxh3 = &state->xxh3;
+	uint8_t *input = buffer;
+	uint8_t lastStripe[XXH3_STRIPE_SIZE];
+	uint64_t hash;
+
+	if (totalLength <= XXH3_MAX_SHORT_INPUT) {
+		if (length > 0) {
+			memcpy(xxh3->shortInput + xxh3->shortLength, input, length);
+		}
+
+		hash = xxh3HashShort(xxh3->shortInput, totalLength);
+	} else {
+		if (length > 0 && xxh3->hasLastStripe) {
+			xxh3ConsumeStripes(xxh3, xxh3->lastStripe, 1);
+		}
+
+		if (length > XXH3_STRIPE_SIZE) {
+			xxh3ConsumeStripes(xxh3, input, (length - 1) / XXH3_STRIPE_SIZE);
+		}
+
+		// The final stripe is the last 64 bytes of the input, even if they overlap
+		if (length >= XXH3_STRIPE_SIZE) {
+			memcpy(lastStripe, input + length - XXH3_STRIPE_SIZE, XXH3_STRIPE_SIZE);
+		} else {
+			memcpy(lastStripe, xxh3->lastStripe + length, XXH3_STRIPE_SIZE - length);
+
+			if (length > 0) {
+				memcpy(lastStripe + XXH3_STRIPE_SIZE - length, input, length);
+			}
+		}
+
+		xxh3Accumulate(xxh3->accumulators, lastStripe, xxh3Secret + XXH3_SECRET_SIZE - XXH3_STRIPE_SIZE - 7, 1);
+
+		hash = totalLength * XXH_PRIME64_1;
+
+		for (int i = 0; i < 4; i++) {
+			hash += xxh3Multiply128Fold64(xxh3->accumulators[2 * i] ^ loadLittleEndian64(xxh3Secret + 11 + (16 * i)),
+			                              xxh3->accumulators[2 * i + 1] ^ loadLittleEndian64(xxh3Secret + 19 + (16 * i)));
+		}
+
+		hash = xxh3Avalanche(hash);
+	}
+
+	// Canonical big-endian form, as printed by xxhsum
+	hash = __builtin_bswap64(hash);
+	memcpy(digest, &hash, sizeof(uint64_t));
+}
+
+static void xxh3Print(uint8_t *digest) {
+	printDigest(digest, 8);
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ BLAKE3 ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+// Compresses one block into the chaining value cv
+static void blake3Compress(uint32_t cv[8], const uint8_t *block, uint64_t counter, uint32_t blockLength, uint32_t flags) {
+	uint32_t m[16], v[16];
+
+	memcpy(m, block, sizeof(m));
+	memcpy(v, cv, 8 * sizeof(uint32_t));
+	memcpy(v + 8, sha256InitialState, 4 * sizeof(uint32_t));
+
+	v[12] = (uint32_t) counter;
+	v[13] = (uint32_t) (counter >> 32);
+	v[14] = blockLength;
+	v[15] = flags;
+
+	BLAKE3_ROUNDS(v, m);
+
+	for (int i = 0; i < 8; i++) {
+		cv[i] = v[i] ^ v[i + 8];
+	}
+}
+
+// SSE2 is part of x86-64, so four lanes are always available
+static void blake3CompressLanes4(uint32_t cv[8][MAX_LANES], const uint8_t *blocks[MAX_LANES],
+                                 const uint32_t counters[2][MAX_LANES], uint32_t blockLength, uint32_t flags) {
+	uint32_t words[16][MAX_LANES];
+	LaneVector4 m[16], v[16], zero = { 0 };
+
+	transposeBlocks(words, blocks, 4);
+
+	for (int w = 0; w < 16; w++) {
+		memcpy(&m[w], words[w], sizeof(LaneVector4));
+	}
+
+	for (int i = 0; i < 8; i++) {
+		memcpy(&v[i], cv[i], sizeof(LaneVector4));
+	}
+
+	for (int i = 0; i < 4; i++) {
+		v[i + 8] = zero + sha256InitialState[i];
+	}
+
+	memcpy(&v[12], counters[0], sizeof(LaneVector4));
+	memcpy(&v[13], counters[1], sizeof(LaneVector4));
+	v[14] = zero + blockLength;
+	v[15] = zero + flags;
+
+	BLAKE3_ROUNDS(v, m);
+
+	for (int i = 0; i < 8; i++) {
+		v[i] ^= v[i + 8];
+		memcpy(cv[i], &v[i], sizeof(LaneVector4));
+	}
+}
+
+__attribute__ ((target ("avx2")))
+static void blake3CompressLanes8(uint32_t cv[8][MAX_LANES], const uint8_t *blocks[MAX_LANES],
+                                 const uint32_t counters[2][MAX_LANES], uint32_t blockLength, uint32_t flags) {
+	uint32_t words[16][MAX_LANES];
+	LaneVector8 m[16], v[16], zero = { 0 };
+
+	transposeBlocks(words, blocks, 8);
+
+	for (int w = 0; w < 16; w++) {
+		memcpy(&m[w], words[w], sizeof(LaneVector8));
+	}
+
+	for (int i = 0; i < 8; i++) {
+		memcpy(&v[i], cv[i], sizeof(LaneVector8));
+	}
+
+	for (int i = 0; i < 4; i++) {
+		v[i + 8] = zero + sha256InitialState[i];
+	}
+
+	memcpy(&v[12], counters[0], sizeof(LaneVector8));
+	memcpy(&v[13], counters[1], sizeof(LaneVector8));
+	v[14] = zero + blockLength;
+	v[15] = zero + flags;
+
+	BLAKE3_ROUNDS(v, m);
+
+	for (int i = 0; i < 8; i++) {
+		v[i] ^= v[i + 8];
+		memcpy(cv[i], &v[i], sizeof(LaneVector8));
+	}
+}
+
+__attribute__ ((target ("avx512f")))
+static void blake3CompressLanes16(uint32_t cv[8][MAX_LANES], const uint8_t *blocks[MAX_LANES],
+                                  const uint32_t counters[2][MAX_LANES], uint32_t blockLength, uint32_t flags) {
+	uint32_t words[16][MAX_LANES];
+	LaneVector16 m[16], v[16], zero = { 0 };
+
+	transposeBlocks(words, blocks, 16);
+
+	for (int w = 0; w < 16; w++) {
+		memcpy(&m[w], words[w], sizeof(LaneVector16));
+	}
+
+	for (int i = 0; i < 8; i++) {
+		memcpy(&v[i], cv[i], sizeof(LaneVector16));
+	}
+
+	for (int i = 0; i < 4; i++) {
+		v[i + 8] = zero + sha256InitialState[i];
+	}
+
+	memcpy(&v[12], counters[0], sizeof(LaneVector16));
+	memcpy(&v[13], counters[1], sizeof(LaneVector16));
+	v[14] = zero + blockLength;
+	v[15] = zero + flags;
+
+	BLAKE3_ROUNDS(v, m);
+
+	for (int i = 0; i < 8; i++) {
+		v[i] ^= v[i + 8];
+		memcpy(cv[i], &v[i], sizeof(LaneVector16));
+	}
+}
+
+// Chaining values of numChunks whole chunks, one chunk per lane
+static void blake3HashChunks(const uint8_t *input, uint64_t chunkCounter, uint32_t numChunks, uint32_t (*chainingValues)[8]) {
+	uint32_t cv[8][MAX_LANES];
+	uint32_t counters[2][MAX_LANES];
+	const uint8_t *blocks[MAX_LANES];
+	uint32_t count, flags;
+
+	while (numChunks > 0) {
+		count = (numChunks < numLanes) ? numChunks : numLanes;
+
+		for (uint32_t lane = 0; lane < MAX_LANES; lane++) {
+			blocks[lane] = (lane < count) ? input + (lane * BLAKE3_CHUNK_SIZE) : zeroBlock;
+			counters[0][lane] = (uint32_t) (chunkCounter + lane);
+			counters[1][lane] = (uint32_t) ((chunkCounter + lane) >> 32);
+
+			for (int i = 0; i < 8; i++) {
+				cv[i][lane] = sha256InitialState[i];
+			}
+		}
+
+		for (uint32_t block = 0; block < BLAKE3_CHUNK_SIZE / 64; block++) {
+			flags = (block == 0) ? BLAKE3_CHUNK_START : 0;
+			flags |= (block == BLAKE3_CHUNK_SIZE / 64 - 1) ? BLAKE3_CHUNK_END : 0;
+
+			blake3CompressLanes(cv, blocks, counters, 64, flags);
+
+			for (uint32_t lane = 0; lane < count; lane++) {
+				blocks[lane] += 64;
+			}
+		}
+
+		for (uint32_t lane = 0; lane < count; lane++) {
+			for (int i = 0; i < 8; i++) {
+				chainingValues[lane][i] = cv[i][lane];
+			}
+		}
+
+		input += count * BLAKE3_CHUNK_SIZE;
+		chunkCounter += count;
+		chainingValues += count;
+		numChunks -= count;
+	}
+}
+
+// Replaces each pair of chaining values with their parent, one pair per lane
+static void blake3HashParents(uint32_t (*chainingValues)[8], uint32_t numParents) {
+	uint32_t cv[8][MAX_LANES];
+	const uint32_t counters[2][MAX_LANES] = { { 0 } };
+	const uint8_t *blocks[MAX_LANES];
+	uint32_t count;
+
+	for (uint32_t first = 0; first < numParents; first += count) {
+		count = (numParents - first < numLanes) ? numParents - first : numLanes;
+
+		for (uint32_t lane = 0; lane < MAX_LANES; lane++) {
+			blocks[lane] = (lane < count) ? (const uint8_t *) chainingValues[2 * (first + lane)] : zeroBlock;
+
+			for (int i = 0; i < 8; i++) {
+				cv[i][lane] = sha256InitialState[i];
+			}
+		}
+
+		blake3CompressLanes(cv, blocks, counters, 64, BLAKE3_PARENT);
+
+		for (uint32_t lane = 0; lane < count; lane++) {
+			for (int i = 0; i < 8; i++) {
+				chainingValues[first + lane][i] = cv[i][lane];
+			}
+		}
+	}
+}
+
+static void *runBlake3Job(void *blake3Job) {
+	Blake3Job *job = blake3Job;
+	uint32_t chainingValues[BLAKE3_SUBTREE_SIZE][8];
+	uint32_t subtree;
+
+	while ((subtree = atomic_fetch_add(&job->nextSubtree, 1)) < job->numSubtrees) {
+		blake3HashChunks(job->input + ((uint64_t) subtree * BLAKE3_SUBTREE_SIZE * BLAKE3_CHUNK_SIZE),
+		                 job->chunkCounter + ((uint64_t) subtree * BLAKE3_SUBTREE_SIZE), BLAKE3_SUBTREE_SIZE, chainingValues);
+
+		for (uint32_t numParents = BLAKE3_SUBTREE_SIZE / 2; numParents > 0; numParents >>= 1) {
+			blake3HashParents(chainingValues, numParents);
+		}
+
+		memcpy(job->chainingValues[subtree], chainingValues[0], sizeof(chainingValues[0]));
+	}
+
+	return NULL;
+}
+
+/*
+ * Merges the top of the stack until it holds one chaining value per bit set
+ * in chunkCounter, the number of chunks before the next subtree.
+ */
+static void blake3MergeChainingValues(Blake3State *state, uint64_t chunkCounter) {
+	uint32_t (*stack)[8] = state->chainingValues;
+	uint32_t cv[8];
+
+	while (state->numChainingValues > (uint32_t) __builtin_popcountll(chunkCounter)) {
+		state->numChainingValues--;
+
+		// The two chaining values are adjacent, which makes them the parent block
+		memcpy(cv, sha256InitialState, sizeof(cv));
+		blake3Compress(cv, (uint8_t *) stack[state->numChainingValues - 1], 0, 64, BLAKE3_PARENT);
+		memcpy(stack[state->numChainingValues - 1], cv, sizeof(cv));
+	}
+}
+
+// Pushes the chaining value of the subtree starting at chunkCounter
+static void blake3PushChainingValue(Blake3State *state, uint32_t cv[8], uint64_t chunkCounter) {
+	blake3MergeChainingValues(state, chunkCounter);
+	memcpy(state->chainingValues[state->numChainingValues++], cv, 8 * sizeof(uint32_t));
+}
+
+// Pushes chunks one lane each, and whole subtrees on numBlake3Threads threads
+static void blake3HashInput(Blake3State *state, const uint8_t *input, uint64_t numChunks) {
+	const uint64_t subtreeBytes = BLAKE3_SUBTREE_SIZE * BLAKE3_CHUNK_SIZE;
+	uint32_t chainingValues[BLAKE3_SUBTREE_SIZE][8];
+	uint32_t count;
+
+	while (numChunks > 0) {
+		count = (BLAKE3_SUBTREE_SIZE - (state->chunkCounter & (BLAKE3_SUBTREE_SIZE - 1)));
+
+		// Subtrees must start at a multiple of their size to fit the tree
+		if (count == BLAKE3_SUBTREE_SIZE && numChunks >= BLAKE3_SUBTREE_SIZE) {
+			Blake3Job job;
+			pthread_t threads[MAX_NUM_THREADS];
+			uint32_t numThreads;
+
+			job.input = input;
+			job.chunkCounter = state->chunkCounter;
+			job.numSubtrees = numChunks >> BLAKE3_SUBTREE_LOG2;
+			job.chainingValues = f668c4bd_malloc(job.numSubtrees * sizeof(uint32_t[8]));
+			atomic_init(&job.nextSubtree, 0);
+
+			numThreads = (numBlake3Threads < job.numSubtrees) ? numBlake3Threads : job.numSubtrees;
+
+			for (uint32_t i = 1; i < numThreads; i++) {
+				int errorNumber = pthread_create(&threads[i], NULL, runBlake3Job, &job);
+
+				if (errorNumber != 0) {
+					c7c88e52_printLibError("Cannot create thread", errorNumber);
+					exit(EXIT_FAILURE);
+				}
+			}
+
+			runBlake3Job(&job);
+
+			for (uint32_t i = 1; i < numThreads; i++) {
+				pthread_join(threads[i], NULL);
+			}
+
+			for (uint32_t i = 0; i < job.numSubtrees; i++) {
+				blake3PushChainingValue(state, job.chainingValues[i], state->chunkCounter);
+				state->chunkCounter += BLAKE3_SUBTREE_SIZE;
+			}
+
+			f668c4bd_free(job.chainingValues);
+
+			input += job.numSubtrees * subtreeBytes;
+			numChunks -= (uint64_t) job.numSubtrees << BLAKE3_SUBTREE_LOG2;
+			continue;
+		}
+
+		if (count > numChunks) {
+			count = numChunks;
+		}
+
+		blake3HashChunks(input, state->chunkCounter, count, chainingValues);
+
+		for (uint32_t i = 0; i < count; i++) {
+			blake3PushChainingValue(state, chainingValues[i], state->chunkCounter++);
+		}
+
+		input += count * BLAKE3_CHUNK_SIZE;
+		numChunks -= count;
+	}
+}
+
+/*
+ * Accepts input of any length. The last chunk is always kept in state->chunk,
+ * since it may turn out to be the root.
+ */
+static void blake3Update(Blake3State *state, const uint8_t *input, uint64_t length) {
+	uint32_t cv[8];
+	uint64_t numChunks;
+	uint32_t count;
+
+	if (state->chunkLength > 0) {
+		count = BLAKE3_CHUNK_SIZE - state->chunkLength;
+		count = (count < length) ? count : length;
+
+		memcpy(state->chunk + state->chunkLength, input, count);
+		state->chunkLength += count;
+		input += count;
+		length -= count;
+
+		if (length == 0) {
+			return;
+		}
+
+		// More input follows, so the buffered chunk is complete
+		memcpy(cv, sha256InitialState, sizeof(cv));
+
+		for (uint32_t block = 0; block < BLAKE3_CHUNK_SIZE / 64; block++) {
+			blake3Compress(cv, state->chunk + (block << 6), state->chunkCounter, 64,
+			               ((block == 0) ? BLAKE3_CHUNK_START : 0) | ((block == 15) ? BLAKE3_CHUNK_END : 0));
+		}
+
+		blake3PushChainingValue(state, cv, state->chunkCounter++);
+		state->chunkLength = 0;
+	}
+
+	if (length > BLAKE3_CHUNK_SIZE) {
+		numChunks = (length - 1) / BLAKE3_CHUNK_SIZE;
+		blake3HashInput(state, input, numChunks);
+
+		input += numChunks * BLAKE3_CHUNK_SIZE;
+		length -= numChunks * BLAKE3_CHUNK_SIZE;
+	}
+
+	if (length > 0) {
+		memcpy(state->chunk, input, length);
+		state->chunkLength = length;
+	}
+}
+
+static void blake3Init(DigestState *state) {
+	state->blake3.chunkCounter = 0;
+	state->blake3.chunkLength = 0;
+	state->blake3.numChainingValues = 0;
+}
+
+static void blake3Stream(DigestState *state, void *buffer, uint32_t length) {
+	blake3Update(&state->blake3, buffer, length);
+}
+
+static void blake3StreamEnd(DigestState *state, void *buffer, uint32_t length, uint64_t totalLength, uint8_t *digest) {
+	Blake3State *blake3 = &state->blake3;
+	uint32_t (*stack)[8] = blake3->chainingValues;
+	uint8_t block[64];
+	uint32_t cv[8], parent[16];
+	uint32_t numBlocks, blockLength, flags;
+
+	blake3Update(blake3, buffer, length);
+
+	blake3MergeChainingValues(blake3, blake3->chunkCounter);
+
+	// The last chunk has at least one block, even if empty
+	numBlocks = (blake3->chunkLength == 0) ? 1 : (blake3->chunkLength + 63) >> 6;
+	memcpy(cv, sha256InitialState, sizeof(cv));
+
+	for (uint32_t i = 0; i < numBlocks; i++) {
+		blockLength = blake3->chunkLength - (i << 6);
+		blockLength = (blockLength < 64) ? blockLength : 64;
+
+		memset(block, 0, sizeof(block));
+		memcpy(block, blake3->chunk + (i << 6), blockLength);
+
+		flags = (i == 0) ? BLAKE3_CHUNK_START : 0;
+
+		if (i == numBlocks - 1) {
+			flags |= BLAKE3_CHUNK_END | ((blake3->numChainingValues == 0) ? BLAKE3_ROOT : 0);
+		}
+
+		blake3Compress(cv, block, blake3->chunkCounter, blockLength, flags);
+	}
+
+	// Fold the stack into the last chunk from the right
+	while (blake3->numChainingValues > 0) {
+		blake3->numChainingValues--;
+
+		memcpy(parent, stack[blake3->numChainingValues], 8 * sizeof(uint32_t));
+		memcpy(parent + 8, cv, 8 * sizeof(uint32_t));
+		memcpy(cv, sha256InitialState, sizeof(cv));
+
+		blake3Compress(cv, (uint8_t *) parent, 0, 64, BLAKE3_PARENT | ((blake3->numChainingValues == 0) ? BLAKE3_ROOT : 0));
+	}
+
+	memcpy(digest, cv, sizeof(cv));
+}
+
+static void blake3Print(uint8_t *digest) {
+	printDigest(digest, 32);
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ Key Stretching ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/*
+ * Ends the first round, which hashes the input followed by the salt, and runs
+ * the remaining rounds on the digest
+ */
+static void finishDigest(DigestState *digestState, uint8_t *buffer, uint32_t length, uint64_t totalLength, uint8_t *digest) {
+	if (md5Params.salt == NULL) {
+		digestAlgorithm->streamEnd(digestState, buffer, length, totalLength, digest);
+	} else {
+		const uint32_t fullLength = length & ~63U;
+		const uint32_t tailLength = length - fullLength;
+		uint8_t *tail = f668c4bd_malloc(tailLength + md5Params.saltLength);
+
+		if (fullLength > 0) {
+			digestAlgorithm->stream(digestState, buffer, fullLength);
+		}
+
+		if (tailLength > 0) {
+			memcpy(tail, buffer + fullLength, tailLength);
+		}
+
+		memcpy(tail + tailLength, md5Params.salt, md5Params.saltLength);
+		digestAlgorithm->streamEnd(digestState, tail, tailLength + md5Params.saltLength,
+		                           totalLength + md5Params.saltLength, digest);
+		f668c4bd_free(tail);
+	}
+
+	stretchDigest(digest);
+}
+
+// Rounds 2 to numRounds of one MD5 digest; the state never leaves registers
+static void md5StretchScalar(uint32_t state[4], uint32_t numRounds) {
+	uint32_t M[16], a = state[0], b = state[1], c = state[2], d = state[3];
+
+	memcpy(M, md5StretchBlock, sizeof(M));
+
+	while (numRounds-- > 0) {
+		M[0] = a; M[1] = b; M[2] = c; M[3] = d;
+		a = 0x67452301; b = 0xefcdab89; c = 0x98badcfe; d = 0x10325476;
+
+		MD5_ROUNDS(M, a, b, c, d);
+
+		a += 0x67452301; b += 0xefcdab89; c += 0x98badcfe; d += 0x10325476;
+	}
+
+	state[0] = a; state[1] = b; state[2] = c; state[3] = d;
+}
+
+static void md5StretchLanes4(uint32_t state[4][MAX_LANES], uint32_t numRounds) {
+	LaneVector4 M[16], a, b, c, d, zero = { 0 };
+
+	for (int w = 4; w < 16; w++) {
+		M[w] = zero + md5StretchBlock[w];
+	}
+
+	memcpy(&a, state[0], sizeof(LaneVector4));
+	memcpy(&b, state[1], sizeof(LaneVector4));
+	memcpy(&c, state[2], sizeof(LaneVector4));
+	memcpy(&d, state[3], sizeof(LaneVector4));
+
+	while (numRounds-- > 0) {
+		M[0] = a; M[1] = b; M[2] = c; M[3] = d;
+		a = zero + 0x67452301; b = zero + 0xefcdab89; c = zero + 0x98badcfe; d = zero + 0x10325476;
+
+		MD5_ROUNDS(M, a, b, c, d);
+
+		a += 0x67452301; b += 0xefcdab89; c += 0x98badcfe; d += 0x10325476;
+	}
+
+	memcpy(state[0], &a, sizeof(LaneVector4));
+	memcpy(state[1], &b, sizeof(LaneVector4));
+	memcpy(state[2], &c, sizeof(LaneVector4));
+	memcpy(state[3], &d, sizeof(LaneVector4));
+}
+
+__attribute__ ((target ("avx2")))
+static void md5StretchLanes8(uint32_t state[4][MAX_LANES], uint32_t numRounds) {
+	LaneVector8 M[16], a, b, c, d, zero = { 0 };
+
+	for (int w = 4; w < 16; w++) {
+		M[w] = zero + md5StretchBlock[w];
+	}
+
+	memcpy(&a, state[0], sizeof(LaneVector8));
+	memcpy(&b, state[1], sizeof(LaneVector8));
+	memcpy(&c, state[2], sizeof(LaneVector8));
+	memcpy(&d, state[3], sizeof(LaneVector8));
+
+	while (numRounds-- > 0) {
+		M[0] = a; M[1] = b; M[2] = c; M[3] = d;
+		a = zero + 0x67452301; b = zero + 0xefcdab89; c = zero + 0x98badcfe; d = zero + 0x10325476;
+
+		MD5_ROUNDS(M, a, b, c, d);
+
+		a += 0x67452301; b += 0xefcdab89; c += 0x98badcfe; d += 0x10325476;
+	}
+
+	memcpy(state[0], &a, sizeof(LaneVector8));
+	memcpy(state[1], &b, sizeof(LaneVector8));
+	memcpy(state[2], &c, sizeof(LaneVector8));
+	memcpy(state[3], &d, sizeof(LaneVector8));
+}
+
+__attribute__ ((target ("avx512f")))
+static void md5StretchLanes16(uint32_t state[4][MAX_LANES], uint32_t numRounds) {
+	LaneVector16 M[16], a, b, c, d, zero = { 0 };
+
+	for (int w = 4; w < 16; w++) {
+		M[w] = zero + md5StretchBlock[w];
+	}
+
+	memcpy(&a, state[0], sizeof(LaneVector16));
+	memcpy(&b, state[1], sizeof(LaneVector16));
+	memcpy(&c, state[2], sizeof(LaneVector16));
+	memcpy(&d, state[3], sizeof(LaneVector16));
+
+	while (numRounds-- > 0) {
+		M[0] = a; M[1] = b; M[2] = c; M[3] = d;
+		a = zero + 0x67452301; b = zero + 0xefcdab89; c = zero + 0x98badcfe; d = zero + 0x10325476;
+
+		MD5_ROUNDS(M, a, b, c, d);
+
+		a += 0x67452301; b += 0xefcdab89; c += 0x98badcfe; d += 0x10325476;
+	}
+
+	memcpy(state[0], &a, sizeof(LaneVector16));
+	memcpy(state[1], &b, sizeof(LaneVector16));
+	memcpy(state[2], &c, sizeof(LaneVector16));
+	memcpy(state[3], &d, sizeof(LaneVector16));
+}
+
+/*
+ * With MD5 and a salt of up to 39 bytes, a round hashes a single block whose
+ * last twelve words never change, so they are built once here
+ */
+static void initStretchBlock() {
+	uint8_t *block = (uint8_t *) md5StretchBlock;
+	uint64_t numBits = ((uint64_t) 16 + md5Params.saltLength) << 3;
+
+	if (digestAlgorithm != &digestAlgorithms[0] || 16 + md5Params.saltLength > 55) {
+		return;
+	}
+
+	memset(block, 0, sizeof(md5StretchBlock));
+
+	if (md5Params.saltLength > 0) {
+		memcpy(block + 16, md5Params.salt, md5Params.saltLength);
+	}
+
+	block[16 + md5Params.saltLength] = 0x80;
+	memcpy(block + 56, &numBits, sizeof(uint64_t));
+
+	isOneBlockStretch = true;
+}
+
+// Runs rounds 2 to numRounds, each hashing the previous digest and the salt
+static void stretchDigest(uint8_t *digest) {
+	const uint32_t digestLength = digestAlgorithm->digestLength;
+	uint32_t md5State[4];
+	DigestState digestState;
+	uint8_t *message;
+
+	if (md5Params.numRounds == 1) {
+		return;
+	}
+
+	if (isOneBlockStretch) {
+		memcpy(md5State, digest, 16);
+		md5StretchScalar(md5State, md5Params.numRounds - 1);
+		memcpy(digest, md5State, 16);
+		return;
+	}
+
+	message = f668c4bd_malloc(digestLength + md5Params.saltLength);
+
+	if (md5Params.saltLength > 0) {
+		memcpy(message + digestLength, md5Params.salt, md5Params.saltLength);
+	}
+
+	for (uint32_t round = 1; round < md5Params.numRounds; round++) {
+		memcpy(message, digest, digestLength);
+		digestAlgorithm->init(&digestState);
+		digestAlgorithm->streamEnd(&digestState, message, digestLength + md5Params.saltLength,
+		                           digestLength + md5Params.saltLength, digest);
+	}
+
+	f668c4bd_free(message);
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ --batch ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+// Reads fd to the end into one buffer, which has room for a terminating NUL
+static uint8_t *readWholeFile(int fd, char *fileName, uint64_t *length) {
+	uint64_t size = STDIN_BUFFER_SIZE;
+	uint8_t *buffer = f668c4bd_malloc(size);
+	ssize_t numBytes;
+
+	*length = 0;
+
+	while ((numBytes = e2f74138_readFile(fd, buffer + *length, size - *length, fileName)) != END_OF_FILE) {
+		*length += numBytes;
+
+		if (*length == size) {
+			size <<= 1;
+			buffer = f668c4bd_realloc(buffer, size);
+		}
+	}
+
+	return buffer;
+}
+
+// Reads all of STDIN and splits it into lines in place
+static void readPasswords() {
+	uint64_t length;
+	uint32_t numLines = 0;
+	uint8_t *line, *end;
+
+	passwordList.input = readWholeFile(STDIN_FILENO, "STDIN", &length);
+
+	for (uint64_t i = 0; i < length; i++) {
+		numLines += (passwordList.input[i] == '\n');
+	}
+
+	// The last line may not end with a newline
+	numLines += (length > 0 && passwordList.input[length - 1] != '\n');
+
+	atomic_store(&totalBytes, length);
+	passwordList.length = numLines;
+
+	if (numLines == 0) {
+		return;
+	}
+
+	passwordList.values = f668c4bd_malloc(numLines * sizeof(uint8_t*));
+	passwordList.lengths = f668c4bd_malloc(numLines * sizeof(uint32_t));
+	passwordList.digests = f668c4bd_malloc(numLines * digestAlgorithm->digestLength);
+
+	line = passwordList.input;
+	end = passwordList.input + length;
+
+	for (uint32_t i = 0; i < numLines; i++) {
+		uint8_t *newline = memchr(line, '\n', end - line);
+
+		if (newline == NULL) {
+			newline = end;
+		}
+
+		passwordList.values[i] = line;
+		passwordList.lengths[i] = newline - line;
+		line = newline + 1;
+	}
+}
+
+/*
+ * Hashes count passwords of up to 55 bytes including the salt, one per lane.
+ * The first round is a single block, and the remaining rounds run in the
+ * stretching kernel without leaving the lanes.
+ */
+static void hashPasswordLanes(uint8_t *blocks, uint32_t *passwordNums, uint32_t count) {
+	uint32_t state[4][MAX_LANES];
+	const uint8_t *blockList[MAX_LANES];
+	uint8_t *digest;
+
+	for (uint32_t lane = 0; lane < MAX_LANES; lane++) {
+		blockList[lane] = (lane < count) ? blocks + (lane << 6) : zeroBlock;
+
+		state[0][lane] = 0x67452301;
+		state[1][lane] = 0xefcdab89;
+		state[2][lane] = 0x98badcfe;
+		state[3][lane] = 0x10325476;
+	}
+
+	md5TransformLanes(state, blockList);
+
+	if (md5Params.numRounds > 1) {
+		md5StretchLanes(state, md5Params.numRounds - 1);
+	}
+
+	for (uint32_t lane = 0; lane < count; lane++) {
+		digest = passwordList.digests + (passwordNums[lane] * 16);
+
+		for (uint32_t i = 0; i < 4; i++) {
+			memcpy(digest + (i * 4), &state[i][lane], sizeof(uint32_t));
+		}
+	}
+}
+
+static void *runBatchWorker(void *hashWorkerPtr) {
+	HashWorker *hashWorker = hashWorkerPtr;
+	const uint32_t first = (uint32_t) (((uint64_t) passwordList.length * hashWorker->workerNum) / numWorkers);
+	const uint32_t last = (uint32_t) (((uint64_t) passwordList.length * (hashWorker->workerNum + 1)) / numWorkers);
+	const bool useLanes = (digestAlgorithm == &digestAlgorithms[0]) && (md5Params.numRounds == 1 || isOneBlockStretch);
+	uint8_t *blocks = f668c4bd_malloc(MAX_LANES << 6);
+	uint32_t passwordNums[MAX_LANES];
+	DigestState digestState;
+	uint32_t count = 0;
+	uint32_t length;
+	uint64_t numBits;
+	uint8_t *block;
+
+	for (uint32_t i = first; i < last; i++) {
+		length = passwordList.lengths[i];
+
+		if (!useLanes || length + md5Params.saltLength > 55) {
+			digestAlgorithm->init(&digestState);
+			finishDigest(&digestState, passwordList.values[i], length, length,
+			             passwordList.digests + (i * digestAlgorithm->digestLength));
+			continue;
+		}
+
+		block = blocks + (count << 6);
+		numBits = ((uint64_t) length + md5Params.saltLength) << 3;
+
+		memset(block, 0, 64);
+		memcpy(block, passwordList.values[i], length);
+
+		if (md5Params.saltLength > 0) {
+			memcpy(block + length, md5Params.salt, md5Params.saltLength);
+		}
+
+		block[length + md5Params.saltLength] = 0x80;
+		memcpy(block + 56, &numBits, sizeof(uint64_t));
+
+		passwordNums[count++] = i;
+
+		if (count == numLanes) {
+			hashPasswordLanes(blocks, passwordNums, count);
+			count = 0;
+		}
+	}
+
+	if (count > 0) {
+		hashPasswordLanes(blocks, passwordNums, count);
+	}
+
+	f668c4bd_free(blocks);
+
+	return NULL;
+}
+
+// Splits the passwords into one contiguous slice per thread
+static void hashPasswords(uint32_t numThreads) {
+	HashWorker *hashWorkers;
+
+	numWorkers = (numThreads < passwordList.length) ? numThreads : passwordList.length;
+
+	if (numWorkers == 0) {
+		return;
+	}
+
+	hashWorkers = f668c4bd_malloc(numWorkers * sizeof(HashWorker));
+
+	for (uint32_t i = 0; i < numWorkers; i++) {
+		hashWorkers[i].workerNum = i;
+
+		if (numWorkers > 1) {
+			int errorNumber = pthread_create(&hashWorkers[i].thread, NULL, runBatchWorker, &hashWorkers[i]);
+
+			if (errorNumber != 0) {
+				c7c88e52_printLibError("Cannot create thread", errorNumber);
+				exit(EXIT_FAILURE);
+			}
+		}
+	}
+
+	if (numWorkers == 1) {
+		runBatchWorker(&hashWorkers[0]);
+	} else {
+		for (uint32_t i = 0; i < numWorkers; i++) {
+			pthread_join(hashWorkers[i].thread, NULL);
+		}
+	}
+
+	f668c4bd_free(hashWorkers);
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ -c manifest ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+static int hexValue(char c) {
+	if (c >= '0' && c <= '9') {
+		return c - '0';
+	} else if (c >= 'a' && c <= 'f') {
+		return c - 'a' + 10;
+	} else if (c >= 'A' && c <= 'F') {
+		return c - 'A' + 10;
+	}
+
+	return -1;
+}
+
+/*
+ * Parses "DIGEST  NAME" or "DIGEST *NAME". A leading backslash means the name
+ * has its backslashes and newlines escaped, as md5sum writes them.
+ */
+static bool parseManifestLine(char *line, ManifestEntry *entry) {
+	const uint32_t hexLength = digestAlgorithm->digestLength << 1;
+	const bool isEscaped = (*line == '\\');
+	char *fileName, *target;
+	int high, low;
+
+	line += isEscaped;
+
+	for (uint32_t i = 0; i < digestAlgorithm->digestLength; i++) {
+		if ((high = hexValue(line[i << 1])) < 0 || (low = hexValue(line[(i << 1) + 1])) < 0) {
+			return false;
+		}
+
+		entry->digest[i] = (high << 4) | low;
+	}
+
+	if (line[hexLength] != ' ' || (line[hexLength + 1] != ' ' && line[hexLength + 1] != '*') || line[hexLength + 2] == '\0') {
+		return false;
+	}
+
+	fileName = target = line + hexLength + 2;
+
+	if (isEscaped) {
+		for (char *position = fileName; *position != '\0'; position++) {
+			if (*position != '\\') {
+				*target++ = *position;
+			} else if (*++position == '\\') {
+				*target++ = '\\';
+			} else if (*position == 'n') {
+				*target++ = '\n';
+			} else {
+				return false;
+			}
+		}
+
+		*target = '\0';
+	}
+
+	entry->fileName = fileName;
+
+	return true;
+}
+
+static void locateManifestEntry(ManifestEntry *entry) {
+	union {
+		struct fiemap fiemap;
+		uint8_t       bytes[sizeof(struct fiemap) + sizeof(struct fiemap_extent)];
+	} request;
+	FileStatus fileStatus;
+	int fd;
+
+	// Files that cannot be opened go last and are reported when they are hashed
+	entry->device = UINT64_MAX;
+	entry->location = UINT64_MAX;
+
+	if ((fd = open(entry->fileName, O_RDONLY)) < 0) {
+		return;
+	}
+
+	if (fstat(fd, &fileStatus) == 0) {
+		entry->device = fileStatus.st_dev;
+		entry->location = fileStatus.st_ino;
+
+		memset(&request, 0, sizeof(request));
+		request.fiemap.fm_length = FIEMAP_MAX_OFFSET;
+		request.fiemap.fm_extent_count = 1;
+
+		if (ioctl(fd, FS_IOC_FIEMAP, &request.fiemap) == 0 && request.fiemap.fm_mapped_extents > 0) {
+			entry->location = request.fiemap.fm_extents[0].fe_physical;
+		}
+	}
+
+	close(fd);
+}
+
+static int compareManifestEntries(const void *a, const void *b) {
+	const ManifestEntry *entryA = *((ManifestEntry* const *) a);
+	const ManifestEntry *entryB = *((ManifestEntry* const *) b);
+
+	if (entryA->device != entryB->device) {
+		return (entryA->device < entryB->device) ? -1 : 1;
+	} else if (entryA->location != entryB->location) {
+		return (entryA->location < entryB->location) ? -1 : 1;
+	}
+
+	return 0;
+}
+
+/*
+ * Reads the manifest and fills the HashFileList in the order the files are
+ * laid out on disk, so the contiguous slice each worker starts with is read
+ * with as few seeks as possible
+ */
+static bool readManifest(char *manifestName) {
+	uint32_t size = HASH_FILE_LIST_INITIAL_SIZE;
+	ManifestEntry **entries;
+	char *input, *line, *end, *newline;
+	uint64_t length;
+	int fd;
+
+	if ((fd = open(manifestName, O_RDONLY)) < 0) {
+		printFileError(manifestName, errno);
+		exit(EXIT_FAILURE);
+	}
+
+	input = (char *) readWholeFile(fd, manifestName, &length);
+	close(fd);
+
+	end = input + length;
+	*end = '\0';
+
+	manifest.values = f668c4bd_malloc(size * sizeof(ManifestEntry));
+
+	for (line = input; line < end; line = newline + 1) {
+		if ((newline = strchr(line, '\n')) == NULL) {
+			newline = end;
+		}
+
+		*newline = '\0';
+
+		if (manifest.length == size) {
+			size <<= 1;
+			manifest.values = f668c4bd_realloc(manifest.values, size * sizeof(ManifestEntry));
+		}
+
+		if (parseManifestLine(line, &manifest.values[manifest.length])) {
+			locateManifestEntry(&manifest.values[manifest.length++]);
+		} else {
+			manifest.numInvalid++;
+		}
+	}
+
+	if (manifest.length == 0) {
+		fprintf(stderr, "%s: %s: no properly formatted checksum lines found\n", programName, manifestName);
+		return false;
+	}
+
+	entries = f668c4bd_malloc(manifest.length * sizeof(ManifestEntry*));
+
+	for (uint32_t i = 0; i < manifest.length; i++) {
+		entries[i] = &manifest.values[i];
+	}
+
+	qsort(entries, manifest.length, sizeof(ManifestEntry*), compareManifestEntries);
+
+	for (uint32_t i = 0; i < manifest.length; i++) {
+		addHashFile(entries[i]->fileName);
+		hashFileList.values[i].expectedDigest = entries[i]->digest;
+		entries[i]->hashFileNum = i;
+	}
+
+	f668c4bd_free(entries);
+
+	return true;
+}
+
+// Called by the workers once a file with an expected digest is done
+static void checkHashFile(HashFile *hashFile) {
+	if (hashFile->expectedDigest == NULL) {
+		return;
+	}
+
+	hashFile->isChecked = true;
+
+	if (md5Params.isFailFast && (hashFile->errorNumber != 0
+	        || memcmp(hashFile->digest, hashFile->expectedDigest, digestAlgorithm->digestLength) != 0)) {
+		atomic_store(&isStopped, true);
+	}
+}
+
+// Prints the result of every checked file in manifest order, like md5sum -c
+static bool printVerifyResults() {
+	uint32_t numUnreadable = 0, numMismatched = 0, numSkipped = 0;
+	HashFile *hashFile;
+	const char *result;
+
+	for (uint32_t i = 0; i < manifest.length; i++) {
+		hashFile = &hashFileList.values[manifest.values[i].hashFileNum];
+
+		if (!hashFile->isChecked) {
+			numSkipped++;
+			continue;
+		}
+
+		if (hashFile->errorNumber != 0) {
+			printFileError(hashFile->fileName, hashFile->errorNumber);
+			result = "FAILED open or read";
+			numUnreadable++;
+		} else if (memcmp(hashFile->digest, hashFile->expectedDigest, digestAlgorithm->digestLength) != 0) {
+			result = "FAILED";
+			numMismatched++;
+		} else {
+			result = "OK";
+		}
+
+		// Only names with a newline are escaped, the same as md5sum -c
+		if (strchr(hashFile->fileName, '\n') != NULL) {
+			putchar('\\');
+			printFileName(hashFile->fileName);
+		} else {
+			fputs(hashFile->fileName, stdout);
+		}
+
+		printf(": %s\n", result);
+	}
+
+	fflush(stdout);
+
+	if (manifest.numInvalid > 0 && manifest.length > 0) {
+		fprintf(stderr, "%s: WARNING: %u %s improperly formatted\n", programName, manifest.numInvalid,
+		        (manifest.numInvalid == 1) ? "line is" : "lines are");
+	}
+
+	if (numUnreadable > 0) {
+		fprintf(stderr, "%s: WARNING: %u listed %s could not be read\n", programName, numUnreadable,
+		        (numUnreadable == 1) ? "file" : "files");
+	}
+
+	if (numMismatched > 0) {
+		fprintf(stderr, "%s: WARNING: %u computed %s did NOT match\n", programName, numMismatched,
+		        (numMismatched == 1) ? "checksum" : "checksums");
+	}
+
+	if (numSkipped > 0) {
+		fprintf(stderr, "%s: WARNING: %u %s not checked after the first failure\n", programName, numSkipped,
+		        (numSkipped == 1) ? "file was" : "files were");
+	}
+
+	return (numUnreadable + numMismatched) == 0;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ --cache ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+static const char hashCacheMagic[8] = { 'D', 'O', 'B', 'H', 'A', 'S', 'H', 'C' };
+
+static bool isValidHashCache(int fd, uint64_t mapLength) {
+	HashCacheHeader header;
+	FileStatus fileStatus;
+
+	return fstat(fd, &fileStatus) == 0 && (uint64_t) fileStatus.st_size == mapLength
+	       && pread(fd, &header, sizeof(HashCacheHeader), 0) == sizeof(HashCacheHeader)
+	       && memcmp(header.magic, hashCacheMagic, sizeof(hashCacheMagic)) == 0
+	       && header.version == HASH_CACHE_VERSION
+	       && header.slotSize == sizeof(HashCacheSlot)
+	       && header.numSlots == HASH_CACHE_NUM_SLOTS;
+}
+
+/*
+ * Builds an empty cache beside the real one and renames it into place, so
+ * other processes only ever see a complete table. The file is sparse and
+ * only grows as slots are filled.
+ */
+static int createHashCache(char *cacheName, uint64_t mapLength) {
+	char tempName[PATH_MAX];
+	HashCacheHeader header;
+	int fd;
+
+	snprintf(tempName, PATH_MAX, "%s.XXXXXX", cacheName);
+
+	if ((fd = mkstemp(tempName)) < 0) {
+		return -1;
+	}
+
+	f668c4bd_meminit(&header, sizeof(HashCacheHeader));
+	memcpy(header.magic, hashCacheMagic, sizeof(hashCacheMagic));
+	header.version = HASH_CACHE_VERSION;
+	header.slotSize = sizeof(HashCacheSlot);
+	header.numSlots = HASH_CACHE_NUM_SLOTS;
+
+	if (ftruncate(fd, mapLength) != 0 || pwrite(fd, &header, sizeof(HashCacheHeader), 0) != sizeof(HashCacheHeader)
+	        || rename(tempName, cacheName) != 0) {
+		close(fd);
+		unlink(tempName);
+		return -1;
+	}
+
+	return fd;
+}
+
+/*
+ * Maps $XDG_CACHE_HOME/devopsbroker/hashcache, or ~/.cache/devopsbroker/hashcache,
+ * creating it if needed. A cache that cannot be used only costs a warning, as
+ * every file is then simply hashed.
+ */
+static void openHashCache() {
+	const uint64_t mapLength = sizeof(HashCacheHeader) + HASH_CACHE_NUM_SLOTS * sizeof(HashCacheSlot);
+	char cacheName[PATH_MAX];
+	char *cacheHome = getenv("XDG_CACHE_HOME");
+	struct timespec now;
+	void *map;
+	int fd;
+
+	if (cacheHome != NULL && cacheHome[0] == '/') {
+		snprintf(cacheName, PATH_MAX, "%s/devopsbroker", cacheHome);
+	} else if ((cacheHome = getenv("HOME")) != NULL) {
+		snprintf(cacheName, PATH_MAX, "%s/.cache", cacheHome);
+		mkdir(cacheName, 0700);
+		snprintf(cacheName, PATH_MAX, "%s/.cache/devopsbroker", cacheHome);
+	} else {
+		fprintf(stderr, "%s: --cache: HOME is not set\n", programName);
+		return;
+	}
+
+	mkdir(cacheName, 0700);
+	strncat(cacheName, "/hashcache", PATH_MAX - strlen(cacheName) - 1);
+
+	if ((fd = open(cacheName, O_RDWR | O_CLOEXEC)) >= 0 && !isValidHashCache(fd, mapLength)) {
+		close(fd);
+		fd = -1;
+		errno = ENOENT;
+	}
+
+	if (fd < 0 && (errno != ENOENT || (fd = createHashCache(cacheName, mapLength)) < 0)) {
+		printFileError(cacheName, errno);
+		return;
+	}
+
+	map = mmap(NULL, mapLength, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (map == MAP_FAILED) {
+		printFileError(cacheName, errno);
+		return;
+	}
+
+	clock_gettime(CLOCK_REALTIME, &now);
+
+	hashCache.header = map;
+	hashCache.slots = (HashCacheSlot *) (hashCache.header + 1);
+	hashCache.mapLength = mapLength;
+	hashCache.maxMtime = now.tv_sec * 1000000000LL + now.tv_nsec - HASH_CACHE_SETTLE_NS;
+	hashCache.algorithm = (digestAlgorithm - digestAlgorithms) + 1;
+}
+
+static void initCacheKey(HashCacheKey *cacheKey, FileStatus *fileStatus) {
+	cacheKey->device = fileStatus->st_dev;
+	cacheKey->inode = fileStatus->st_ino;
+	cacheKey->size = fileStatus->st_size;
+	cacheKey->mtime = fileStatus->st_mtim.tv_sec * 1000000000LL + fileStatus->st_mtim.tv_nsec;
+}
+
+// A file keeps its first slot when it changes, so its old digest is replaced
+static inline uint64_t hashCacheIndex(const HashCacheKey *cacheKey) {
+	const uint64_t identity[3] = { cacheKey->device, cacheKey->inode, ((uint64_t) md5Params.numRounds << 8) | hashCache.algorithm };
+
+	return xxh3HashShort((const uint8_t *) identity, sizeof(identity));
+}
+
+static inline uint32_t hashCacheChecksum(const HashCacheSlot *slot) {
+	const uint32_t offset = offsetof(HashCacheSlot, key);
+
+	return (uint32_t) xxh3HashShort(((const uint8_t *) slot) + offset, sizeof(HashCacheSlot) - offset);
+}
+
+static inline bool isSameFile(const HashCacheSlot *slot, const HashCacheKey *cacheKey) {
+	return slot->algorithm == hashCache.algorithm && slot->numRounds == md5Params.numRounds
+	       && slot->key.device == cacheKey->device && slot->key.inode == cacheKey->inode;
+}
+
+static bool lookupCachedDigest(const HashCacheKey *cacheKey, uint8_t *digest) {
+	const uint64_t index = hashCacheIndex(cacheKey);
+	HashCacheSlot *slot, copy;
+	uint32_t sequence;
+
+	for (uint32_t probe = 0; probe < HASH_CACHE_MAX_PROBES; probe++) {
+		slot = &hashCache.slots[(index + probe) & (HASH_CACHE_NUM_SLOTS - 1)];
+		sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+
+		if (sequence & 1) {
+			continue;
+		}
+
+		memcpy(&copy, slot, sizeof(HashCacheSlot));
+		atomic_thread_fence(memory_order_acquire);
+
+		if (atomic_load_explicit(&slot->sequence, memory_order_relaxed) != sequence) {
+			continue;
+		}
+
+		// Slots are never emptied, so the file cannot be further along
+		if (copy.algorithm == 0) {
+			return false;
+		}
+
+		if (isSameFile(&copy, cacheKey) && memcmp(&copy.key, cacheKey, sizeof(HashCacheKey)) == 0
+		        && copy.checksum == hashCacheChecksum(&copy)) {
+			memcpy(digest, copy.digest, digestAlgorithm->digestLength);
+			atomic_fetch_add_explicit(&hashCache.numHits, 1, memory_order_relaxed);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*
+ * Stores the digest of a file that was read successfully. It goes in the slot
+ * the file already has, else the first empty one, else over the first slot
+ * of the probe sequence.
+ */
+static void cacheHashFile(const HashCacheKey *cacheKey, HashFile *hashFile) {
+	uint64_t index;
+	HashCacheSlot *slot, *target;
+	HashCacheSlot entry;
+	uint32_t sequence, writing;
+
+	if (hashCache.slots == NULL || hashFile->errorNumber != 0 || cacheKey->mtime > hashCache.maxMtime) {
+		return;
+	}
+
+	index = hashCacheIndex(cacheKey);
+	target = &hashCache.slots[index & (HASH_CACHE_NUM_SLOTS - 1)];
+
+	for (uint32_t probe = 0; probe < HASH_CACHE_MAX_PROBES; probe++) {
+		slot = &hashCache.slots[(index + probe) & (HASH_CACHE_NUM_SLOTS - 1)];
+
+		if (slot->algorithm == 0 || isSameFile(slot, cacheKey)) {
+			target = slot;
+			break;
+		}
+	}
+
+	f668c4bd_meminit(&entry, sizeof(HashCacheSlot));
+	entry.key = *cacheKey;
+	entry.algorithm = hashCache.algorithm;
+	entry.numRounds = md5Params.numRounds;
+	memcpy(entry.digest, hashFile->digest, digestAlgorithm->digestLength);
+	entry.checksum = hashCacheChecksum(&entry);
+
+	/*
+	 * An odd sequence is another writer, or one that crashed halfway; it is
+	 * taken over rather than waited for, and the checksum catches the slot
+	 * should both writes interleave
+	 */
+	sequence = atomic_load_explicit(&target->sequence, memory_order_relaxed);
+
+	do {
+		writing = sequence + ((sequence & 1) ? 2 : 1);
+	} while (!atomic_compare_exchange_weak_explicit(&target->sequence, &sequence, writing, memory_order_acquire, memory_order_relaxed));
+
+	memcpy(((uint8_t *) target) + sizeof(uint32_t), ((uint8_t *) &entry) + sizeof(uint32_t), sizeof(HashCacheSlot) - sizeof(uint32_t));
+	atomic_store_explicit(&target->sequence, writing + 1, memory_order_release);
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ --tree ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/*
+ * Hashes the chunks of one file taken from the job. Every thread opens the
+ * file itself so the kernel keeps a separate readahead window per chunk.
+ */
+static void *runTreeJob(void *treeJob) {
+	TreeJob *job = treeJob;
+	ChunkList *chunkList = job->chunkList;
+	const uint32_t digestLength = chunkList->algorithm->digestLength;
+	DigestState digestState;
+	uint64_t chunk, chunkStart, chunkEnd, offset;
+	uint32_t length, wanted;
+	ssize_t numBytes;
+	uint8_t *buffer;
+	int fd;
+
+	if ((fd = open(job->fileName, O_RDONLY)) < 0) {
+		atomic_store(&job->errorNumber, errno);
+		return NULL;
+	}
+
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+	buffer = f668c4bd_malloc(TREE_BUFFER_SIZE);
+
+	while (atomic_load_explicit(&job->errorNumber, memory_order_relaxed) == 0
+	        && (chunk = atomic_fetch_add(&job->nextChunk, 1)) < chunkList->numChunks) {
+		chunkStart = offset = chunk * chunkList->chunkSize;
+		chunkEnd = chunkStart + chunkList->chunkSize;
+
+		if (chunkEnd > chunkList->fileSize) {
+			chunkEnd = chunkList->fileSize;
+		}
+
+		chunkList->algorithm->init(&digestState);
+
+		// Every buffer but the last of a chunk is full, so only whole blocks are streamed
+		while (true) {
+			wanted = (chunkEnd - offset < TREE_BUFFER_SIZE) ? chunkEnd - offset : TREE_BUFFER_SIZE;
+
+			for (length = 0; length < wanted; length += numBytes) {
+				numBytes = pread(fd, buffer + length, wanted - length, offset + length);
+
+				if (numBytes < 0) {
+					if (errno != EINTR) {
+						atomic_store(&job->errorNumber, errno);
+						goto cleanUp;
+					}
+
+					numBytes = 0;
+				} else if (numBytes == 0) {
+					break;
+				}
+			}
+
+			offset += length;
+
+			// A file that shrank since it was stat'ed ends the chunk early
+			if (offset == chunkEnd || length < wanted) {
+				chunkList->algorithm->streamEnd(&digestState, buffer, length, offset - chunkStart,
+				                                chunkList->digests + (chunk * digestLength));
+				break;
+			}
+
+			chunkList->algorithm->stream(&digestState, buffer, length);
+		}
+	}
+
+cleanUp:
+	f668c4bd_free(buffer);
+	close(fd);
+
+	return NULL;
+}
+
+// Fills chunkList with the digests of every chunk of the file; returns errno or 0
+static int hashTreeFile(char *fileName, ChunkList *chunkList, uint32_t numThreads) {
+	pthread_t threads[MAX_NUM_THREADS];
+	FileStatus fileStatus;
+	TreeJob job;
+	int fd;
+
+	if ((fd = open(fileName, O_RDONLY)) < 0) {
+		return errno;
+	}
+
+	if (fstat(fd, &fileStatus) != 0) {
+		close(fd);
+		return errno;
+	}
+
+	close(fd);
+
+	chunkList->algorithm = digestAlgorithm;
+	chunkList->fileSize = fileStatus.st_size;
+	chunkList->chunkSize = md5Params.chunkSize;
+	chunkList->numChunks = (chunkList->fileSize + chunkList->chunkSize - 1) / chunkList->chunkSize;
+
+	// The root digest hashes all chunk digests in one buffer
+	if (chunkList->numChunks * digestAlgorithm->digestLength > UINT32_MAX) {
+		return EFBIG;
+	}
+
+	chunkList->digests = f668c4bd_malloc((chunkList->numChunks + 1) * digestAlgorithm->digestLength);
+
+	job.chunkList = chunkList;
+	job.fileName = fileName;
+	atomic_init(&job.errorNumber, 0);
+	atomic_init(&job.nextChunk, 0);
+
+	if (numThreads > chunkList->numChunks) {
+		numThreads = (chunkList->numChunks == 0) ? 1 : chunkList->numChunks;
+	}
+
+	for (uint32_t i = 1; i < numThreads; i++) {
+		int errorNumber = pthread_create(&threads[i], NULL, runTreeJob, &job);
+
+		if (errorNumber != 0) {
+			c7c88e52_printLibError("Cannot create thread", errorNumber);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	runTreeJob(&job);
+
+	for (uint32_t i = 1; i < numThreads; i++) {
+		pthread_join(threads[i], NULL);
+	}
+
+	atomic_fetch_add(&totalBytes, chunkList->fileSize);
+
+	return atomic_load(&job.errorNumber);
+}
+
+static bool writeChunkList(char *listName, ChunkList *chunkList) {
+	const uint32_t digestLength = chunkList->algorithm->digestLength;
+	FILE *file = fopen(listName, "w");
+
+	if (file == NULL) {
+		printFileError(listName, errno);
+		return false;
+	}
+
+	fprintf(file, CHUNK_LIST_MAGIC "%s %lu %lu\n", chunkList->algorithm->name, chunkList->chunkSize, chunkList->fileSize);
+
+	for (uint64_t i = 0; i < chunkList->numChunks; i++) {
+		for (uint32_t j = 0; j < digestLength; j++) {
+			fprintf(file, "%02x", chunkList->digests[(i * digestLength) + j]);
+		}
+
+		fputc('\n', file);
+	}
+
+	if (fclose(file) != 0) {
+		printFileError(listName, errno);
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * Hashes each file as chunks spread over all threads. The digest printed for
+ * a file is the digest of its chunk digests, salted and stretched like any
+ * other; the chunk digests themselves go to the --chunks list.
+ */
+static void hashTreeFiles(uint32_t numThreads) {
+	DigestState digestState;
+	ChunkList chunkList;
+	HashFile *hashFile;
+
+	numWorkers = numThreads;
+
+	for (uint32_t i = 0; i < hashFileList.length; i++) {
+		hashFile = &hashFileList.values[i];
+		chunkList.digests = NULL;
+
+		if ((hashFile->errorNumber = hashTreeFile(hashFile->fileName, &chunkList, numThreads)) == 0) {
+			digestAlgorithm->init(&digestState);
+			finishDigest(&digestState, chunkList.digests, chunkList.numChunks * digestAlgorithm->digestLength,
+			             chunkList.numChunks * digestAlgorithm->digestLength, hashFile->digest);
+
+			if (md5Params.chunkListName != NULL && !writeChunkList(md5Params.chunkListName, &chunkList)) {
+				exit(EXIT_FAILURE);
+			}
+		}
+
+		f668c4bd_free(chunkList.digests);
+	}
+}
+
+static bool isChunkListFile(char *fileName) {
+	char magic[sizeof(CHUNK_LIST_MAGIC) - 1];
+	int fd;
+	bool isChunkList;
+
+	if ((fd = open(fileName, O_RDONLY)) < 0) {
+		printFileError(fileName, errno);
+		exit(EXIT_FAILURE);
+	}
+
+	isChunkList = pread(fd, magic, sizeof(magic), 0) == sizeof(magic) && memcmp(magic, CHUNK_LIST_MAGIC, sizeof(magic)) == 0;
+	close(fd);
+
+	return isChunkList;
+}
+
+static bool readChunkList(char *listName, ChunkList *chunkList) {
+	char algorithmName[16];
+	uint32_t digestLength;
+	uint64_t length;
+	char *input, *line;
+	int high, low;
+	int fd;
+
+	if ((fd = open(listName, O_RDONLY)) < 0) {
+		printFileError(listName, errno);
+		return false;
+	}
+
+	input = (char *) readWholeFile(fd, listName, &length);
+	input[length] = '\0';
+	close(fd);
+
+	chunkList->algorithm = NULL;
+
+	if (sscanf(input, CHUNK_LIST_MAGIC "%15s %lu %lu", algorithmName, &chunkList->chunkSize, &chunkList->fileSize) == 3
+	        && chunkList->chunkSize > 0) {
+		for (uint32_t i = 0; i < NUM_DIGEST_ALGORITHMS; i++) {
+			if (f6215943_isEqual(algorithmName, digestAlgorithms[i].name)) {
+				chunkList->algorithm = &digestAlgorithms[i];
+			}
+		}
+	}
+
+	if (chunkList->algorithm == NULL || (line = strchr(input, '\n')) == NULL) {
+		fprintf(stderr, "%s: %s: not a valid chunk list\n", programName, listName);
+		return false;
+	}
+
+	digestLength = chunkList->algorithm->digestLength;
+	chunkList->numChunks = (chunkList->fileSize + chunkList->chunkSize - 1) / chunkList->chunkSize;
+	chunkList->digests = f668c4bd_malloc((chunkList->numChunks + 1) * digestLength);
+
+	for (uint64_t i = 0; i < chunkList->numChunks; i++) {
+		line++;
+
+		for (uint32_t j = 0; j < digestLength; j++, line += 2) {
+			if ((high = hexValue(line[0])) < 0 || (low = hexValue(line[1])) < 0) {
+				fprintf(stderr, "%s: %s: not a valid chunk list\n", programName, listName);
+				return false;
+			}
+
+			chunkList->digests[(i * digestLength) + j] = (high << 4) | low;
+		}
+
+		if (*line != '\n') {
+			fprintf(stderr, "%s: %s: not a valid chunk list\n", programName, listName);
+			return false;
+		}
+	}
+
+	f668c4bd_free(input);
+
+	return true;
+}
+
+/*
+ * Compares two images, an image and the chunk list of an earlier run, or two
+ * chunk lists, and prints the offset and length of every region that differs.
+ * An image is hashed with the algorithm and chunk size of the other side's
+ * chunk list, if there is one.
+ */
+static bool diffChunkLists() {
+	ChunkList chunkLists[2];
+	bool isChunkList[2];
+	const ChunkList *listA = &chunkLists[0], *listB = &chunkLists[1];
+	uint64_t numChunks, fileSize, regionStart, regionEnd;
+	uint32_t digestLength;
+	bool isDifferent, isIdentical = true;
+	int errorNumber;
+
+	for (uint32_t i = 0; i < 2; i++) {
+		if ((isChunkList[i] = isChunkListFile(md5Params.fileNames[i]))) {
+			if (!readChunkList(md5Params.fileNames[i], &chunkLists[i])) {
+				exit(EXIT_FAILURE);
+			}
+
+			digestAlgorithm = chunkLists[i].algorithm;
+			md5Params.chunkSize = chunkLists[i].chunkSize;
+		}
+	}
+
+	if (isChunkList[0] && isChunkList[1] && (listA->algorithm != listB->algorithm || listA->chunkSize != listB->chunkSize)) {
+		fprintf(stderr, "%s: the chunk lists differ in algorithm or chunk size\n", programName);
+		exit(EXIT_FAILURE);
+	}
+
+	for (uint32_t i = 0; i < 2; i++) {
+		if (!isChunkList[i] && (errorNumber = hashTreeFile(md5Params.fileNames[i], &chunkLists[i], md5Params.numThreads)) != 0) {
+			printFileError(md5Params.fileNames[i], errorNumber);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	digestLength = digestAlgorithm->digestLength;
+	numChunks = (listA->numChunks > listB->numChunks) ? listA->numChunks : listB->numChunks;
+	fileSize = (listA->fileSize > listB->fileSize) ? listA->fileSize : listB->fileSize;
+	regionStart = regionEnd = 0;
+
+	// Adjacent chunks that differ are printed as one region
+	for (uint64_t i = 0; i <= numChunks; i++) {
+		isDifferent = (i < numChunks) && (i >= listA->numChunks || i >= listB->numChunks
+		        || memcmp(listA->digests + (i * digestLength), listB->digests + (i * digestLength), digestLength) != 0);
+
+		if (isDifferent) {
+			if (regionEnd == regionStart) {
+				regionStart = i * md5Params.chunkSize;
+			}
+
+			regionEnd = ((i + 1) * md5Params.chunkSize < fileSize) ? (i + 1) * md5Params.chunkSize : fileSize;
+		} else if (regionEnd != regionStart) {
+			printf("%lu %lu\n", regionStart, regionEnd - regionStart);
+			regionStart = regionEnd;
+			isIdentical = false;
+		}
+	}
+
+	fflush(stdout);
+
+	return isIdentical;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ Kernels ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+// Picks the widest kernels the CPU and the operating system both support
+static void selectHashKernels() {
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx512f")) {
+		md5TransformLanes = md5TransformLanes16;
+		md5StretchLanes = md5StretchLanes16;
+		blake3CompressLanes = blake3CompressLanes16;
+		numLanes = 16;
+	} else if (__builtin_cpu_supports("avx2")) {
+		md5TransformLanes = md5TransformLanes8;
+		md5StretchLanes = md5StretchLanes8;
+		blake3CompressLanes = blake3CompressLanes8;
+		numLanes = 8;
+	} else {
+		md5TransformLanes = md5TransformLanes4;
+		md5StretchLanes = md5StretchLanes4;
+		blake3CompressLanes = blake3CompressLanes4;
+		numLanes = 4;
+	}
+
+	if (__builtin_cpu_supports("sha") && __builtin_cpu_supports("sse4.1")) {
+		sha1Transform = sha1TransformShaNI;
+		sha256Transform = sha256TransformShaNI;
+	} else {
+		sha1Transform = sha1TransformScalar;
+		sha256Transform = sha256TransformScalar;
+	}
+
+	xxh3Accumulate = __builtin_cpu_supports("avx2") ? xxh3AccumulateAVX2 : xxh3AccumulateScalar;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ --stats ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+static void printStats(struct timespec *startTime, const char *ioModeName) {
+	struct timespec endTime;
+	uint64_t numBytes = atomic_load(&totalBytes);
+	double seconds;
+
+	clock_gettime(CLOCK_MONOTONIC, &endTime);
+	seconds = (endTime.tv_sec - startTime->tv_sec) + (endTime.tv_nsec - startTime->tv_nsec) / 1e9;
+
+	fprintf(stderr, "%s: io=%s lanes=%u threads=%u files=%u cached=%u bytes=%lu seconds=%.3f throughput=%.2f GB/s\n",
+	        programName, ioModeName, numLanes, numWorkers, hashFileList.length, atomic_load(&hashCache.numHits),
+	        numBytes, seconds, (seconds > 0) ? numBytes / seconds / 1e9 : 0.0);
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ --bench ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/*
+ * Counts the syscalls of this process and the threads it starts through the
+ * raw_syscalls:sys_enter tracepoint. Without tracefs or the permission to use
+ * it the syscall column stays empty.
+ */
+static int openSyscallCounter() {
+	static const char *const idFileNames[] = {
+		"/sys/kernel/tracing/events/raw_syscalls/sys_enter/id",
+		"/sys/kernel/debug/tracing/events/raw_syscalls/sys_enter/id"
+	};
+	struct perf_event_attr attr;
+	char idText[32];
+	ssize_t numBytes;
+	int fd;
+
+	for (uint32_t i = 0; i < sizeof(idFileNames) / sizeof(char*); i++) {
+		if ((fd = open(idFileNames[i], O_RDONLY)) < 0) {
+			continue;
+		}
+
+		numBytes = read(fd, idText, sizeof(idText) - 1);
+		close(fd);
+
+		if (numBytes > 0) {
+			idText[numBytes] = '\0';
+
+			f668c4bd_meminit(&attr, sizeof(struct perf_event_attr));
+			attr.type = PERF_TYPE_TRACEPOINT;
+			attr.size = sizeof(struct perf_event_attr);
+			attr.config = strtoull(idText, NULL, 10);
+			attr.inherit = 1;
+
+			return syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+		}
+	}
+
+	return -1;
+}
+
+static uint64_t readSyscallCounter() {
+	uint64_t count = 0;
+
+	if (benchParams.syscallCounter >= 0 && read(benchParams.syscallCounter, &count, sizeof(uint64_t)) != sizeof(uint64_t)) {
+		count = 0;
+	}
+
+	return count;
+}
+
+static void beginBench(BenchResult *result, const char *name, uint64_t size) {
+	result->name = name;
+	result->size = size;
+	result->numSyscalls = readSyscallCounter();
+	clock_gettime(CLOCK_MONOTONIC, &result->startTime);
+	result->numCycles = __rdtsc();
+}
+
+static void endBench(BenchResult *result, uint64_t numBytes) {
+	struct timespec endTime;
+
+	result->numCycles = __rdtsc() - result->numCycles;
+	clock_gettime(CLOCK_MONOTONIC, &endTime);
+	// Less the read of the counter itself
+	result->numSyscalls = (benchParams.syscallCounter >= 0) ? readSyscallCounter() - result->numSyscalls - 1 : 0;
+	result->numBytes = numBytes;
+	result->seconds = (endTime.tv_sec - result->startTime.tv_sec) + (endTime.tv_nsec - result->startTime.tv_nsec) / 1e9;
+}
+
+static void printBenchResult(BenchResult *result) {
+	const double gigabytes = result->numBytes / 1e9;
+	const double throughput = (result->seconds > 0) ? gigabytes / result->seconds : 0.0;
+	const double cyclesPerByte = (double) result->numCycles / result->numBytes;
+	const char *unit = "B";
+	uint64_t size = result->size;
+
+	if (benchParams.isJson) {
+		printf("%s\n    { \"name\": \"%s\", \"size\": %lu, \"bytes\": %lu, \"seconds\": %.6f, \"gbPerSecond\": %.3f, \"cyclesPerByte\": %.3f, ",
+		       (benchParams.numResults == 0) ? "" : ",", result->name, result->size, result->numBytes, result->seconds,
+		       throughput, cyclesPerByte);
+
+		if (benchParams.syscallCounter >= 0) {
+			printf("\"syscallsPerGB\": %.1f }", result->numSyscalls / gigabytes);
+		} else {
+			printf("\"syscallsPerGB\": null }");
+		}
+	} else {
+		for (uint32_t i = 0; i < 3 && size >= 1024 && (size & 1023) == 0; i++) {
+			size >>= 10;
+			unit = (i == 0) ? "KiB" : (i == 1) ? "MiB" : "GiB";
+		}
+
+		printf("%-12s %6lu %-3s %10.3f %10.3f", result->name, size, unit, throughput, cyclesPerByte);
+
+		if (benchParams.syscallCounter >= 0) {
+			printf(" %12.1f\n", result->numSyscalls / gigabytes);
+		} else {
+			printf(" %12s\n", "-");
+		}
+	}
+
+	benchParams.numResults++;
+	fflush(stdout);
+}
+
+// Number of messages of the given size that add up to about BENCH_TARGET_BYTES
+static inline uint64_t numBenchMessages(uint64_t size) {
+	return (size < BENCH_TARGET_BYTES) ? BENCH_TARGET_BYTES / size : 1;
+}
+
+// Hashes messages held in memory, so only the kernel of the algorithm is measured
+static void benchDigest(const DigestAlgorithm *algorithm, uint64_t size) {
+	const uint64_t numMessages = numBenchMessages(size);
+	uint8_t digest[MAX_DIGEST_LENGTH];
+	DigestState digestState;
+	BenchResult result;
+	uint64_t remaining;
+
+	beginBench(&result, algorithm->name, size);
+
+	for (uint64_t i = 0; i < numMessages; i++) {
+		algorithm->init(&digestState);
+
+		for (remaining = size; remaining > BENCH_BUFFER_SIZE; remaining -= BENCH_BUFFER_SIZE) {
+			algorithm->stream(&digestState, benchParams.buffer, BENCH_BUFFER_SIZE);
+		}
+
+		algorithm->streamEnd(&digestState, benchParams.buffer, remaining, size, digest);
+	}
+
+	endBench(&result, numMessages * size);
+	printBenchResult(&result);
+}
+
+// Hashes one message per lane, each from its own part of the buffer
+static void benchMD5Lanes(const char *name, MD5TransformLanes transformLanes, uint32_t numLanes, uint64_t size) {
+	const uint64_t numMessages = numBenchMessages(size * numLanes);
+	const uint32_t numBlocks = (size + 8) / 64 + 1;
+	uint32_t state[4][MAX_LANES];
+	const uint8_t *blocks[MAX_LANES];
+	BenchResult result;
+
+	f668c4bd_meminit(state, sizeof(state));
+
+	beginBench(&result, name, size);
+
+	for (uint64_t i = 0; i < numMessages; i++) {
+		for (uint32_t lane = 0; lane < MAX_LANES; lane++) {
+			blocks[lane] = benchParams.buffer + (lane * MD5_LANE_BUFFER_SIZE);
+		}
+
+		for (uint32_t block = 0; block < numBlocks; block++) {
+			transformLanes(state, blocks);
+
+			for (uint32_t lane = 0; lane < numLanes; lane++) {
+				blocks[lane] += 64;
+			}
+		}
+	}
+
+	endBench(&result, numMessages * numLanes * size);
+	printBenchResult(&result);
+}
+
+/*
+ * Hashes a file of the given size with each --io mode, through the same
+ * workers as any other file. The file is dropped from the page cache before
+ * every run, so on a disk the numbers include reading it.
+ */
+static void benchIOModes(uint64_t size) {
+	char fileName[PATH_MAX];
+	BenchResult result;
+	HashFile hashFile;
+	uint64_t offset;
+	uint32_t length;
+	int fd;
+
+	snprintf(fileName, PATH_MAX, "%s/md5hash-bench.XXXXXX", benchParams.dirName);
+
+	if ((fd = mkstemp(fileName)) < 0) {
+		printFileError(fileName, errno);
+		exit(EXIT_FAILURE);
+	}
+
+	for (offset = 0; offset < size; offset += length) {
+		length = (size - offset < BENCH_BUFFER_SIZE) ? size - offset : BENCH_BUFFER_SIZE;
+
+		if (write(fd, benchParams.buffer, length) != length) {
+			printFileError(fileName, errno);
+			unlink(fileName);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	fdatasync(fd);
+
+	hashFileList.values = &hashFile;
+	hashFileList.length = 1;
+
+	for (uint32_t mode = IO_AIO; mode <= IO_DIRECT; mode++) {
+		posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+
+		ioMode = mode;
+		hashFile.fileName = fileName;
+		hashFile.expectedDigest = NULL;
+		hashFile.errorNumber = 0;
+
+		beginBench(&result, benchIONames[mode], size);
+		hashFiles(1);
+		endBench(&result, size);
+
+		if (hashFile.errorNumber != 0) {
+			printFileError(fileName, hashFile.errorNumber);
+		} else {
+			printBenchResult(&result);
+		}
+	}
+
+	hashFileList.length = 0;
+
+	close(fd);
+	unlink(fileName);
+}
+
+/*
+ * Measures every digest algorithm, every MD5Lanes kernel this CPU can run and
+ * every --io mode, for message sizes from 64 bytes up to benchParams.maxSize
+ * in steps of four
+ */
+static void runBench() {
+	struct { const char *name; MD5TransformLanes transformLanes; uint32_t numLanes; bool isSupported; } lanes[] = {
+		{ "md5-lanes4",  md5TransformLanes4,  4,  true },
+		{ "md5-lanes8",  md5TransformLanes8,  8,  __builtin_cpu_supports("avx2") },
+		{ "md5-lanes16", md5TransformLanes16, 16, __builtin_cpu_supports("avx512f") }
+	};
+	uint64_t random = XXH_PRIME64_1;
+
+	benchParams.buffer = aligned_alloc(HUGEPAGE_SIZE, BENCH_BUFFER_SIZE);
+	benchParams.syscallCounter = openSyscallCounter();
+
+	if (benchParams.buffer == NULL) {
+		c7c88e52_printLibError("Cannot allocate the benchmark buffer", ENOMEM);
+		exit(EXIT_FAILURE);
+	}
+
+	// Random data, so no kernel or filesystem gets an easy ride on zeros
+	for (uint64_t i = 0; i < BENCH_BUFFER_SIZE; i += sizeof(uint64_t)) {
+		random ^= random << 13;
+		random ^= random >> 7;
+		random ^= random << 17;
+		memcpy(benchParams.buffer + i, &random, sizeof(uint64_t));
+	}
+
+	if (benchParams.isJson) {
+		printf("{\n  \"lanes\": %u,\n  \"cpuCycles\": \"tsc\",\n  \"ioAlgorithm\": \"%s\",\n  \"ioDirectory\": \"%s\",\n  \"results\": [",
+		       numLanes, digestAlgorithm->name, benchParams.dirName);
+	} else {
+		printf("%-12s %10s %10s %10s %12s\n", "Name", "Size", "GB/s", "Cycles/B", "Syscalls/GB");
+	}
+
+	for (uint64_t size = 64; size <= benchParams.maxSize; size <<= 2) {
+		for (uint32_t i = 0; i < NUM_DIGEST_ALGORITHMS; i++) {
+			benchDigest(&digestAlgorithms[i], size);
+		}
+
+		// The MD5Lanes only ever hash small files
+		for (uint32_t i = 0; i < sizeof(lanes) / sizeof(lanes[0]) && size <= SMALL_FILE_SIZE; i++) {
+			if (lanes[i].isSupported) {
+				benchMD5Lanes(lanes[i].name, lanes[i].transformLanes, lanes[i].numLanes, size);
+			}
+		}
+
+		if (size > SMALL_FILE_SIZE) {
+			benchIOModes(size);
+		}
+	}
+
+	if (benchParams.isJson) {
+		printf("\n  ]\n}\n");
+	}
+
+	free(benchParams.buffer);
+}
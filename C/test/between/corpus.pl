@@ -0,0 +1,345 @@
+#!/usr/bin/perl
+
+#
+# corpus.pl - DevOpsBroker Perl corpus generator and reference implementation
+#             for testing the between utility
+#
+# Copyright (C) 2018-2020 Edward Smith <edwardsmith@devopsbroker.org>
+#
+# This program is free software: you can redistribute it and/or modify it under
+# the terms of the GNU General Public License as published by the Free Software
+# Foundation, either version 3 of the License, or (at your option) any later
+# version.
+#
+# This program is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+# FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+# details.
+#
+# You should have received a copy of the GNU General Public License along with
+# this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# -----------------------------------------------------------------------------
+# Developed on Ubuntu 18.04.2 LTS running kernel.osrelease = 4.18.0-18
+#
+# corpus.pl generate SEED SIZE_MB DENSITY FILE
+#   Writes a text corpus of SIZE_MB MiB with <td>, <pre>, <title> and <a
+#   regions every DENSITY bytes on average, for benchmarking.
+#
+# corpus.pl fuzz BETWEEN SEED NUM_CASES FAIL_DIR
+#   Runs BETWEEN on NUM_CASES random inputs, as a file and through a pipe, and
+#   compares its output with the reference implementation below. Inputs range
+#   from a few bytes to over 16 MiB, with START and END straddling the pipe
+#   buffer and -j scan chunk boundaries. The first failing cases are saved to
+#   FAIL_DIR.
+# -----------------------------------------------------------------------------
+#
+
+use strict;
+use warnings;
+
+use POSIX ();
+
+# Pipe reads and the -j scan chunks of between end on multiples of these
+my @BOUNDARIES = (64 * 1024, 8 * 1024 * 1024);
+
+my @TAGS = (['td', '<td>', '</td>'], ['pre', '<pre>', '</pre>'], ['title', '<title>', '</title>'], ['a', '<a ', '</a>']);
+
+################################## Functions ##################################
+
+# ¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯
+# Function:     reference
+# Description:  Extracts the regions the way between does: each pair on its
+#               own, every region ending with its trailing newlines and
+#               carriage returns replaced by one newline, in the order the
+#               ENDs occur
+#
+# Parameter $1: The input text
+# Parameter $2: Reference to the list of [tag, START, END] pairs
+# Parameter $3: Whether to extract every region (--all)
+# -----------------------------------------------------------------------------
+sub reference {
+	my ($text, $pairs, $isAll) = @_;
+	my @regions;
+
+	for my $pairIndex (0 .. $#$pairs) {
+		my ($tag, $start, $end) = @{$pairs->[$pairIndex]};
+		my $position = 0;
+
+		while ((my $startIndex = index($text, $start, $position)) >= 0) {
+			my $regionStart = $startIndex + length($start);
+			my $endIndex = index($text, $end, $regionStart);
+
+			last if $endIndex < 0;
+
+			my $region = substr($text, $regionStart, $endIndex - $regionStart);
+			$position = $endIndex + length($end);
+
+			push @regions, [$position, -length($end), $pairIndex, $region] if length($region) > 0;
+
+			last unless $isAll;
+		}
+	}
+
+	my $output = '';
+
+	for my $region (sort { $a->[0] <=> $b->[0] || $a->[1] <=> $b->[1] || $a->[2] <=> $b->[2] } @regions) {
+		my $text = $region->[3];
+
+		$text =~ s/[\r\n]+\z//;
+		$output .= $pairs->[$region->[2]][0] . $text . "\n";
+	}
+
+	return $output;
+}
+
+# ¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯
+# Function:     runBetween
+# Description:  Runs between on the input file, or on its contents through a
+#               pipe, and returns its output and exit status
+#
+# Parameter $1: Path of the between executable
+# Parameter $2: Reference to the list of arguments
+# Parameter $3: The input file
+# Parameter $4: Whether to send the input through a pipe
+# -----------------------------------------------------------------------------
+sub runBetween {
+	my ($between, $args, $inputFile, $isPipe) = @_;
+	my $pid = open(my $output, '-|') // die "Cannot fork: $!\n";
+
+	if ($pid == 0) {
+		if ($isPipe) {
+			pipe(my $reader, my $writer) or die "Cannot create pipe: $!\n";
+
+			if (fork() == 0) {
+				close($reader);
+				open(my $input, '<:raw', $inputFile) or POSIX::_exit(1);
+				binmode($writer);
+				print $writer $_ while read($input, $_, 65536);
+				close($writer);
+				POSIX::_exit(0);
+			}
+
+			close($writer);
+			open(STDIN, '<&', $reader) or die "Cannot redirect STDIN: $!\n";
+			exec { $between } $between, @$args;
+		} else {
+			exec { $between } $between, @$args, $inputFile;
+		}
+
+		POSIX::_exit(127);
+	}
+
+	binmode($output);
+	local $/;
+	my $result = <$output> // '';
+	close($output);
+
+	return ($result, $? >> 8);
+}
+
+sub randomString {
+	my ($alphabet, $length) = @_;
+
+	return join('', map { substr($alphabet, int(rand(length($alphabet))), 1) } 1 .. $length);
+}
+
+sub escapePattern {
+	my ($pattern) = @_;
+
+	$pattern =~ s/\\/\\\\/g;
+	$pattern =~ s/\t/\\t/g;
+	$pattern =~ s/\n/\\n/g;
+	$pattern =~ s/\r/\\r/g;
+
+	return $pattern;
+}
+
+# Quotes an argument for the report of a failing case, escaped as in a spec file
+sub quoteArgument {
+	my ($argument) = @_;
+
+	return $argument if $argument =~ m{^[\w./=-]+$};
+
+	$argument = escapePattern($argument);
+	$argument =~ s/'/'\\''/g;
+
+	return "'$argument'";
+}
+
+sub writeFile {
+	my ($fileName, $contents) = @_;
+
+	open(my $file, '>:raw', $fileName) or die "Cannot write '$fileName': $!\n";
+	print $file $contents;
+	close($file) or die "Cannot write '$fileName': $!\n";
+}
+
+# ¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯
+# Function:     generateCorpus
+# Description:  Writes a benchmark corpus of tagged regions in lowercase text
+#
+# Parameter $1: Random seed
+# Parameter $2: Size of the corpus in MiB
+# Parameter $3: Average distance between regions, in bytes
+# Parameter $4: Name of the corpus file
+# -----------------------------------------------------------------------------
+sub generateCorpus {
+	my ($seed, $sizeMB, $density, $fileName) = @_;
+	my $size = $sizeMB * 1024 * 1024;
+	my ($filler, $tag, @pieces);
+	my $length = 0;
+
+	srand($seed);
+	$filler = randomString("abcdefghijklmnopqrstuvwxyz     \n", 1024 * 1024);
+
+	while ($length < $size) {
+		$tag = $TAGS[int(rand(@TAGS))];
+
+		push @pieces, substr($filler, int(rand(512 * 1024)), int(rand($density)) + 1), $tag->[1],
+		              substr($filler, int(rand(512 * 1024)), int(rand($density / 4)) + 1), $tag->[2];
+		$length += length($pieces[-4]) + length($pieces[-3]) + length($pieces[-2]) + length($pieces[-1]);
+	}
+
+	writeFile($fileName, substr(join('', @pieces), 0, $size));
+
+	# The spec file for -f extracts all four tags
+	writeFile("$fileName.spec", join('', map { "$_->[0]\t$_->[1]\t$_->[2]\n" } @TAGS));
+}
+
+# ¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯
+# Function:     fuzz
+# Description:  Compares between with the reference implementation on random
+#               inputs; returns the number of failing cases
+#
+# Parameter $1: Path of the between executable
+# Parameter $2: Random seed
+# Parameter $3: Number of cases
+# Parameter $4: Directory for the inputs of failing cases
+# -----------------------------------------------------------------------------
+sub fuzz {
+	my ($between, $seed, $numCases, $failDir) = @_;
+	my @alphabets = ('ab', "abc\n", "<>/td \r\n\t\\", join('', map { chr } 1 .. 255));
+	my @sizes = (0, 1, 5, 30, 200, 3000, 70000, 300000);
+	my $inputFile = "$failDir/between-fuzz.in";
+	my $specFile = "$failDir/between-fuzz.spec";
+	my $numFailed = 0;
+
+	srand($seed);
+
+	for my $case (1 .. $numCases) {
+		my ($alphabet, $text, @pairs, @args, $isAll, $mode);
+		my $isChunked = ($case % 40 == 0);
+
+		# Every tenth case is large, with markers placed across the boundaries
+		if ($case % 10 == 0) {
+			my $size = $isChunked ? 17 * 1024 * 1024 : 3 * 1024 * 1024;
+			my ($marker, $position, @markers);
+
+			$alphabet = "abcdefgh \n";
+			$text = randomString($alphabet, 65536) x ($size / 65536 + 1);
+			$text = substr($text, int(rand(65536)), $size - int(rand(4096)));
+
+			# A region only runs out of step with the next scan chunk when a
+			# START overlaps its END. Here every END begins with the START, and
+			# a region runs across each chunk boundary to an END just past it.
+			if ($isChunked) {
+				$marker = randomString('<>/', int(rand(2)) + 1);
+				@pairs = (['', $marker, $marker . randomString('<>/', int(rand(2)) + 1)]);
+
+				for (my $offset = $BOUNDARIES[-1]; $offset < length($text) - 64; $offset += $BOUNDARIES[-1]) {
+					substr($text, $offset - int(rand(100)) - 8, length($pairs[0][1])) = $pairs[0][1];
+					substr($text, $offset + int(rand(16)), length($pairs[0][2])) = $pairs[0][2];
+				}
+			} else {
+				@pairs = map { my $tag = $TAGS[int(rand(@TAGS))]; ["$tag->[0]\t", $tag->[1], $tag->[2]] } 1 .. int(rand(3)) + 1;
+			}
+
+			@markers = map { ($_->[1], $_->[2]) } @pairs;
+
+			for (my $offset = $BOUNDARIES[0]; $offset < length($text); $offset += $BOUNDARIES[0]) {
+				$marker = $markers[int(rand(@markers))];
+				$position = $offset - int(rand(length($marker) + 1));
+
+				substr($text, $position, length($marker)) = $marker if $position + length($marker) <= length($text);
+			}
+
+			for (1 .. int(rand(200))) {
+				$marker = $markers[int(rand(@markers))];
+				substr($text, int(rand(length($text) - length($marker))), length($marker)) = $marker;
+			}
+		} else {
+			$alphabet = $alphabets[int(rand(@alphabets))];
+			$text = randomString($alphabet, $sizes[int(rand(@sizes))]);
+			@pairs = map { ["p$_\t", randomString($alphabet, int(rand(5)) + 1), randomString($alphabet, int(rand(5)) + 1)] }
+			         0 .. int(rand(5));
+		}
+
+		# Only --all is scanned in parallel chunks
+		$isAll = $isChunked || rand() < 0.6;
+		$mode = $isChunked ? 2 : int(rand(3));
+
+		push @args, '--all' if $isAll;
+
+		if ($mode == 0) {
+			# A spec file of one or more pairs
+			writeFile($specFile, join('', map { "$_->[0]" . escapePattern($_->[1]) . "\t" . escapePattern($_->[2]) . "\n" } @pairs));
+			push @args, '-f', $specFile;
+		} else {
+			@pairs = ([ '', $pairs[0][1], $pairs[0][2] ]);
+			push @args, '-j', int(rand(3)) + 2 if $mode == 2;
+			push @args, '--', $pairs[0][1], $pairs[0][2];
+		}
+
+		writeFile($inputFile, $text);
+
+		my $expected = reference($text, \@pairs, $isAll);
+
+		for my $isPipe (0, 1) {
+			my ($output, $exitCode) = runBetween($between, \@args, $inputFile, $isPipe);
+
+			next if $output eq $expected && $exitCode == 0;
+
+			$numFailed++;
+
+			if ($numFailed <= 3) {
+				my $caseName = "$failDir/between-fuzz.fail$numFailed";
+
+				rename($inputFile, "$caseName.in");
+				rename($specFile, "$caseName.spec") if -e $specFile;
+				writeFile("$caseName.expect", $expected);
+				writeFile("$caseName.out", $output);
+
+				printf("case %u: between %s %s%s exited with %u, %u bytes of output for %u expected; see %s.*\n",
+				       $case, join(' ', map { ($_ eq $specFile) ? "$caseName.spec" : quoteArgument($_) } @args),
+				       $isPipe ? '< ' : '', "$caseName.in",
+				       $exitCode, length($output), length($expected), $caseName);
+			}
+
+			last;
+		}
+	}
+
+	unlink($inputFile, $specFile);
+
+	return $numFailed;
+}
+
+################################### Actions ###################################
+
+my $action = shift(@ARGV) // '';
+
+if ($action eq 'generate' && @ARGV == 4) {
+	generateCorpus(@ARGV);
+} elsif ($action eq 'fuzz' && @ARGV == 4) {
+	my $numFailed = fuzz(@ARGV);
+
+	printf("%u of %u cases failed\n", $numFailed, $ARGV[2]) if $numFailed > 0;
+	exit($numFailed > 0 ? 1 : 0);
+} else {
+	print STDERR "Usage: corpus.pl generate SEED SIZE_MB DENSITY FILE\n";
+	print STDERR "       corpus.pl fuzz BETWEEN SEED NUM_CASES FAIL_DIR\n";
+	exit(2);
+}
+
+exit(0);
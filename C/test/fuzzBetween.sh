@@ -0,0 +1,196 @@
+#!/usr/bin/bash
+
+#
+# fuzzBetween.sh - DevOpsBroker Bash fuzz and benchmark script for the between
+#                  utility
+#
+# Copyright (C) 2018-2020 Edward Smith <edwardsmith@devopsbroker.org>
+#
+# This program is free software: you can redistribute it and/or modify it under
+# the terms of the GNU General Public License as published by the Free Software
+# Foundation, either version 3 of the License, or (at your option) any later
+# version.
+#
+# This program is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+# FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+# details.
+#
+# You should have received a copy of the GNU General Public License along with
+# this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# -----------------------------------------------------------------------------
+# Developed on Ubuntu 18.04.2 LTS running kernel.osrelease = 4.18.0-18
+#
+# Compares between with the reference implementation in between/corpus.pl on
+# FUZZ_CASES random inputs, then measures its throughput on generated corpora
+# of BENCH_SIZE_MB MiB with sparse, medium and dense regions.
+#
+# The throughput of each run is kept in $TMPDIR/fuzzBetween.bench; a benchmark
+# that falls below half of the previous run fails, as does any fuzz case.
+#
+# Environment: FUZZ_SEED, FUZZ_CASES, BENCH_SIZE_MB
+# -----------------------------------------------------------------------------
+#
+
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ Preprocessing ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+# Load /etc/devops/ansi.conf if ANSI_CONFIG is unset
+if [ -z "$ANSI_CONFIG" ] && [ -f /etc/devops/ansi.conf ]; then
+	source /etc/devops/ansi.conf
+fi
+
+${ANSI_CONFIG?"[1;91mCannot load '/etc/devops/ansi.conf': No such file[0m"}
+
+# Load /etc/devops/exec.conf if EXEC_CONFIG is unset
+if [ -z "$EXEC_CONFIG" ] && [ -f /etc/devops/exec.conf ]; then
+	source /etc/devops/exec.conf
+fi
+
+${EXEC_CONFIG?"[1;91mCannot load '/etc/devops/exec.conf': No such file[0m"}
+
+# Load /etc/devops/functions.conf if FUNC_CONFIG is unset
+if [ -z "$FUNC_CONFIG" ] && [ -f /etc/devops/functions.conf ]; then
+	source /etc/devops/functions.conf
+fi
+
+${FUNC_CONFIG?"[1;91mCannot load '/etc/devops/functions.conf': No such file[0m"}
+
+## Script information
+SCRIPT_DIR=$( $EXEC_DIRNAME "$BASH_SOURCE" )
+EXEC_DIR="$SCRIPT_DIR/../bin"
+DATA_DIR="$SCRIPT_DIR"/between
+
+################################## Functions ##################################
+
+# ¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯
+# Function:     benchmark
+# Description:  Prints the best throughput of three runs of between and how
+#               it compares with the previous run of this script
+#
+# Parameter $1: Name of the corpus
+# Parameter $2: Name of the benchmark
+# Parameter $3: Whether to send the corpus through a pipe (pipe|file)
+# Parameter $@: The between options and arguments
+# -----------------------------------------------------------------------------
+function benchmark() {
+	local corpusName="$1"
+	local benchName="$2"
+	local inputMode="$3"
+	local corpusFile="$TMPDIR/between-bench.$corpusName"
+	local startTime=0
+	local elapsed=0
+	local bestElapsed=0
+	local mbPerSecond=0
+	local previous=''
+	local status=''
+
+	shift 3
+
+	for run in 1 2 3; do
+		startTime=$($EXEC_DATE +%s%N)
+
+		if [ "$inputMode" == 'pipe' ]; then
+			$EXEC_CAT "$corpusFile" | "$EXEC_BETWEEN" "$@" > /dev/null
+		else
+			"$EXEC_BETWEEN" "$@" "$corpusFile" > /dev/null
+		fi
+
+		elapsed=$(( $($EXEC_DATE +%s%N) - startTime ))
+
+		if [ $bestElapsed -eq 0 ] || [ $elapsed -lt $bestElapsed ]; then
+			bestElapsed=$elapsed
+		fi
+	done
+
+	mbPerSecond=$(( BENCH_SIZE_MB * 1024 * 1024 * 1000 / bestElapsed ))
+	previous=$($EXEC_AWK -F '\t' -v name="$corpusName/$benchName" '$1 == name { print $2 }' "$benchFile.prev" 2>/dev/null)
+	printf "%s\t%s\n" "$corpusName/$benchName" "$mbPerSecond" >> "$benchFile"
+
+	if [ -z "$previous" ]; then
+		status="$pass"
+		previous='-'
+	elif [ $(( mbPerSecond * 2 )) -lt $previous ]; then
+		status="$fail"
+		numFailed=$(( numFailed + 1 ))
+	else
+		status="$pass"
+	fi
+
+	printf "%-8s %-20s %10s %10s   [%s]\n" "$corpusName" "$benchName" "$mbPerSecond" "$previous" "$status"
+}
+
+################################## Variables ##################################
+
+## Bash exec variables
+EXEC_BETWEEN="$EXEC_DIR/between"
+EXEC_NPROC='/usr/bin/nproc'
+EXEC_PERL='/usr/bin/perl'
+
+## Variables
+export TMPDIR=${TMPDIR:-'/tmp'}
+FUZZ_SEED=${FUZZ_SEED:-2018}
+FUZZ_CASES=${FUZZ_CASES:-400}
+BENCH_SIZE_MB=${BENCH_SIZE_MB:-64}
+
+benchFile="$TMPDIR/fuzzBetween.bench"
+corpusScript="$DATA_DIR/corpus.pl"
+fuzzOutput=''
+numFailed=0
+numThreads=$($EXEC_NPROC)
+
+# Pass/Fail messages
+pass="${bold}${green}pass${reset}"
+fail="${bold}${red}fail${reset}"
+
+################################### Testing ###################################
+
+# Clean any failing cases left by a previous run
+$EXEC_RM -f "$TMPDIR"/between-fuzz.*
+
+#~~~~~~~~~~~~~~~~~~~~~~~~~~~~ Differential Fuzzing ~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+printBanner 'Differential Fuzzing'
+
+if fuzzOutput="$($EXEC_PERL "$corpusScript" fuzz "$EXEC_BETWEEN" "$FUZZ_SEED" "$FUZZ_CASES" "$TMPDIR")"; then
+	echo -e "corpus.pl fuzz seed $FUZZ_SEED, $FUZZ_CASES cases\t\t" "[$pass]"
+else
+	echo -e "corpus.pl fuzz seed $FUZZ_SEED, $FUZZ_CASES cases\t\t" "[$fail]"
+	echo "$fuzzOutput"
+	numFailed=$(( numFailed + 1 ))
+fi
+
+echo
+
+#~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ Benchmark ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+printBanner 'Benchmark'
+
+if [ -f "$benchFile" ]; then
+	$EXEC_MV -f "$benchFile" "$benchFile.prev"
+fi
+
+# Regions every 64 KiB, 1 KiB and 64 bytes on average
+for corpus in sparse:65536 medium:1024 dense:64; do
+	$EXEC_PERL "$corpusScript" generate "$FUZZ_SEED" "$BENCH_SIZE_MB" "${corpus#*:}" "$TMPDIR/between-bench.${corpus%:*}"
+done
+
+printf "%-8s %-20s %10s %10s\n" 'Corpus' 'Benchmark' 'MB/s' 'Previous'
+
+for corpus in sparse medium dense; do
+	benchmark $corpus '--all' file --all '<td>' '</td>'
+	benchmark $corpus '--all pipe' pipe --all '<td>' '</td>'
+	benchmark $corpus "-j $numThreads --all" file -j $numThreads --all '<td>' '</td>'
+	benchmark $corpus '-f --all' file -f "$TMPDIR/between-bench.$corpus.spec" --all
+	benchmark $corpus '-f --all pipe' pipe -f "$TMPDIR/between-bench.$corpus.spec" --all
+done
+
+$EXEC_RM -f "$TMPDIR"/between-bench.*
+
+echo
+
+if [ $numFailed -ne 0 ]; then
+	exit 1
+fi
+
+exit 0
@@ -0,0 +1,224 @@
+#!/usr/bin/bash
+
+#
+# testFirelog.sh - DevOpsBroker Bash test script for the firelog utility
+#
+# Copyright (C) 2018-2020 Edward Smith <edwardsmith@devopsbroker.org>
+#
+# This program is free software: you can redistribute it and/or modify it under
+# the terms of the GNU General Public License as published by the Free Software
+# Foundation, either version 3 of the License, or (at your option) any later
+# version.
+#
+# This program is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+# FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+# details.
+#
+# You should have received a copy of the GNU General Public License along with
+# this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# -----------------------------------------------------------------------------
+# Developed on Ubuntu 18.04.2 LTS running kernel.osrelease = 4.18.0-18
+#
+# Tests the firelog state file with plain and gzip-compressed log files, and
+# that -j and a gzip-compressed copy report the same summary as a single thread
+# reading the plain log. The JSON and CSV reports are compared with snapshots.
+# -----------------------------------------------------------------------------
+#
+
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ Preprocessing ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+# Load /etc/devops/ansi.conf if ANSI_CONFIG is unset
+if [ -z "$ANSI_CONFIG" ] && [ -f /etc/devops/ansi.conf ]; then
+	source /etc/devops/ansi.conf
+fi
+
+${ANSI_CONFIG?"[1;91mCannot load '/etc/devops/ansi.conf': No such file[0m"}
+
+# Load /etc/devops/exec.conf if EXEC_CONFIG is unset
+if [ -z "$EXEC_CONFIG" ] && [ -f /etc/devops/exec.conf ]; then
+	source /etc/devops/exec.conf
+fi
+
+${EXEC_CONFIG?"[1;91mCannot load '/etc/devops/exec.conf': No such file[0m"}
+
+# Load /etc/devops/functions.conf if FUNC_CONFIG is unset
+if [ -z "$FUNC_CONFIG" ] && [ -f /etc/devops/functions.conf ]; then
+	source /etc/devops/functions.conf
+fi
+
+${FUNC_CONFIG?"[1;91mCannot load '/etc/devops/functions.conf': No such file[0m"}
+
+## Script information
+SCRIPT_DIR=$( $EXEC_DIRNAME "$BASH_SOURCE" )
+EXEC_DIR="$SCRIPT_DIR/../bin"
+DATA_DIR="$SCRIPT_DIR"/firelog
+
+################################## Functions ##################################
+
+# ¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯
+# Function:     formatTest
+# Description:  Expects the report of the syslog fixture in the given format to
+#               match its snapshot
+#
+# Parameter $1: Report format
+# Parameter $2: Expected output file
+# -----------------------------------------------------------------------------
+function formatTest() {
+	# 1. Run the test and save output to $TMPDIR/$2.out
+	if ! $EXEC_FIRELOG --format $1 "$syslog" > "$TMPDIR/$2.out" 2>/dev/null; then
+		echo $fail
+		return 1;
+	fi
+
+	# 2. Compare expected and actual outputs
+	if $EXEC_DIFF "$DATA_DIR/$2" "$TMPDIR/$2.out" > /dev/null; then
+		$EXEC_RM -f "$TMPDIR/$2.out"
+		echo $pass
+		return 0;
+	else
+		echo $fail
+		return 1;
+	fi
+}
+
+# ¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯
+# Function:     sameReportTest
+# Description:  Expects two runs of firelog to report the same summary
+#
+# Parameter $1: Options of the first run
+# Parameter $2: Log file of the first run
+# Parameter $3: Options of the second run
+# Parameter $4: Log file of the second run
+# -----------------------------------------------------------------------------
+function sameReportTest() {
+	# 1. Run firelog both ways
+	if ! $EXEC_FIRELOG $1 "$2" > "$TMPDIR/firelog.expect" 2>/dev/null ||
+	   ! $EXEC_FIRELOG $3 "$4" > "$TMPDIR/firelog.out" 2>/dev/null; then
+		echo $fail
+		return 1;
+	fi
+
+	# 2. Compare expected and actual outputs
+	if $EXEC_DIFF "$TMPDIR/firelog.expect" "$TMPDIR/firelog.out" > /dev/null; then
+		$EXEC_RM -f "$TMPDIR/firelog.expect" "$TMPDIR/firelog.out"
+		echo $pass
+		return 0;
+	else
+		echo $fail
+		return 1;
+	fi
+}
+
+# ¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯
+# Function:     stateTest
+# Description:  Expects two runs with the state file to report the same summary
+#               as a single run without it
+#
+# Parameter $1: Name of the log file
+# -----------------------------------------------------------------------------
+function stateTest() {
+	$EXEC_RM -f "$stateFile"
+
+	# 1. Run once without and twice with the state file
+	if ! $EXEC_FIRELOG "$1" > "$TMPDIR/firelog.expect" 2>/dev/null ||
+	   ! $EXEC_FIRELOG -s "$stateFile" "$1" > /dev/null 2>&1 ||
+	   ! $EXEC_FIRELOG -s "$stateFile" "$1" > "$TMPDIR/firelog.out" 2>/dev/null; then
+		echo $fail
+		return 1;
+	fi
+
+	# 2. Compare expected and actual outputs
+	if $EXEC_DIFF "$TMPDIR/firelog.expect" "$TMPDIR/firelog.out" > /dev/null; then
+		$EXEC_RM -f "$TMPDIR/firelog.expect" "$TMPDIR/firelog.out"
+		echo $pass
+		return 0;
+	else
+		echo $fail
+		return 1;
+	fi
+}
+
+# ¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯
+# Function:     negativeStateTest
+# Description:  Expects firelog to fail and leave the state file untouched
+#
+# Parameter $@: The firelog options and arguments
+# -----------------------------------------------------------------------------
+function negativeStateTest() {
+	local exitCode=0
+
+	# 1. Run the test against a fresh state file
+	$EXEC_RM -f "$stateFile"
+	$EXEC_FIRELOG -s "$stateFile" "$@" 1>/dev/null 2>/dev/null
+	exitCode=$?
+
+	# 2. Check exit code for failure and that no state file was written
+	if [ $exitCode -ne 0 ] && [ ! -e "$stateFile" ]; then
+		echo $pass
+		return 0;
+	else
+		echo $fail
+		return 1;
+	fi
+}
+
+################################## Variables ##################################
+
+## Bash exec variables
+EXEC_FIRELOG="$EXEC_DIR/firelog"
+EXEC_DIFF='/usr/bin/diff -ad'
+EXEC_GZIP='/bin/gzip'
+
+## Variables
+export TMPDIR=${TMPDIR:-'/tmp'}
+stateFile="$TMPDIR/firelog.state"
+
+# Data input files
+syslog="$DATA_DIR/syslog"
+syslogGz="$TMPDIR/firelog-syslog.gz"
+syslogBig="$TMPDIR/firelog-syslog.big"
+syslogBigGz="$TMPDIR/firelog-syslog.big.gz"
+
+# Pass/Fail messages
+pass="${bold}${green}pass${reset}"
+fail="${bold}${red}fail${reset}"
+
+################################### Testing ###################################
+
+$EXEC_GZIP -c "$syslog" > "$syslogGz"
+
+# Enough copies of the log for -j 4 to split it between four threads
+for copy in {1..800}; do
+	$EXEC_CAT "$syslog"
+done > "$syslogBig"
+
+$EXEC_GZIP -c "$syslogBig" > "$syslogBigGz"
+
+#~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ Positive Testing ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+printBanner 'Positive Testing'
+
+echo -e 'firelog -s firelog.state syslog\t\t\t'            "[$(stateTest "$syslog")]"
+echo -e 'firelog -j 4 syslog.big\t\t\t\t'                  "[$(sameReportTest '-j 1' "$syslogBig" '-j 4' "$syslogBig")]"
+echo -e 'firelog syslog.gz\t\t\t\t'                        "[$(sameReportTest '' "$syslog" '' "$syslogGz")]"
+echo -e 'firelog syslog.big.gz\t\t\t\t'                    "[$(sameReportTest '' "$syslogBig" '' "$syslogBigGz")]"
+echo -e 'firelog --format json syslog\t\t\t'               "[$(formatTest json 'json-test.expect')]"
+echo -e 'firelog --format csv syslog\t\t\t'                "[$(formatTest csv 'csv-test.expect')]"
+
+echo
+
+#~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ Negative Testing ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+printBanner 'Negative Testing'
+
+echo -e 'firelog -s firelog.state syslog.gz\t\t'           "[$(negativeStateTest "$syslogGz")]"
+echo -e 'firelog -s firelog.state -f syslog\t\t'           "[$(negativeStateTest -f "$syslog")]"
+echo -e 'firelog -s firelog.state syslog syslog\t\t'       "[$(negativeStateTest "$syslog" "$syslog")]"
+
+$EXEC_RM -f "$stateFile" "$syslogGz" "$syslogBig" "$syslogBigGz"
+
+echo
+
+exit 0
@@ -0,0 +1,284 @@
+#!/usr/bin/bash
+
+#
+# testMd5hash.sh - DevOpsBroker Bash test script for the md5hash utility
+#
+# Copyright (C) 2018-2020 Edward Smith <edwardsmith@devopsbroker.org>
+#
+# This program is free software: you can redistribute it and/or modify it under
+# the terms of the GNU General Public License as published by the Free Software
+# Foundation, either version 3 of the License, or (at your option) any later
+# version.
+#
+# This program is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+# FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+# details.
+#
+# You should have received a copy of the GNU General Public License along with
+# this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# -----------------------------------------------------------------------------
+# Developed on Ubuntu 18.04.2 LTS running kernel.osrelease = 4.18.0-18
+#
+# Compares the MD5, SHA-1 and SHA-256 digests of files at the 64-byte block
+# boundaries, of many small files hashed in parallel lanes and of a multi-MiB
+# file with md5sum, sha1sum and sha256sum. BLAKE3, XXH3, -c and --batch with
+# -n and -s are checked against known digests.
+#
+# The hash kernels tested are the ones this machine selects.
+# -----------------------------------------------------------------------------
+#
+
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ Preprocessing ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+# Load /etc/devops/ansi.conf if ANSI_CONFIG is unset
+if [ -z "$ANSI_CONFIG" ] && [ -f /etc/devops/ansi.conf ]; then
+	source /etc/devops/ansi.conf
+fi
+
+${ANSI_CONFIG?"[1;91mCannot load '/etc/devops/ansi.conf': No such file[0m"}
+
+# Load /etc/devops/exec.conf if EXEC_CONFIG is unset
+if [ -z "$EXEC_CONFIG" ] && [ -f /etc/devops/exec.conf ]; then
+	source /etc/devops/exec.conf
+fi
+
+${EXEC_CONFIG?"[1;91mCannot load '/etc/devops/exec.conf': No such file[0m"}
+
+# Load /etc/devops/functions.conf if FUNC_CONFIG is unset
+if [ -z "$FUNC_CONFIG" ] && [ -f /etc/devops/functions.conf ]; then
+	source /etc/devops/functions.conf
+fi
+
+${FUNC_CONFIG?"[1;91mCannot load '/etc/devops/functions.conf': No such file[0m"}
+
+## Script information
+SCRIPT_DIR=$( $EXEC_DIRNAME "$BASH_SOURCE" )
+EXEC_DIR="$SCRIPT_DIR/../bin"
+
+################################## Functions ##################################
+
+# ¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯
+# Function:     coreutilsTest
+# Description:  Expects md5hash to print the same digests as coreutils for the
+#               given files or the multi-MiB file on STDIN
+#
+# Parameter $1: Coreutils command printing the expected digests
+# Parameter $2: The md5hash options
+# Parameter $@: Files to hash, or none for STDIN
+# -----------------------------------------------------------------------------
+function coreutilsTest() {
+	local sumCommand="$1"
+	local options="$2"
+
+	shift 2
+
+	# 1. Hash the files or STDIN both ways
+	if [ $# -eq 0 ]; then
+		$sumCommand < "$bigFile" > "$TMPDIR/md5hash.expect" &&
+		$EXEC_MD5HASH $options < "$bigFile" > "$TMPDIR/md5hash.out" 2>/dev/null
+	else
+		$sumCommand "$@" > "$TMPDIR/md5hash.expect" &&
+		$EXEC_MD5HASH $options "$@" > "$TMPDIR/md5hash.out" 2>/dev/null
+	fi
+
+	if [ $? -ne 0 ]; then
+		echo $fail
+		return 1;
+	fi
+
+	# 2. Compare expected and actual outputs
+	if $EXEC_DIFF "$TMPDIR/md5hash.expect" "$TMPDIR/md5hash.out" > /dev/null; then
+		$EXEC_RM -f "$TMPDIR/md5hash.expect" "$TMPDIR/md5hash.out"
+		echo $pass
+		return 0;
+	else
+		echo $fail
+		return 1;
+	fi
+}
+
+# ¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯
+# Function:     knownDigestTest
+# Description:  Expects md5hash to print the known digests for the given input
+#
+# Parameter $1: Input sent to STDIN
+# Parameter $2: Expected output
+# Parameter $@: The md5hash options and arguments
+# -----------------------------------------------------------------------------
+function knownDigestTest() {
+	local input="$1"
+	local expected="$2"
+	local output=''
+
+	shift 2
+
+	# 1. Run the test
+	output="$(printf "$input" | $EXEC_MD5HASH "$@" 2>/dev/null)"
+
+	# 2. Check exit code and compare expected and actual outputs
+	if [ $? -eq 0 ] && [ "$output" == "$expected" ]; then
+		echo $pass
+		return 0;
+	else
+		echo $fail
+		return 1;
+	fi
+}
+
+# ¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯
+# Function:     negativeTest
+# Description:  Expects a negative outcome from the applied test
+#
+# Parameter $@: The md5hash options and arguments
+# -----------------------------------------------------------------------------
+function negativeTest() {
+	local exitCode=0
+
+	# 1. Run the test
+	$EXEC_MD5HASH "$@" 1>/dev/null 2>/dev/null
+	exitCode=$?
+
+	# 2. Check exit code for success/failure
+	if [ $exitCode -ne 0 ]; then
+		echo $pass
+		return 0;
+	else
+		echo $fail
+		return 1;
+	fi
+}
+
+# ¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯
+# Function:     positiveTest
+# Description:  Expects a positive outcome from the applied test
+#
+# Parameter $@: The md5hash options and arguments
+# -----------------------------------------------------------------------------
+function positiveTest() {
+	local exitCode=0
+
+	# 1. Run the test
+	$EXEC_MD5HASH "$@" 1>/dev/null 2>/dev/null
+	exitCode=$?
+
+	# 2. Check exit code for success/failure
+	if [ $exitCode -eq 0 ]; then
+		echo $pass
+		return 0;
+	else
+		echo $fail
+		return 1;
+	fi
+}
+
+################################## Variables ##################################
+
+## Bash exec variables
+EXEC_MD5HASH="$EXEC_DIR/md5hash"
+EXEC_DIFF='/usr/bin/diff -ad'
+EXEC_HEAD='/usr/bin/head'
+EXEC_MD5SUM='/usr/bin/md5sum'
+EXEC_PERL='/usr/bin/perl'
+EXEC_SHA1SUM='/usr/bin/sha1sum'
+EXEC_SHA256SUM='/usr/bin/sha256sum'
+
+## Variables
+export TMPDIR=${TMPDIR:-'/tmp'}
+dataDir="$TMPDIR/md5hash-test"
+bigFile="$dataDir/big"
+katFile="$dataDir/kat"
+manifest="$TMPDIR/md5hash-test.md5"
+boundaryFiles=()
+laneFiles=()
+
+# Pass/Fail messages
+pass="${bold}${green}pass${reset}"
+fail="${bold}${red}fail${reset}"
+
+################################### Testing ###################################
+
+$EXEC_RM -rf "$dataDir"
+$EXEC_MKDIR -p "$dataDir/lanes"
+
+# Files on either side of the 64-byte block and 32 KiB read boundaries
+for size in 0 1 55 56 57 63 64 65 119 120 127 128 1000 32767 32768 32769; do
+	boundaryFiles+=("$dataDir/size.$(printf '%05d' $size)")
+	$EXEC_HEAD -c $size /dev/urandom > "$dataDir/size.$(printf '%05d' $size)"
+done
+
+# Small files of every length below 300 bytes fill the MD5 lanes unevenly
+for size in {0..299}; do
+	laneFiles+=("$dataDir/lanes/size.$(printf '%03d' $size)")
+	$EXEC_HEAD -c $size /dev/urandom > "$dataDir/lanes/size.$(printf '%03d' $size)"
+done
+
+# A multi-MiB file that ends mid-block
+$EXEC_HEAD -c 4194311 /dev/urandom > "$bigFile"
+
+# The BLAKE3 test vector input: bytes counting up modulo 251
+$EXEC_PERL -e 'print map chr($_ % 251), 0 .. 102399' > "$katFile"
+
+#~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ Coreutils ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+printBanner 'Coreutils'
+
+for algorithm in md5:$EXEC_MD5SUM sha1:$EXEC_SHA1SUM sha256:$EXEC_SHA256SUM; do
+	name=${algorithm%%:*}
+	sumCommand=${algorithm#*:}
+
+	printf "%-48s %s\n" "md5hash -a $name block boundaries" "[$(coreutilsTest $sumCommand "-a $name" "${boundaryFiles[@]}")]"
+	printf "%-48s %s\n" "md5hash -a $name lanes" "[$(coreutilsTest $sumCommand "-a $name" "${laneFiles[@]}")]"
+	printf "%-48s %s\n" "md5hash -a $name -j 1 lanes" "[$(coreutilsTest $sumCommand "-a $name -j 1" "${laneFiles[@]}")]"
+	printf "%-48s %s\n" "md5hash -a $name big" "[$(coreutilsTest $sumCommand "-a $name" "$bigFile")]"
+	printf "%-48s %s\n" "md5hash -a $name < big" "[$(coreutilsTest $sumCommand "-a $name")]"
+done
+
+for ioMode in aio mmap direct; do
+	printf "%-48s %s\n" "md5hash --io=$ioMode big" "[$(coreutilsTest $EXEC_MD5SUM "--io=$ioMode" "$bigFile")]"
+done
+
+echo
+
+#~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ Known Digests ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+printBanner 'Known Digests'
+
+echo -e 'md5hash -a blake3 < /dev/null\t\t\t'              "[$(knownDigestTest '' 'af1349b9f5f9a1a6a0404dea36dcc9499bcb25c9adc112b7cc9a93cae41f3262  -' -a blake3)]"
+echo -e 'md5hash -a blake3 kat\t\t\t\t'                    "[$(knownDigestTest '' "bc3e3d41a1146b069abffad3c0d44860cf664390afce4d9661f7902e7943e085  $katFile" -a blake3 "$katFile")]"
+echo -e 'md5hash -a xxh3 < /dev/null\t\t\t'                "[$(knownDigestTest '' '2d06800538d394c2  -' -a xxh3)]"
+echo -e 'md5hash -s abcdefghijklmnop\t\t\t'                "[$(knownDigestTest 'mypassword' '5f3c4bd7d1178309b452ba6f7348167d  -' -s abcdefghijklmnop)]"
+echo -e 'md5hash -n 5\t\t\t\t\t'                           "[$(knownDigestTest 'mypassword' 'f4cfc47b32ff034ed1af1889072a4807  -' -n 5)]"
+
+echo -e 'md5hash --batch -n 1000 -s abcdefghijklmnop\t'    "[$(knownDigestTest 'alpha\nbeta\n\ngamma\n' 'd055cd8973b4dedb1714bee446a8deba
+e9ca996ce0e76fdc2d1c585b594f7582
+41234b2f2944548399323a57dbb2e425
+b0a3469fd063191701979ef80a926544' --batch -n 1000 -s abcdefghijklmnop)]"
+
+echo -e 'md5hash --batch -a sha256 -n 3 -s salt\t\t'       "[$(knownDigestTest 'alpha\nbeta\n\ngamma\n' '590e9bfabb696929d7f17b85dceec16ef06e9ee37312f1fe552c633ea8c18ccf
+02c858830d4edae73edf83a57b68d794f42fcb3106d9efe181eca0f59d31b210
+021549576c6fcfa5b3fec6ba95ed7b31a5ea750449440d31d85decf1122a291d
+f7ea3d945ce4dfdc3064371f9bd54be9a46ce30b4192fbd0343e10a4639aab2c' --batch -a sha256 -n 3 -s salt)]"
+
+echo
+
+#~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ Manifest ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+printBanner 'Manifest'
+
+$EXEC_MD5SUM "${boundaryFiles[@]}" "$bigFile" > "$manifest"
+echo -e 'md5hash -c md5hash-test.md5\t\t\t'                "[$(positiveTest -c "$manifest")]"
+
+# A digest that no longer matches its file
+$EXEC_HEAD -c 1 /dev/urandom >> "$dataDir/size.00064"
+echo -e 'md5hash -c md5hash-test.md5 (changed file)\t'     "[$(negativeTest -c "$manifest")]"
+
+$EXEC_RM -f "$dataDir/size.00000"
+echo -e 'md5hash -c md5hash-test.md5 (missing file)\t'     "[$(negativeTest -c "$manifest")]"
+
+$EXEC_RM -rf "$dataDir" "$manifest"
+
+echo
+
+exit 0